@@ -0,0 +1,120 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+#include "accesslist.h"
+
+#include "darkerror.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+using namespace DarkHttpd;
+
+AccessList::Key AccessList::keyOf(const Inaddr6 &address) {
+  Key key = 0;
+  for (auto byte: address.__in6_u.__u6_addr8) {
+    key = key << 8 | byte;
+  }
+  return key;
+}
+
+void AccessList::add(const char *cidr, bool allow) {
+  std::string text(cidr);
+  unsigned length = 128;
+  auto slash = text.find('/');
+  bool hasLength = slash != std::string::npos;
+  char *end = nullptr;
+  if (hasLength) {
+    length = unsigned(strtoul(text.c_str() + slash + 1, &end, 10));
+    text.resize(slash);
+  }
+  Inaddr6 address;
+  in_addr v4;
+  if (inet_pton(AF_INET, text.c_str(), &v4) == 1) {
+    if (!hasLength) {
+      length = 32;
+    }
+    if (length > 32) {
+      err(-1, "%s `%s' has an ipv4 prefix longer than 32", allow ? "--allow" : "--deny", cidr);
+    }
+    address.__in6_u.__u6_addr32[2] = htonl(0xffff);
+    address.__in6_u.__u6_addr32[3] = v4.s_addr;
+    length += 96;
+  } else if (inet_pton(AF_INET6, text.c_str(), &address) != 1 || length > 128) {
+    err(-1, "%s wants an address or address/length, ipv4 or ipv6, not `%s'", allow ? "--allow" : "--deny", cidr);
+  }
+  if (hasLength && (!end || *end || end == cidr + slash + 1)) {
+    err(-1, "%s `%s' has a bad prefix length", allow ? "--allow" : "--deny", cidr);
+  }
+  Key hostBits = length == 128 ? 0 : ~Key(0) >> length;
+  Key key = keyOf(address);
+  rules.push_back({key & ~hostBits, key | hostBits, length, allow});
+  anyAllow |= allow;
+}
+
+void AccessList::compile() {
+  starts.clear();
+  verdicts.clear();
+  //prefixes nest or are disjoint, so sorted by start and then widest first, each one is inside those still open on the stack
+  std::sort(rules.begin(), rules.end(), [](const Rule &a, const Rule &b) {
+    if (a.low != b.low) {
+      return a.low < b.low;
+    }
+    if (a.length != b.length) {
+      return a.length < b.length;
+    }
+    return a.allow && !b.allow; //so that deny is the inner one of a tie, and wins
+  });
+  std::vector<const Rule *> open;
+  auto mark = [&](Key start, int8_t verdict) {
+    if (!starts.empty() && starts.back() == start) {
+      verdicts.back() = verdict; //the later, narrower, rule starts at the same place
+    } else {
+      starts.push_back(start);
+      verdicts.push_back(verdict);
+    }
+  };
+  auto close = [&] {
+    auto ended = open.back();
+    open.pop_back();
+    if (ended->high != ~Key(0)) {
+      mark(ended->high + 1, open.empty() ? -1 : open.back()->allow);
+    }
+  };
+  for (auto &rule: rules) {
+    while (!open.empty() && open.back()->high < rule.low) {
+      close();
+    }
+    mark(rule.low, rule.allow);
+    open.push_back(&rule);
+  }
+  while (!open.empty()) {
+    close();
+  }
+  //merge neighbours with the same verdict
+  size_t kept = 0;
+  for (size_t index = 0; index < starts.size(); ++index) {
+    if (kept && verdicts[kept - 1] == verdicts[index]) {
+      continue;
+    }
+    starts[kept] = starts[index];
+    verdicts[kept] = verdicts[index];
+    ++kept;
+  }
+  starts.resize(kept);
+  verdicts.resize(kept);
+  starts.shrink_to_fit();
+  verdicts.shrink_to_fit();
+}
+
+bool AccessList::allows(const Inaddr6 &address) const {
+  auto key = keyOf(address);
+  auto after = std::upper_bound(starts.begin(), starts.end(), key);
+  int8_t verdict = after == starts.begin() ? -1 : verdicts[after - starts.begin() - 1];
+  return verdict < 0 ? !anyAllow : verdict;
+}
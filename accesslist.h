@@ -0,0 +1,62 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+#pragma once
+
+#include "addr6.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace DarkHttpd {
+  /** --allow and --deny CIDR lists, checked at accept before a Connection is taken, so that we don't need iptables rules kept in step with the server's.
+   * The most specific prefix that covers an address decides, deny winning a tie. Addresses no prefix covers are allowed unless there are --allow rules, then denied.
+   * IPv4 is held in the ::ffff: mapped form, so a v4 rule matches clients of either socket family.
+   * compile() flattens the nested prefixes into a sorted table of where the verdict changes, so a check is a binary search of 128 bit keys, log2 of the table's size compares.
+   */
+  class AccessList {
+  public:
+    using Key = unsigned __int128;
+
+    struct Stats {
+      uint64_t denied = 0;
+    } stats;
+
+    /** from cli, --allow @param cidr or --deny. Bad ones are fatal. */
+    void add(const char *cidr, bool allow);
+
+    /** build the table, after the last add */
+    void compile();
+
+    bool enabled() const {
+      return !rules.empty();
+    }
+
+    /** @returns whether @param address may connect */
+    bool allows(const Inaddr6 &address) const;
+
+    static Key keyOf(const Inaddr6 &address);
+
+    /** entries in the compiled table */
+    size_t size() const {
+      return starts.size();
+    }
+
+  private:
+    struct Rule {
+      Key low;
+      Key high;
+      unsigned length; //of the prefix
+      bool allow;
+    };
+
+    std::vector<Rule> rules;
+    bool anyAllow = false;
+
+    /* the compiled table, verdicts[i] holds from starts[i] up to starts[i+1] */
+    std::vector<Key> starts;
+    std::vector<int8_t> verdicts; //1 allow, 0 deny, -1 no rule covers it
+  };
+}
@@ -0,0 +1,70 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+#include "alloccount.h"
+
+#if DarklyCountAllocations
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+
+/* glibc exports its allocator under these names so that a program can wrap it without dlsym, which itself allocates.
+ * operator new comes through malloc so it gets counted too. */
+extern "C" {
+  void *__libc_malloc(size_t size);
+  void *__libc_calloc(size_t count, size_t size);
+  void *__libc_realloc(void *old, size_t size);
+  void *__libc_memalign(size_t alignment, size_t size);
+}
+
+static std::atomic<uint64_t> allocations{0}; //atomic in case some helper thread allocates while the event loop is reading it.
+
+static void counted() {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+extern "C" {
+  void *malloc(size_t size) {
+    counted();
+    return __libc_malloc(size);
+  }
+
+  void *calloc(size_t count, size_t size) {
+    counted();
+    return __libc_calloc(count, size);
+  }
+
+  void *realloc(void *old, size_t size) {
+    counted();
+    return __libc_realloc(old, size);
+  }
+
+  void *memalign(size_t alignment, size_t size) {
+    counted();
+    return __libc_memalign(alignment, size);
+  }
+
+  void *aligned_alloc(size_t alignment, size_t size) {
+    counted();
+    return __libc_memalign(alignment, size);
+  }
+
+  int posix_memalign(void **memptr, size_t alignment, size_t size) {
+    counted();
+    void *got = __libc_memalign(alignment, size);
+    if (!got) {
+      return ENOMEM;
+    }
+    *memptr = got;
+    return 0;
+  }
+}
+
+uint64_t DarkHttpd::AllocationCounter::read() {
+  return allocations.load(std::memory_order_relaxed);
+}
+
+#endif
@@ -0,0 +1,28 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+#pragma once
+
+#include <cstdint>
+
+/* Build with DarklyCountAllocations=1 to interpose malloc and friends and count every call, so that we can show which request paths touch the heap.
+ * With it 0 (the default) read() is a constant zero and all the bookkeeping around it compiles away.
+ */
+#ifndef DarklyCountAllocations
+#define DarklyCountAllocations 0
+#endif
+
+namespace DarkHttpd {
+  struct AllocationCounter {
+#if DarklyCountAllocations
+    /** @returns number of malloc, calloc, realloc and aligned allocations since the program started. */
+    static uint64_t read();
+#else
+    static constexpr uint64_t read() {
+      return 0;
+    }
+#endif
+  };
+}
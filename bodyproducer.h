@@ -0,0 +1,25 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+#pragma once
+#include "bodyring.h"
+
+namespace DarkHttpd {
+  /** generates a reply body while it is being sent, for bodies too big or too slow to build before the header goes out. */
+  struct BodyProducer {
+    /** append to @param into until it is full() or the body ends.
+     * @returns whether there is more to come. */
+    virtual bool produce(BodySink &into) = 0;
+
+    /** whether produce returned for want of work on another thread, which calls the connection back through IoWaiter when it is done */
+    virtual bool waiting() const {
+      return false;
+    }
+
+    virtual const char *contentType() const = 0;
+
+    virtual ~BodyProducer() = default;
+  };
+}
@@ -0,0 +1,179 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+#include "bodyring.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+using namespace DarkHttpd;
+
+void BodySink::printf(const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  vprintf(format, args);
+  va_end(args);
+}
+
+void BodySink::vprintf(const char *format, va_list args) {
+  char text[1024];
+  va_list again;
+  va_copy(again, args);
+  int length = vsnprintf(text, sizeof(text), format, args);
+  if (length >= 0 && size_t(length) < sizeof(text)) {
+    append(text, length);
+  } else if (length > 0) { //rare, and only from a long url
+    std::string longer(length + 1, 0);
+    vsnprintf(longer.data(), longer.size(), format, again);
+    append(longer.data(), length);
+  }
+  va_end(again);
+}
+
+char *BufferPool::take() {
+  ++stats.taken;
+  if (++stats.outstanding > stats.peak) {
+    stats.peak = stats.outstanding;
+  }
+  if (!spare.empty()) {
+    auto buffer = spare.back();
+    spare.pop_back();
+    return buffer;
+  }
+  ++stats.allocated;
+  return static_cast<char *>(malloc(BufferSize));
+}
+
+void BufferPool::give(char *buffer) {
+  --stats.outstanding;
+  if (spare.size() < keep) {
+    spare.push_back(buffer);
+  } else {
+    free(buffer);
+  }
+}
+
+BufferPool::~BufferPool() {
+  for (auto buffer: spare) {
+    free(buffer);
+  }
+}
+
+void BodyRing::append(const char *data, size_t length) {
+  while (length) {
+    if (!open) {
+      if (count > Slots) {
+        truncated = true; //a producer that ignored full(), or an error page bigger than the ring
+        return;
+      }
+      auto buffer = pool->take();
+      if (!buffer) {
+        truncated = true;
+        return;
+      }
+      slots[count++] = Slot{buffer, uint32_t(fillStart()), uint32_t(fillStart())};
+      open = true;
+    }
+    auto &slot = slots[count - 1];
+    size_t room = fillLimit() - slot.end;
+    size_t taking = length < room ? length : room;
+    memcpy(slot.buffer + slot.end, data, taking);
+    slot.end += taking;
+    data += taking;
+    length -= taking;
+    if (slot.end == fillLimit()) {
+      seal(false);
+    }
+  }
+}
+
+void BodyRing::seal(bool last) {
+  if (!open) {
+    if (!(last && chunked)) {
+      return;
+    }
+    if (count) { //a sealed slot kept Trail bytes, CRLF took two of them, the terminator fits in the rest
+      auto &slot = slots[count - 1];
+      memcpy(slot.buffer + slot.end, "0\r\n\r\n", 5);
+      slot.end += 5;
+      return;
+    }
+    auto buffer = pool->take();
+    if (!buffer) {
+      truncated = true;
+      return;
+    }
+    slots[count++] = Slot{buffer, uint32_t(Lead), uint32_t(Lead)}; //just for the terminator
+    open = true;
+  }
+  auto &slot = slots[count - 1];
+  open = false;
+  size_t length = slot.end - slot.begin;
+  if (chunked) {
+    if (length) {
+      char sizeLine[Lead + 1];
+      int used = snprintf(sizeLine, sizeof(sizeLine), "%zx\r\n", length);
+      slot.begin -= used;
+      memcpy(slot.buffer + slot.begin, sizeLine, used);
+      memcpy(slot.buffer + slot.end, "\r\n", 2);
+      slot.end += 2;
+    }
+    if (last) {
+      memcpy(slot.buffer + slot.end, "0\r\n\r\n", 5);
+      slot.end += 5;
+    }
+  }
+  if (slot.end == slot.begin) { //an empty chunk would end the body
+    pool->give(slot.buffer);
+    --count;
+  }
+}
+
+size_t BodyRing::pending() const {
+  size_t total = 0;
+  for (unsigned which = 0; which < count - open; ++which) {
+    total += slots[which].end - slots[which].begin;
+  }
+  return total;
+}
+
+unsigned BodyRing::gather(iovec *iov) const {
+  unsigned used = 0;
+  for (unsigned which = 0; which < count - open; ++which) {
+    iov[used].iov_base = slots[which].buffer + slots[which].begin;
+    iov[used].iov_len = slots[which].end - slots[which].begin;
+    ++used;
+  }
+  return used;
+}
+
+void BodyRing::consume(size_t sent) {
+  unsigned done = 0;
+  while (sent && done < count - open) {
+    auto &slot = slots[done];
+    size_t here = slot.end - slot.begin;
+    if (sent < here) {
+      slot.begin += sent;
+      break;
+    }
+    sent -= here;
+    pool->give(slot.buffer);
+    ++done;
+  }
+  if (done) {
+    memmove(slots, slots + done, (count - done) * sizeof(Slot));
+    count -= done;
+  }
+}
+
+void BodyRing::release() {
+  for (unsigned which = 0; which < count; ++which) {
+    pool->give(slots[which].buffer);
+  }
+  count = 0;
+  open = false;
+  active = false;
+  truncated = false;
+}
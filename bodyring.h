@@ -0,0 +1,162 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+#pragma once
+
+#include "checkFormatArgs.h"
+
+#include <cstdarg>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <sys/uio.h>
+
+namespace DarkHttpd {
+  /** where generated body text goes, so that the same rendering code can fill a string for a cache or buffers headed for a socket */
+  struct BodySink {
+    virtual void append(const char *data, size_t length) = 0;
+
+    /** a producer should stop adding and return when this says so, the sink will accept one more item beyond it. */
+    virtual bool full() const {
+      return false;
+    }
+
+    BodySink &operator+=(char c) {
+      append(&c, 1);
+      return *this;
+    }
+
+    BodySink &operator+=(const char *text) {
+      append(text, strlen(text));
+      return *this;
+    }
+
+    BodySink &operator+=(const std::string &text) {
+      append(text.data(), text.size());
+      return *this;
+    }
+
+    void printf(const char *format, ...) checkFargs(2, 3);
+
+    void vprintf(const char *format, va_list args);
+
+    virtual ~BodySink() = default;
+  };
+
+  /** a BodySink that just accumulates */
+  struct StringSink : BodySink {
+    std::string &text;
+
+    StringSink(std::string &text) : text{text} {}
+
+    void append(const char *data, size_t length) override {
+      text.append(data, length);
+    }
+  };
+
+  /** fixed size buffers for generated bodies, kept for reuse so that steady state serving doesn't touch the heap and an idle connection holds none. */
+  class BufferPool {
+    std::vector<char *> spare;
+
+  public:
+    static constexpr size_t BufferSize = 16 * 1024;
+    size_t keep = 256; //spares held beyond this are freed
+
+    struct Stats {
+      uint64_t taken = 0;
+      uint64_t allocated = 0;
+      size_t outstanding = 0;
+      size_t peak = 0;
+    } stats;
+
+    char *take();
+
+    void give(char *buffer);
+
+    ~BufferPool();
+  };
+
+  /** a generated body on its way to a socket: a bounded ring of pooled buffers that a producer fills while the connection drains it with sendmsg.
+   * When chunked each buffer's worth is framed as an HTTP/1.1 chunk in place, room for the size line is reserved in front of the data and for the CRLF behind it.
+   */
+  class BodyRing : public BodySink {
+  public:
+    static constexpr unsigned Slots = 4; //buffers a producer may get ahead of the socket by
+    static constexpr size_t Lead = 10; //8 hex digits and CRLF
+    static constexpr size_t Trail = 8; //CRLF, and the "0\r\n\r\n" that ends the body
+
+    BufferPool *pool = nullptr;
+    bool chunked = false;
+
+  private:
+    struct Slot {
+      char *buffer;
+      uint32_t begin; //next byte to send
+      uint32_t end; //past the last one, while open this is where append goes.
+    };
+
+    Slot slots[Slots + 1]; //the extra one takes what an item added after full() overflows by
+    unsigned count = 0;
+    bool open = false; //slots[count-1] is still being filled
+    bool active = false;
+    bool truncated = false;
+
+    size_t fillStart() const {
+      return chunked ? Lead : 0;
+    }
+
+    size_t fillLimit() const {
+      return BufferPool::BufferSize - (chunked ? Trail : 0);
+    }
+
+    /** frame the open slot, and end the body after it if @param last */
+    void seal(bool last);
+
+  public:
+    /** start a body, which is @param isChunked or else ends at the end of the connection or is sized before its header is sent */
+    void start(bool isChunked) {
+      release();
+      chunked = isChunked;
+      active = true;
+    }
+
+    bool inUse() const {
+      return active;
+    }
+
+    /** some of the body was dropped for lack of buffers, the connection should not be reused */
+    bool wasTruncated() const {
+      return truncated;
+    }
+
+    void append(const char *data, size_t length) override;
+
+    bool full() const override {
+      return count >= Slots;
+    }
+
+    /** make what has been appended sendable, with the end of body marker if @param last */
+    void flush(bool last) {
+      seal(last);
+    }
+
+    /** bytes ready to send */
+    size_t pending() const;
+
+    /** fill @param iov with what is ready to send, @returns how many entries that took, at most Slots + 1 */
+    unsigned gather(iovec *iov) const;
+
+    /** @param sent bytes have gone, buffers that are done go back to the pool */
+    void consume(size_t sent);
+
+    /** everything back to the pool */
+    void release();
+
+    ~BodyRing() {
+      release();
+    }
+  };
+}
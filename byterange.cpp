@@ -6,6 +6,7 @@
 #include "byterange.h"
 
 #include <cheaptricks.h>
+#include <cstdlib>
 
 /* Parse a Range: field into range_begin and range_end.  Only handles the
  * first range if a list is given.  Sets range_{begin,end}_given to true if
@@ -25,25 +26,32 @@ int ByteRange::parse(StringView rangeline) {
     return 498; //todo: error range format not supported
   }
   clear(); //COA, including annoying client giving us more than one Range header
-
-  begin = rangeline.cutNumber();
-  if (begin < 0) { // e.g. -456
-    end = -take(begin);
-    end.given = true;
-  } else {
-    begin.given = true;
-    if (rangeline[0] == '-') {
-      end = rangeline.cutNumber();
-      end.given = end > 0;
+  //was cutNumber on "500-999", which read the second number as -999 and so dropped it. We keep half open intervals, the header's are closed.
+  char *cursor = rangeline.begin();
+  char *after;
+  if (*cursor == '-') { //the last n bytes, begin not given marks that for restrictTo
+    long long count = strtoll(cursor + 1, &after, 10);
+    if (after == cursor + 1 || count <= 0) {
+      return 497;
     }
-    if (begin.given && end.given) {
-      if (end < begin) {
-        return 497;
-      }
+    end = count;
+    return 0;
+  }
+  long long first = strtoll(cursor, &after, 10);
+  if (after == cursor || *after != '-') {
+    return 497;
+  }
+  cursor = after + 1;
+  long long last = strtoll(cursor, &after, 10);
+  if (after != cursor) {
+    if (last < first) {
+      return 497;
     }
+    end = last + 1;
   }
-  //an additional range is presently not supported, we should return an error response.
-  return 499; //todo: proper value
+  begin = first;
+  //an additional range is presently not supported, only the first is honored.
+  return 0;
 }
 
 ByteRange ByteRange::canonical(__off_t st_size) {
@@ -82,15 +90,18 @@ ByteRange ByteRange::canonical(__off_t st_size) {
 }
 
 bool ByteRange::restrictTo(const ByteRange &subset) {
-
-  if (!subset.begin.given) {
-    begin = end-subset.end;//todo: off by one
-    if (begin < 0) {
-      begin = 0;
+  if (!subset.begin.given) { //the last subset.end bytes, or all of it if that is more
+    if (subset.end.number < end.number) {
+      begin = end.number - subset.end.number;
     }
+    return true;
+  }
+  if (subset.begin.number >= end.number) {
+    return false; //starts past the end, 416
   }
-  if (!subset.end.given) {
-//todo:00 complete this logic!
+  begin = subset.begin.number;
+  if (subset.end.given && subset.end.number < end.number) {
+    end = subset.end.number;
   }
   return true;
 }
@@ -105,5 +116,5 @@ off_t ByteRange::getLength() const {
   if (!end.given) {
     return -1;
   }
-  return end-begin;//todo:00 off by one
+  return end - begin; //half open
 }
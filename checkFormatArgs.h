@@ -16,3 +16,12 @@ __attribute__((__format__(__printf__, fmtarg, firstvararg)))
 #define checkFargs(fmtarg, firstvararg)
 #endif
 #endif
+
+// and to quiet it about parameters an override doesn't need:
+#ifndef unused
+#if defined(__GNUC__) || defined(__INTEL_COMPILER)
+#define unused __attribute__((__unused__))
+#else
+#define unused
+#endif
+#endif
@@ -0,0 +1,130 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+#include "clienttable.h"
+
+#include "ticks.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cstring>
+
+using namespace DarkHttpd;
+
+void ClientTable::begin() {
+  if (!enabled()) {
+    return;
+  }
+  unsigned size = Probes;
+  while (size < slots) {
+    size <<= 1;
+  }
+  slots = size;
+  mask = size - 1;
+  table.reset(new Entry[size]);
+  if (rate > 0 && burst < 1) {
+    burst = std::max(rate, 1.0);
+  }
+}
+
+Inaddr6 ClientTable::keyFor(const void *client, bool inet6) {
+  Inaddr6 key;
+  if (inet6) {
+    memcpy(&key, client, sizeof(in6_addr));
+    if (key.isV4compatible()) { //the deprecated ::a.b.c.d form, same client as ::ffff:a.b.c.d
+      key.__in6_u.__u6_addr32[2] = htonl(0xffff);
+    }
+  } else {
+    key.__in6_u.__u6_addr32[2] = htonl(0xffff);
+    memcpy(&key.__in6_u.__u6_addr32[3], client, sizeof(in_addr_t));
+  }
+  return key;
+}
+
+unsigned ClientTable::hash(const Inaddr6 &address) {
+  uint64_t mixed = 0;
+  for (auto word: address.__in6_u.__u6_addr32) {
+    mixed = (mixed ^ word) * 0x9E3779B97F4A7C15ULL;
+  }
+  return unsigned(mixed >> 32);
+}
+
+void ClientTable::refill(Entry &entry, int64_t now) const {
+  if (now > entry.stamp) {
+    entry.tokens = std::min(entry.tokens + rate * Ticks::seconds(now - entry.stamp), burst);
+    entry.stamp = now;
+  }
+}
+
+bool ClientTable::aged(Entry &entry, int64_t now) const {
+  if (entry.connections) {
+    return false;
+  }
+  refill(entry, now);
+  return rate <= 0 || entry.tokens >= burst; //forgetting it then loses nothing, a new entry starts full
+}
+
+ClientTable::Entry *ClientTable::connect(const Inaddr6 &address, int64_t now, bool &refused) {
+  refused = false;
+  if (!table) {
+    return nullptr;
+  }
+  Entry *vacant = nullptr;
+  unsigned home = hash(address);
+  for (unsigned probe = 0; probe < Probes; ++probe) {
+    Entry &entry = table[(home + probe) & mask];
+    if (entry.used && entry.address == address) {
+      if (maxConnections && entry.connections >= maxConnections) {
+        ++stats.refused;
+        refused = true;
+        return nullptr;
+      }
+      if (!entry.connections++) {
+        ++stats.live;
+      }
+      return &entry;
+    }
+    if (!vacant && (!entry.used || aged(entry, now))) {
+      vacant = &entry; //keep looking, the address may be further along
+    }
+    if (!entry.used) {
+      break; //nothing was ever put past here
+    }
+  }
+  if (!vacant) {
+    ++stats.untracked;
+    return nullptr;
+  }
+  if (vacant->used) {
+    ++stats.reused;
+  }
+  ++stats.tracked;
+  ++stats.live;
+  vacant->address = address;
+  vacant->used = true;
+  vacant->connections = 1;
+  vacant->tokens = burst;
+  vacant->stamp = now;
+  return vacant;
+}
+
+void ClientTable::disconnect(Entry *entry) {
+  if (entry && entry->connections && !--entry->connections) {
+    --stats.live;
+  }
+}
+
+bool ClientTable::request(Entry &entry, int64_t now) {
+  if (rate <= 0) {
+    return true;
+  }
+  refill(entry, now);
+  if (entry.tokens < 1) {
+    ++stats.limited;
+    return false;
+  }
+  entry.tokens -= 1;
+  return true;
+}
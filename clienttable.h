@@ -0,0 +1,75 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+#pragma once
+
+#include "addr6.h"
+
+#include <cstdint>
+#include <memory>
+
+namespace DarkHttpd {
+  /** per client address accounting for the abuse limits: live connections, and a token bucket of requests.
+   * A fixed size open addressing table, allocated once, so that a flood from many addresses costs no heap and can't grow us.
+   * Entries age out when the client has no connections and its bucket has refilled, their slots are then reused by whoever probes into them.
+   * When a client's whole probe window is live it isn't tracked, and so isn't limited, rather than evicting someone who is.
+   */
+  class ClientTable {
+  public:
+    struct Entry {
+      Inaddr6 address; //ipv4 clients in their mapped form, so either socket family gives the same key
+      unsigned connections = 0;
+      double tokens = 0;
+      int64_t stamp = 0; //Ticks tokens was last brought up to date
+      bool used = false;
+    };
+
+    /** how far from its home slot an address may land */
+    static constexpr unsigned Probes = 16;
+
+    unsigned slots = 1 << 16; //--client-table, rounded up to a power of two
+    unsigned maxConnections = 0; //--per-client-connections, 0 for no limit
+    double rate = 0; //--per-client-requests, per second, 0 for no limit
+    double burst = 0; //requests an idle client may make at once, defaults to a second's worth
+
+    struct Stats {
+      uint64_t tracked = 0; //entries made
+      uint64_t reused = 0; //of those, in the slot of one aged out
+      uint64_t untracked = 0; //found no room in their probe window
+      uint64_t refused = 0; //connections closed at accept for being over the limit
+      uint64_t limited = 0; //requests answered 429
+      unsigned live = 0; //entries with connections
+    } stats;
+
+    /** allocate the table, once the command line is known */
+    void begin();
+
+    bool enabled() const {
+      return maxConnections || rate > 0;
+    }
+
+    /** @returns the key for @param client as accept gave it, @param inet6 when that was from an ipv6 socket */
+    static Inaddr6 keyFor(const void *client, bool inet6);
+
+    /** a connection from @param address has been accepted, @returns its entry, null if untracked or refused, with @param refused set for the latter */
+    Entry *connect(const Inaddr6 &address, int64_t now, bool &refused);
+
+    /** a connection counted by connect has closed */
+    void disconnect(Entry *entry);
+
+    /** @returns whether the client of @param entry may make another request now */
+    bool request(Entry &entry, int64_t now);
+
+  private:
+    std::unique_ptr<Entry[]> table;
+    unsigned mask = 0;
+
+    static unsigned hash(const Inaddr6 &address);
+
+    void refill(Entry &entry, int64_t now) const;
+
+    bool aged(Entry &entry, int64_t now) const;
+  };
+}
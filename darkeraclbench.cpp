@@ -0,0 +1,152 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+/* Cost of the --allow/--deny check: builds an AccessList of --prefixes random CIDRs, a --v6 fraction of them ipv6, and times compiling it and then --lookups checks.
+ * Half the lookups are addresses inside a random one of the prefixes, half are anywhere, so both the matched and unmatched paths are measured.
+ */
+
+#include "accesslist.h"
+#include "darkerror.h"
+#include "ticks.h"
+
+#include "cliscanner.h"
+#include "stringview.h"
+#include <arpa/inet.h>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace DarkHttpd;
+
+class AclBench {
+  unsigned prefixes = 100000;
+  unsigned lookups = 10000000;
+  double v6 = 0.5;
+  unsigned seed = 1;
+
+  void usage(const char *argv0);
+
+public:
+  bool parse_commandline(int argc, char *argv[]);
+
+  int main(int argc, char *argv[]);
+};
+
+void AclBench::usage(const char *argv0) {
+  printf("usage:\t%s [flags]\n\n", argv0);
+  printf("\t--prefixes count (default: %u), --v6 fraction (default: %.2f)\n\t\tRandom CIDRs in the list, a third of them --allow.\n\n", prefixes, v6);
+  printf("\t--lookups count (default: %u)\n\n", lookups);
+  printf("\t--seed number (default: %u)\n\n", seed);
+}
+
+bool AclBench::parse_commandline(int argc, char *argv[]) {
+  CliScanner arg(argc, argv);
+  const char *invocationName = arg();
+  try {
+    while (arg.stillHas(1)) {
+      StringView token = arg();
+      if (token == "--prefixes") {
+        arg >> prefixes;
+      } else if (token == "--lookups") {
+        arg >> lookups;
+      } else if (token == "--v6") {
+        const char *fraction;
+        arg >> fraction;
+        v6 = atof(fraction);
+      } else if (token == "--seed") {
+        arg >> seed;
+      } else if (token == "--help") {
+        usage(invocationName);
+        return false;
+      } else {
+        return err(-1, "unknown argument `%s'", token.pointer);
+      }
+    }
+    if (v6 < 0 || v6 > 1 || !prefixes || !lookups) {
+      return err(-1, "--v6 must be in [0,1], --prefixes and --lookups nonzero");
+    }
+    return true;
+  } catch (...) {
+    return false;
+  }
+}
+
+int AclBench::main(int argc, char *argv[]) {
+  if (!parse_commandline(argc, argv)) {
+    return EXIT_FAILURE;
+  }
+  std::mt19937_64 random(seed);
+  std::uniform_real_distribution<double> unit(0, 1);
+
+  /* the rules as text, as they'd come from the command line */
+  std::vector<std::string> cidrs;
+  std::vector<Inaddr6> samples; //an address inside each
+  cidrs.reserve(prefixes);
+  samples.reserve(prefixes);
+  char text[INET6_ADDRSTRLEN + 8];
+  for (unsigned index = 0; index < prefixes; ++index) {
+    Inaddr6 address;
+    for (auto &word: address.__in6_u.__u6_addr32) {
+      word = uint32_t(random());
+    }
+    char printed[INET6_ADDRSTRLEN];
+    unsigned length;
+    if (unit(random) < v6) {
+      address.__in6_u.__u6_addr8[0] = 0x20; //global unicast, clear of the mapped range
+      length = 16 + unsigned(random() % 49);
+      inet_ntop(AF_INET6, &address, printed, sizeof(printed));
+    } else {
+      length = 8 + unsigned(random() % 25);
+      address.__in6_u.__u6_addr32[0] = address.__in6_u.__u6_addr32[1] = 0;
+      address.__in6_u.__u6_addr32[2] = htonl(0xffff);
+      inet_ntop(AF_INET, &address.__in6_u.__u6_addr32[3], printed, sizeof(printed));
+    }
+    snprintf(text, sizeof(text), "%s/%u", printed, length);
+    cidrs.emplace_back(text);
+    samples.push_back(address);
+  }
+
+  AccessList list;
+  auto started = Ticks::now();
+  for (unsigned index = 0; index < prefixes; ++index) {
+    list.add(cidrs[index].c_str(), index % 3 == 0);
+  }
+  auto parsed = Ticks::now();
+  list.compile();
+  auto compiled = Ticks::now();
+  printf("%u prefixes: parsed in %.3f ms, compiled in %.3f ms to %zu ranges, %zu bytes\n", prefixes, (parsed - started) / 1e6, (compiled - parsed) / 1e6, list.size(), list.size() * (sizeof(AccessList::Key) + 1));
+
+  /* the addresses to look up, made ahead so that only the checks are timed */
+  std::vector<Inaddr6> probes(lookups);
+  for (auto &probe: probes) {
+    if (random() & 1) {
+      probe = samples[random() % prefixes];
+      probe.__in6_u.__u6_addr8[15] ^= uint8_t(random()); //somewhere else in the same prefix, mostly
+    } else {
+      for (auto &word: probe.__in6_u.__u6_addr32) {
+        word = uint32_t(random());
+      }
+      if (unit(random) >= v6) {
+        probe.__in6_u.__u6_addr32[0] = probe.__in6_u.__u6_addr32[1] = 0;
+        probe.__in6_u.__u6_addr32[2] = htonl(0xffff);
+      }
+    }
+  }
+  uint64_t allowed = 0;
+  started = Ticks::now();
+  for (auto &probe: probes) {
+    allowed += list.allows(probe);
+  }
+  auto took = Ticks::now() - started;
+  printf("%u lookups in %.3f ms, %.1f ns each, %.1f%% allowed\n", lookups, took / 1e6, double(took) / lookups, 100.0 * allowed / lookups);
+  return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[]) {
+  AclBench bench;
+  return bench.main(argc, argv);
+}
@@ -0,0 +1,357 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+/* Heap test for the static keep-alive GET path: runs a darkerhttpd built with DarklyCountAllocations=1 on a scratch wwwroot, warms it up,
+ * then has --connections connections each make --requests keep-alive GETs of a small file, in turn. The server's own tally (SIGUSR1) is read before and after,
+ * any heap call made while answering those requests fails the test. The tally for the other paths is printed, for information. ctest runs this against darkerhttpd_allocs.
+ */
+
+#include "darkerror.h"
+
+#include "cliscanner.h"
+#include "stringview.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <string>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace DarkHttpd;
+
+class AllocTest {
+  const char *server = nullptr;
+  unsigned port = 0; //0 picks a free one, so that parallel ctest runs don't collide
+  unsigned requests = 1000;
+  unsigned connections = 4;
+  unsigned timeoutSecs = 60; //the whole run, so that a hung server fails the test rather than the test runner
+
+  char root[32] = "/tmp/darkerallocsXXXXXX";
+  std::string file;
+  pid_t child = -1;
+  int report = -1; //the server's stdout
+
+  void usage(const char *argv0);
+
+  /** @returns a port nothing is listening on, by binding to port 0, 0 if that failed */
+  unsigned freePort();
+
+  /** @returns whether our server is still running, else a connection would be to some other server */
+  bool serverAlive();
+
+  /** start the server on a scratch wwwroot, @returns false if it couldn't be */
+  bool start();
+
+  void stop();
+
+  /** @returns a socket connected to the server, -1 if it never answered */
+  int connectToServer();
+
+  /** one GET of the static file on @param fd, body read and discarded. @returns whether it was a 200 */
+  bool get(int fd);
+
+  /** a GET on each of @param fds in turn, so that the connections' requests share wakeups as they would under load. @returns whether all were answered */
+  bool round(const std::vector<int> &fds);
+
+  /** the server's tally for the static path, into @param calls and @param served, and its whole heap line into @param line. @returns false if it couldn't be read */
+  bool staticTally(unsigned long long &calls, unsigned long long &served, std::string &line);
+
+public:
+  bool parse_commandline(int argc, char *argv[]);
+
+  int main(int argc, char *argv[]);
+};
+
+void AllocTest::usage(const char *argv0) {
+  printf("usage:\t%s --server path [flags]\n\n", argv0);
+  printf("\t--server path\n\t\tA darkerhttpd built with DarklyCountAllocations=1.\n\n");
+  printf("\t--port number (default: a free one)\n\n");
+  printf("\t--requests number (default: %u), --connections number (default: %u)\n\t\tKeep-alive GETs on each connection, after the warm up.\n\n", requests, connections);
+  printf("\t--timeout secs (default: %u)\n\n", timeoutSecs);
+}
+
+bool AllocTest::parse_commandline(int argc, char *argv[]) {
+  CliScanner arg(argc, argv);
+  const char *invocationName = arg();
+  try {
+    while (arg.stillHas(1)) {
+      StringView token = arg();
+      if (token == "--server") {
+        arg >> server;
+      } else if (token == "--port") {
+        arg >> port;
+      } else if (token == "--requests") {
+        arg >> requests;
+      } else if (token == "--connections") {
+        arg >> connections;
+      } else if (token == "--timeout") {
+        arg >> timeoutSecs;
+      } else if (token == "--help") {
+        usage(invocationName);
+        return false;
+      } else {
+        return err(-1, "unknown argument `%s'", token.pointer);
+      }
+    }
+    if (!server || !requests || !connections) {
+      return err(-1, "--server is required, --requests and --connections must be nonzero");
+    }
+    return true;
+  } catch (...) {
+    return false;
+  }
+}
+
+unsigned AllocTest::freePort() {
+  int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd == -1) {
+    return 0;
+  }
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t length = sizeof(address);
+  unsigned found = 0;
+  if (bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0 && getsockname(fd, reinterpret_cast<sockaddr *>(&address), &length) == 0) {
+    found = ntohs(address.sin_port);
+  }
+  close(fd); //the server binds it a moment later, with SO_REUSEADDR
+  return found;
+}
+
+bool AllocTest::serverAlive() {
+  return child > 0 && waitpid(child, nullptr, WNOHANG) == 0;
+}
+
+bool AllocTest::start() {
+  if (!port) {
+    port = freePort();
+    if (!port) {
+      return err(-1, "no free port");
+    }
+  }
+  if (!mkdtemp(root)) {
+    return err(-1, "mkdtemp(%s)", root);
+  }
+  file = std::string(root) + "/static.txt";
+  FILE *content = fopen(file.c_str(), "w");
+  if (!content) {
+    return err(-1, "create %s", file.c_str());
+  }
+  for (unsigned line = 0; line < 100; ++line) {
+    fprintf(content, "line %u of a small static file\n", line);
+  }
+  fclose(content);
+
+  int out[2];
+  if (pipe(out) == -1) {
+    return err(-1, "pipe");
+  }
+  child = fork();
+  if (child == -1) {
+    return err(-1, "fork");
+  }
+  if (child == 0) {
+    prctl(PR_SET_PDEATHSIG, SIGTERM); //so that a test killed by its alarm doesn't leave the server running
+    dup2(out[1], STDOUT_FILENO);
+    close(out[0]);
+    close(out[1]);
+    char portText[12];
+    snprintf(portText, sizeof(portText), "%u", port);
+    execl(server, server, root, "--port", portText, "--addr", "127.0.0.1", "--keepalive-requests", "0", nullptr); //no request limit, else a long run measures reconnecting
+    fprintf(stderr, "exec %s: %s\n", server, strerror(errno));
+    _exit(127);
+  }
+  close(out[1]);
+  report = out[0];
+  return true;
+}
+
+void AllocTest::stop() {
+  if (child > 0) {
+    kill(child, SIGTERM);
+    waitpid(child, nullptr, 0);
+    child = -1;
+  }
+  if (report != -1) {
+    close(report);
+    report = -1;
+  }
+  if (!file.empty()) {
+    unlink(file.c_str());
+  }
+  rmdir(root);
+}
+
+int AllocTest::connectToServer() {
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  for (unsigned attempt = 0; attempt < 100; ++attempt) { //the server may still be starting
+    if (!serverAlive()) {
+      return -1;
+    }
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+      return -1;
+    }
+    if (connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0) {
+      if (!serverAlive()) { //exited, e.g. the port was taken, so this is someone else's
+        close(fd);
+        return -1;
+      }
+      int one = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      return fd;
+    }
+    close(fd);
+    usleep(50000);
+  }
+  return -1;
+}
+
+bool AllocTest::get(int fd) {
+  static const char request[] = "GET /static.txt HTTP/1.1\r\nHost: localhost\r\nConnection: keep-alive\r\n\r\n";
+  if (send(fd, request, sizeof(request) - 1, MSG_NOSIGNAL) != ssize_t(sizeof(request) - 1)) {
+    return false;
+  }
+  char reply[8192];
+  size_t got = 0;
+  char *body = nullptr;
+  while (!body) {
+    auto more = recv(fd, reply + got, sizeof(reply) - 1 - got, 0);
+    if (more <= 0) {
+      return false;
+    }
+    got += more;
+    reply[got] = 0;
+    body = strstr(reply, "\r\n\r\n");
+    if (!body && got == sizeof(reply) - 1) {
+      return false;
+    }
+  }
+  body += 4;
+  auto length = strcasestr(reply, "\r\nContent-Length:");
+  if (!length || length > body || strncmp(reply, "HTTP/1.1 200", 12)) {
+    return false;
+  }
+  size_t left = strtoull(length + 17, nullptr, 10);
+  size_t have = got - (body - reply);
+  left -= std::min(left, have);
+  while (left) {
+    auto more = recv(fd, reply, std::min(left, sizeof(reply)), 0);
+    if (more <= 0) {
+      return false;
+    }
+    left -= more;
+  }
+  return true;
+}
+
+bool AllocTest::round(const std::vector<int> &fds) {
+  for (auto fd: fds) {
+    if (!get(fd)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool AllocTest::staticTally(unsigned long long &calls, unsigned long long &served, std::string &line) {
+  kill(child, SIGUSR1);
+  std::string text;
+  pollfd ready{report, POLLIN, 0};
+  while (poll(&ready, 1, 2000) == 1) { //the stats come all at once, silence means a server that doesn't count
+    char chunk[4096];
+    auto got = read(report, chunk, sizeof(chunk));
+    if (got <= 0) {
+      break;
+    }
+    text.append(chunk, got);
+    auto heap = text.find("Heap calls:");
+    auto eol = heap == std::string::npos ? heap : text.find('\n', heap);
+    if (eol != std::string::npos) {
+      line = text.substr(heap, eol - heap);
+      auto tally = strstr(line.c_str(), ", static ");
+      return tally && sscanf(tally, ", static %*f/request (%llu calls in %llu)", &calls, &served) == 2;
+    }
+  }
+  return false;
+}
+
+int AllocTest::main(int argc, char *argv[]) {
+  if (!parse_commandline(argc, argv)) {
+    return EXIT_FAILURE;
+  }
+  alarm(timeoutSecs);
+  if (!start()) {
+    stop();
+    return EXIT_FAILURE;
+  }
+  bool passed = false;
+  unsigned long long callsBefore = 0, servedBefore = 0, callsAfter = 0, servedAfter = 0;
+  std::string line;
+  std::vector<int> fds;
+  do {
+    for (unsigned which = 0; which < connections; ++which) {
+      auto fd = connectToServer();
+      if (fd == -1) {
+        err(-1, "couldn't connect to %s on port %u", server, port);
+        break;
+      }
+      fds.push_back(fd);
+    }
+    if (fds.size() < connections) {
+      break;
+    }
+    /* warm up on the same connections: the first requests fill the caches, and the server's timers and pools grow to what this many connections need */
+    if (!round(fds) || !round(fds)) {
+      fprintf(stderr, serverAlive() ? "warm up GET failed\n" : "the server exited, was port %u taken?\n", port);
+      break;
+    }
+    if (!staticTally(callsBefore, servedBefore, line)) {
+      fprintf(stderr, "no heap tally from the server, was it built with DarklyCountAllocations=1?\n");
+      break;
+    }
+    bool ok = true;
+    for (unsigned count = 0; ok && count < requests; ++count) {
+      ok = round(fds);
+    }
+    if (!ok) {
+      fprintf(stderr, "a keep-alive GET failed\n");
+      break;
+    }
+    if (!staticTally(callsAfter, servedAfter, line)) {
+      fprintf(stderr, "no heap tally from the server after the run\n");
+      break;
+    }
+    auto calls = callsAfter - callsBefore;
+    auto served = servedAfter - servedBefore;
+    printf("server's tally since it started: %s\n", line.c_str());
+    printf("static keep-alive GETs: %llu served, %llu heap calls, %.3f/request\n", served, calls, served ? double(calls) / served : 0.0);
+    passed = served == 1ull * requests * connections && calls == 0;
+  } while (false);
+  for (auto fd: fds) {
+    close(fd);
+  }
+  stop();
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char *argv[]) {
+  AllocTest test;
+  return test.main(argc, argv);
+}
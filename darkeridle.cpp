@@ -0,0 +1,431 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+/* C100K harness: ramps up to --connections mostly idle keep-alive connections against a local darkerhttpd, in --step increments.
+ * A fraction of them send a request every --interval, the rest just sit there.
+ * At each step the server's RSS and cpu use are sampled from /proc so that the cost of an idle connection (memory and per wakeup cpu) can be tracked as Connection and the timeout scan are reworked.
+ * Accept latency is measured by opening fresh probe connections at each step and timing from connect() to the end of their first reply.
+ * Run the server with a --timeout longer than the test, else it will reap the idle connections, which is reported as "dropped".
+ */
+
+#include "darkerror.h"
+#include "loadclient.h"
+#include "ticks.h"
+
+#include "cliscanner.h"
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/epoll.h>
+#include <vector>
+
+using namespace DarkHttpd;
+
+/** what /proc tells us about the server */
+struct ServerProbe {
+  pid_t pid = 0;
+
+  struct Sample {
+    int64_t at = 0; //Ticks
+    long rssKb = 0;
+    int64_t cpuNs = 0; //total time on cpu
+    uint64_t slices = 0; //times it was scheduled, which for an epoll loop is wakeups
+  };
+
+  bool take(Sample &sample) const;
+};
+
+bool ServerProbe::take(Sample &sample) const {
+  sample.at = Ticks::now();
+  if (!pid) {
+    return false;
+  }
+  char path[64];
+  snprintf(path, sizeof(path), "/proc/%d/status", int(pid));
+  FILE *status = fopen(path, "r");
+  if (!status) {
+    return false;
+  }
+  char line[256];
+  while (fgets(line, sizeof(line), status)) {
+    if (strncmp(line, "VmRSS:", 6) == 0) {
+      sample.rssKb = atol(line + 6);
+      break;
+    }
+  }
+  fclose(status);
+
+  snprintf(path, sizeof(path), "/proc/%d/schedstat", int(pid));
+  FILE *sched = fopen(path, "r");
+  if (!sched) {
+    return false;
+  }
+  unsigned long long cpu = 0, waited = 0, slices = 0;
+  bool happy = fscanf(sched, "%llu %llu %llu", &cpu, &waited, &slices) == 3;
+  fclose(sched);
+  sample.cpuNs = int64_t(cpu);
+  sample.slices = slices;
+  return happy;
+}
+
+class IdleHarness;
+
+/** a connection that only connects, then notices if the server drops it. A few dozen bytes each so that we can have 100k of them. */
+class IdleClient : public EpollHandler {
+  IdleHarness &harness;
+  Fd socket;
+  bool connecting = false;
+
+public:
+  IdleClient(IdleHarness &harness) : harness{harness} {}
+
+  ~IdleClient() override {
+    close();
+  }
+
+  bool open();
+
+  void close();
+
+  void onEpoll(unsigned epoll_flags) override;
+};
+
+class IdleHarness : public LoadClient::Driver {
+  friend IdleClient;
+  LoadEpoller epoller;
+  LoadTarget target;
+  UrlMix mix;
+  ServerProbe server;
+
+  unsigned connections = 10000;
+  unsigned step = 0; //defaults to a tenth of connections
+  unsigned settle = 5; //seconds to measure at each step
+  double activeFraction = 0.01;
+  unsigned interval = 1000; //ms between requests on each active connection
+  unsigned probes = 20;
+  unsigned burst = 1000; //connects started per tick, so we don't overflow the server's listen backlog
+  bool reopen = false;
+  bool signalServer = false;
+
+  std::vector<IdleClient *> idlers;
+  std::vector<LoadClient *> actives;
+  std::vector<int64_t> activeDue;
+  LoadStats activeStats;
+  LoadStats probeStats;
+
+  /* idle connection accounting */
+  unsigned pending = 0; //connects in progress
+  unsigned connected = 0;
+  uint64_t dropped = 0;
+  uint64_t failed = 0;
+
+  NanoSeconds tick{0.01};
+
+  void usage(const char *argv0);
+
+  void runFor(int64_t ns);
+
+  void pace(int64_t now);
+
+  void grow(unsigned total);
+
+  void probe();
+
+public:
+  bool parse_commandline(int argc, char *argv[]);
+
+  void onCapacity(LoadClient &client) override;
+
+  int main(int argc, char *argv[]);
+};
+
+bool IdleClient::open() {
+  socket = harness.target.connectNonblocking();
+  if (!socket.seemsOk()) {
+    ++harness.failed;
+    return false;
+  }
+  connecting = true;
+  ++harness.pending;
+  harness.epoller.watch(socket, EPOLLOUT, *this);
+  return true;
+}
+
+void IdleClient::close() {
+  if (socket.seemsOk()) {
+    harness.epoller.remove(socket);
+    socket.close();
+  }
+}
+
+void IdleClient::onEpoll(unsigned epoll_flags) {
+  if (connecting) {
+    connecting = false;
+    --harness.pending;
+    int error = 0;
+    socklen_t errlen = sizeof(error);
+    getsockopt(socket, SOL_SOCKET, SO_ERROR, &error, &errlen);
+    if (error || (epoll_flags & (EPOLLERR | EPOLLHUP))) {
+      ++harness.failed;
+      close();
+      return;
+    }
+    ++harness.connected;
+    harness.epoller.remove(socket);
+    harness.epoller.watch(socket, EPOLLIN | EPOLLRDHUP, *this);
+    return;
+  }
+  //an idle connection has nothing to read, so any event is the server hanging up on us.
+  --harness.connected;
+  ++harness.dropped;
+  close();
+  if (harness.reopen) {
+    open();
+  }
+}
+
+void IdleHarness::usage(const char *argv0) {
+  printf("usage:\t%s --pid server_pid [flags]\n\n", argv0);
+  printf("\t--host ip (default: %s), --port number (default: %u)\n\n", target.host, target.port);
+  printf("\t--sources n (default: none)\n\t\tBind to 127.0.0.1..n round robin, needed past ~28k connections to loopback.\n\n");
+  printf("\t--pid number\n\t\tThe server process to sample RSS and cpu of.\n\n");
+  printf("\t--connections number (default: %u)\n\t\tConnections to ramp up to.\n\n", connections);
+  printf("\t--step number (default: connections/10)\n\n");
+  printf("\t--settle secs (default: %u)\n\t\tMeasuring time at each step.\n\n", settle);
+  printf("\t--active fraction (default: %g)\n\t\tFraction of connections that send requests.\n\n", activeFraction);
+  printf("\t--interval ms (default: %u)\n\t\tTime between requests on each active connection.\n\n", interval);
+  printf("\t--url /path (default: /)\n\t\tWhat the active and probe connections fetch.\n\n");
+  printf("\t--probes number (default: %u)\n\t\tFresh connections per step used to measure accept latency.\n\n", probes);
+  printf("\t--burst number (default: %u)\n\t\tConnects started per 10ms while ramping.\n\n", burst);
+  printf("\t--reopen\n\t\tReplace idle connections that the server drops.\n\n");
+  printf("\t--signal\n\t\tSend SIGUSR1 to the server after each step so it prints its own wakeup counters.\n\n");
+}
+
+bool IdleHarness::parse_commandline(int argc, char *argv[]) {
+  CliScanner arg(argc, argv);
+  const char *invocationName = arg();
+  const char *url = "/";
+  try {
+    while (arg.stillHas(1)) {
+      StringView token = arg();
+      if (token == "--host") {
+        arg >> target.host;
+      } else if (token == "--port") {
+        arg >> target.port;
+      } else if (token == "--sources") {
+        arg >> target.sources;
+      } else if (token == "--pid") {
+        arg >> server.pid;
+      } else if (token == "--connections") {
+        arg >> connections;
+      } else if (token == "--step") {
+        arg >> step;
+      } else if (token == "--settle") {
+        arg >> settle;
+      } else if (token == "--active") {
+        const char *fraction;
+        arg >> fraction;
+        activeFraction = atof(fraction);
+      } else if (token == "--interval") {
+        arg >> interval;
+      } else if (token == "--url") {
+        arg >> url;
+      } else if (token == "--probes") {
+        arg >> probes;
+      } else if (token == "--burst") {
+        arg >> burst;
+      } else if (token == "--reopen") {
+        reopen = true;
+      } else if (token == "--signal") {
+        signalServer = true;
+      } else if (token == "--help") {
+        usage(invocationName);
+        return false;
+      } else {
+        return err(-1, "unknown argument `%s'", token.pointer);
+      }
+    }
+    if (!target.resolve()) {
+      return err(-1, "--host must be a numeric address, got `%s'", target.host);
+    }
+    if (!mix.add(url, 1, target)) {
+      return err(-1, "urls must start with a slash: `%s'", url);
+    }
+    if (!server.pid) {
+      fprintf(stderr, "no --pid given, server RSS and cpu will not be reported\n");
+    }
+    if (step == 0) {
+      step = std::max(1u, connections / 10);
+    }
+    if (activeFraction < 0 || activeFraction > 1 || interval == 0 || burst == 0) {
+      return err(-1, "--active must be in [0,1], --interval and --burst nonzero");
+    }
+    return true;
+  } catch (...) {
+    return false;
+  }
+}
+
+void IdleHarness::onCapacity(LoadClient &client) {
+  if (!client.isConnected()) {
+    client.open();
+  }
+  //active clients are paced by pace(), probes send exactly one request.
+}
+
+void IdleHarness::pace(int64_t now) {
+  int64_t period = int64_t(interval) * Ticks::perMilli;
+  for (size_t index = actives.size(); index-- > 0;) {
+    auto client = actives[index];
+    auto &due = activeDue[index];
+    if (due <= now && client->hasCapacity()) {
+      client->submit(mix.pick(), due);
+      due += period;
+      if (due < now) { //fell way behind, don't try to catch up with a burst, latency already tells that story.
+        due = now + period;
+      }
+    }
+  }
+}
+
+void IdleHarness::runFor(int64_t ns) {
+  int64_t finish = Ticks::now() + ns;
+  int64_t now;
+  while ((now = Ticks::now()) < finish) {
+    pace(now);
+    epoller.loop(tick);
+  }
+}
+
+void IdleHarness::grow(unsigned total) {
+  unsigned wantActive = unsigned(total * activeFraction + 0.5);
+  int64_t period = int64_t(interval) * Ticks::perMilli;
+  while (idlers.size() + actives.size() < total) {
+    for (unsigned started = 0; started < burst && idlers.size() + actives.size() < total; ++started) {
+      if (actives.size() < wantActive) {
+        auto client = new LoadClient(epoller, target, *this, activeStats);
+        actives.push_back(client);
+        activeDue.push_back(Ticks::now() + period * (actives.size() % 16) / 16); //stagger so they don't all fire at once
+        client->open();
+      } else {
+        auto idler = new IdleClient(*this);
+        idlers.push_back(idler);
+        idler->open();
+      }
+    }
+    pace(Ticks::now());
+    epoller.loop(tick);
+  }
+  //let the stragglers finish connecting
+  int64_t giveUp = Ticks::now() + 10 * Ticks::perSecond;
+  while (pending && Ticks::now() < giveUp) {
+    pace(Ticks::now());
+    epoller.loop(tick);
+  }
+}
+
+void IdleHarness::probe() {
+  std::vector<LoadClient *> probing;
+  for (unsigned count = probes; count-- > 0;) {
+    auto client = new LoadClient(epoller, target, *this, probeStats);
+    probing.push_back(client);
+    if (client->open()) {
+      client->submit(mix.pick(), Ticks::now()); //queued until connected, so latency includes the accept
+    }
+  }
+  int64_t giveUp = Ticks::now() + 5 * Ticks::perSecond;
+  bool waiting = true;
+  while (waiting && Ticks::now() < giveUp) {
+    pace(Ticks::now());
+    epoller.loop(tick);
+    waiting = false;
+    for (auto client: probing) {
+      waiting |= client->outstanding() != 0;
+    }
+  }
+  for (auto client: probing) {
+    delete client;
+  }
+}
+
+static double perSecond(double amount, int64_t ticks) {
+  return ticks > 0 ? amount / Ticks::seconds(ticks) : 0;
+}
+
+int IdleHarness::main(int argc, char *argv[]) {
+  try {
+    if (!parse_commandline(argc, argv)) {
+      return EXIT_FAILURE;
+    }
+    auto gotFds = raiseFdLimit(connections + probes + 64);
+    if (gotFds < connections + probes + 16) {
+      fprintf(stderr, "only %llu file descriptors available, raise the hard limit (ulimit -Hn) to reach %u\n", static_cast<unsigned long long>(gotFds), connections);
+    }
+    signal(SIGPIPE, SIG_IGN);
+    idlers.reserve(connections);
+
+    ServerProbe::Sample baseline;
+    server.take(baseline);
+    printf("server pid %d baseline RSS %ld kB, %u%% of connections active at one request per %u ms\n", int(server.pid), baseline.rssKb, unsigned(activeFraction * 100), interval);
+    printf("%8s %8s %8s %9s %9s %9s %10s %9s %9s %9s %9s %9s\n",
+      "conns", "up", "dropped", "RSS MiB", "B/conn", "cpu ms/s", "ns/s/conn", "wakeup/s", "us/wakeup", "acc p50", "acc p99", "act p99");
+
+    for (unsigned total = std::min(step, connections); total <= connections; total += step) {
+      grow(total);
+      ServerProbe::Sample before, after;
+      server.take(before);
+      activeStats.latency.clear();
+      runFor(int64_t(settle) * Ticks::perSecond);
+      server.take(after);
+      probeStats.latency.clear();
+      probe();
+      if (signalServer && server.pid) {
+        kill(server.pid, SIGUSR1);
+      }
+
+      auto elapsed = after.at - before.at;
+      auto cpuPerSecond = perSecond(after.cpuNs - before.cpuNs, elapsed);
+      auto wakeups = after.slices - before.slices;
+      unsigned up = connected + unsigned(actives.size());
+      printf("%8u %8u %8llu %9.1f %9.0f %9.3f %10.1f %9.0f %9.2f %9.3f %9.3f %9.3f\n",
+        total, up, static_cast<unsigned long long>(dropped),
+        after.rssKb / 1024.0,
+        up ? (after.rssKb - baseline.rssKb) * 1024.0 / up : 0.0,
+        cpuPerSecond / 1e6,
+        up ? cpuPerSecond / up : 0.0,
+        perSecond(wakeups, elapsed),
+        wakeups ? (after.cpuNs - before.cpuNs) / 1e3 / wakeups : 0.0,
+        probeStats.latency.percentile(50) / 1e6, probeStats.latency.percentile(99) / 1e6,
+        activeStats.latency.percentile(99) / 1e6);
+      fflush(stdout);
+      if (total == connections) {
+        break;
+      }
+      if (total + step > connections) {
+        total = connections - step; //so the last step lands exactly on connections
+      }
+    }
+    printf("connect failures: %llu, active requests lost: %llu, probe requests lost: %llu\n",
+      static_cast<unsigned long long>(failed + activeStats.connectFailures), static_cast<unsigned long long>(activeStats.errors), static_cast<unsigned long long>(probeStats.errors));
+
+    for (auto idler: idlers) {
+      delete idler;
+    }
+    for (auto client: actives) {
+      delete client;
+    }
+    return EXIT_SUCCESS;
+  } catch (DarkException &ex) {
+    return ex.returncode;
+  }
+}
+
+int main(int argc, char *argv[]) {
+  IdleHarness harness;
+  return harness.main(argc, argv);
+}
@@ -0,0 +1,268 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+/* HTTP load generator built on the same event loop as the server, so that we don't need wrk or ab to exercise darkerhttpd.
+ * Closed loop: each connection keeps --depth requests outstanding, as fast as the server answers.
+ * Open loop: requests are due at --rate per second regardless of how the server is doing, latency is measured from when each was due (no coordinated omission).
+ */
+
+#include "darkerror.h"
+#include "loadclient.h"
+#include "ticks.h"
+
+#include "cliscanner.h"
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace DarkHttpd;
+
+class LoadRun : public LoadClient::Driver {
+  LoadEpoller epoller;
+  LoadTarget target;
+  UrlMix mix;
+  LoadStats stats;
+  std::vector<LoadClient *> clients;
+
+  unsigned connections = 64;
+  unsigned depth = 1;
+  unsigned rate = 0; //requests per second across all connections, 0 for closed loop.
+  unsigned seconds = 10;
+  bool fullHistogram = false;
+  bool running = false;
+
+  /* open loop bookkeeping */
+  int64_t started = 0;
+  uint64_t scheduled = 0;
+  std::vector<int64_t> backlog; //due times of requests that no connection had room for, used as a ring
+  size_t backlogHead = 0;
+  size_t backlogCount = 0;
+  std::vector<LoadClient *> spare; //clients that had room the last time we looked
+
+  void usage(const char *argv0);
+
+  void dispatch();
+
+  void schedule(int64_t now);
+
+public:
+  bool parse_commandline(int argc, char *argv[]);
+
+  void onCapacity(LoadClient &client) override;
+
+  int main(int argc, char *argv[]);
+};
+
+void LoadRun::usage(const char *argv0) {
+  printf("usage:\t%s [flags] --url /path [--url /other ...]\n\n", argv0);
+  printf("\t--host ip (default: %s)\n\t\tServer address, numeric ipv4 or ipv6.\n\n", target.host);
+  printf("\t--port number (default: %u)\n\n", target.port);
+  printf("\t--sources n (default: none)\n\t\tBind to 127.0.0.1..n round robin, for more than ~28k connections to loopback.\n\n");
+  printf("\t--connections number (default: %u)\n\t\tConcurrent keep-alive connections.\n\n", connections);
+  printf("\t--depth number (default: %u)\n\t\tRequests pipelined on each connection.\n\n", depth);
+  printf("\t--rate number (default: closed loop)\n"
+    "\t\tOpen loop: total requests per second, latency is measured from when each request was due.\n\n");
+  printf("\t--duration secs (default: %u)\n\n", seconds);
+  printf("\t--url /path\n\t\tAdd a url to the mix, weight 1. May be repeated.\n\n");
+  printf("\t--urls filename\n\t\tRead lines of \"[weight] /path\" into the mix.\n\n");
+  printf("\t--no-keepalive\n\t\tOne request per connection.\n\n");
+  printf("\t--expected-interval usecs\n\t\tClosed loop coordinated omission correction, the interval each connection is expected to sustain.\n\n");
+  printf("\t--histogram\n\t\tPrint the full percentile distribution.\n\n");
+}
+
+bool LoadRun::parse_commandline(int argc, char *argv[]) {
+  CliScanner arg(argc, argv);
+  const char *invocationName = arg();
+  std::vector<const char *> urls; //deferred until we know host and keepalive
+  std::vector<const char *> urlFiles;
+  try {
+    while (arg.stillHas(1)) {
+      StringView token = arg();
+      if (token == "--host") {
+        arg >> target.host;
+      } else if (token == "--port") {
+        arg >> target.port;
+      } else if (token == "--sources") {
+        arg >> target.sources;
+      } else if (token == "--connections") {
+        arg >> connections;
+      } else if (token == "--depth") {
+        arg >> depth;
+      } else if (token == "--rate") {
+        arg >> rate;
+      } else if (token == "--duration") {
+        arg >> seconds;
+      } else if (token == "--url") {
+        const char *url;
+        arg >> url;
+        urls.push_back(url);
+      } else if (token == "--urls") {
+        const char *fileName;
+        arg >> fileName;
+        urlFiles.push_back(fileName);
+      } else if (token == "--no-keepalive") {
+        mix.keepalive = false;
+      } else if (token == "--expected-interval") {
+        unsigned micros;
+        arg >> micros;
+        stats.expectedInterval = uint64_t(micros) * 1000;
+      } else if (token == "--histogram") {
+        fullHistogram = true;
+      } else if (token == "--help") {
+        usage(invocationName);
+        return false;
+      } else {
+        return err(-1, "unknown argument `%s'", token.pointer);
+      }
+    }
+    if (!target.resolve()) {
+      return err(-1, "--host must be a numeric address, got `%s'", target.host);
+    }
+    for (auto url: urls) {
+      if (!mix.add(url, 1, target)) {
+        return err(-1, "urls must start with a slash: `%s'", url);
+      }
+    }
+    for (auto fileName: urlFiles) {
+      if (!mix.load(fileName, target)) {
+        return err(errno, "reading url list %s", fileName);
+      }
+    }
+    if (!mix) {
+      usage(invocationName);
+      return false;
+    }
+    if (connections == 0 || depth == 0) {
+      return err(-1, "--connections and --depth must be at least 1");
+    }
+    return true;
+  } catch (...) {
+    return false;
+  }
+}
+
+void LoadRun::onCapacity(LoadClient &client) {
+  if (!running) {
+    return;
+  }
+  if (!client.isConnected()) {
+    client.open(); //lost it or server said close, replace it so the offered load stays the same.
+    return;
+  }
+  if (rate == 0) {
+    while (client.hasCapacity()) {
+      if (!client.submit(mix.pick(), Ticks::now())) {
+        break;
+      }
+    }
+    return;
+  }
+  while (backlogCount && client.hasCapacity()) {
+    if (!client.submit(mix.pick(), backlog[backlogHead])) {
+      break;
+    }
+    backlogHead = (backlogHead + 1) % backlog.size();
+    --backlogCount;
+  }
+  if (client.hasCapacity() && !client.listed) {
+    client.listed = true;
+    spare.push_back(&client);
+  }
+}
+
+void LoadRun::schedule(int64_t now) {
+  uint64_t due = uint64_t(now - started) * rate / Ticks::perSecond;
+  while (scheduled < due) {
+    int64_t dueAt = started + int64_t(scheduled++ * Ticks::perSecond / rate);
+    if (backlogCount == backlog.size()) {
+      ++stats.sent;
+      ++stats.errors; //the generator is hopelessly behind, which is itself a result.
+      continue;
+    }
+    backlog[(backlogHead + backlogCount++) % backlog.size()] = dueAt;
+  }
+}
+
+void LoadRun::dispatch() {
+  while (backlogCount && !spare.empty()) {
+    auto client = spare.back();
+    if (!client->hasCapacity() || !client->submit(mix.pick(), backlog[backlogHead])) {
+      client->listed = false;
+      spare.pop_back();
+      continue;
+    }
+    backlogHead = (backlogHead + 1) % backlog.size();
+    --backlogCount;
+  }
+}
+
+static volatile bool interrupted = false;
+
+static void stop_running(int) {
+  interrupted = true;
+}
+
+int LoadRun::main(int argc, char *argv[]) {
+  try {
+    if (!parse_commandline(argc, argv)) {
+      return EXIT_FAILURE;
+    }
+    auto gotFds = raiseFdLimit(connections + 64);
+    if (gotFds < connections + 16) {
+      fprintf(stderr, "only %llu file descriptors available, connections will fail\n", static_cast<unsigned long long>(gotFds));
+    }
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, stop_running);
+
+    if (rate) {
+      backlog.resize(std::max<size_t>(rate, 1024) * 4); //4 seconds of falling behind before we start dropping
+      spare.reserve(connections * 2);
+    }
+    clients.reserve(connections);
+    running = true;
+    for (unsigned count = connections; count-- > 0;) {
+      auto client = new LoadClient(epoller, target, *this, stats);
+      client->depth = depth;
+      clients.push_back(client);
+      client->open();
+    }
+
+    printf("%s loop load on %s:%u, %u connections, depth %u, %zu urls, %u seconds", rate ? "open" : "closed", target.host, target.port, connections, depth, mix.size(), seconds);
+    if (rate) {
+      printf(", %u requests/s", rate);
+    }
+    printf("\n");
+
+    NanoSeconds tick(0.001); //pacing resolution for open loop, and how often we look at the clock.
+    started = Ticks::now();
+    int64_t finish = started + int64_t(seconds) * Ticks::perSecond;
+    int64_t now;
+    while (!interrupted && (now = Ticks::now()) < finish) {
+      if (rate) {
+        schedule(now);
+        dispatch();
+      }
+      epoller.loop(tick);
+    }
+    running = false;
+    double elapsed = Ticks::seconds(Ticks::now() - started);
+    for (auto client: clients) {
+      delete client;
+    }
+    clients.clear();
+    stats.report(stdout, "darkerload", elapsed, fullHistogram);
+    return stats.errors ? 2 : EXIT_SUCCESS;
+  } catch (DarkException &ex) {
+    return ex.returncode;
+  }
+}
+
+int main(int argc, char *argv[]) {
+  LoadRun run;
+  return run.main(argc, argv);
+}
@@ -0,0 +1,263 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+/* Slow client harness: a fixed set of --fast closed loop clients is measured while the number of attached slow clients grows by --step up to --slow.
+ * Slow clients trickle their request header a byte at a time (slowloris), read the reply at a throttled rate, stall part way through the body, or half-close then read slowly.
+ * Each row shows what the fast clients got while that many slow ones were attached, and how long the server put up with the slow ones.
+ * Pair with the server's --torture-sndbuf to also squeeze its side of the connection.
+ */
+
+#include "darkerror.h"
+#include "loadclient.h"
+#include "slowclient.h"
+#include "ticks.h"
+
+#include "cliscanner.h"
+#include <algorithm>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace DarkHttpd;
+
+class SlowHarness : public LoadClient::Driver {
+  LoadEpoller epoller;
+  LoadTarget target;
+  UrlMix fastMix;
+  UrlMix slowMix;
+
+  unsigned fast = 16;
+  unsigned slow = 256;
+  unsigned step = 0; //defaults to a quarter of slow
+  unsigned seconds = 10; //per row
+  bool mixModes = true;
+  SlowClient::Mode mode = SlowClient::Trickle;
+  unsigned readRate = 1024;
+  unsigned trickleMs = 1000;
+  unsigned stallAfter = 4096;
+
+  std::vector<LoadClient *> fasts;
+  std::vector<SlowClient *> slows;
+  LoadStats fastStats;
+  LoadStats slowStats;
+  LatencyHistogram held; //how long the server kept a slow client's connection
+  uint64_t slowEnded = 0;
+
+  /** slow clients report to this so they can be told apart from fast ones */
+  struct SlowDriver : LoadClient::Driver {
+    SlowHarness &harness;
+
+    SlowDriver(SlowHarness &harness) : harness{harness} {}
+
+    void onCapacity(LoadClient &client) override {
+      harness.onSlowCapacity(static_cast<SlowClient &>(client));
+    }
+  } slowDriver{*this};
+
+  NanoSeconds tick{0.005};
+
+  void usage(const char *argv0);
+
+  void onSlowCapacity(SlowClient &client);
+
+  void attach(unsigned total);
+
+public:
+  bool parse_commandline(int argc, char *argv[]);
+
+  void onCapacity(LoadClient &client) override;
+
+  int main(int argc, char *argv[]);
+};
+
+void SlowHarness::usage(const char *argv0) {
+  printf("usage:\t%s [flags] --url /fast/path\n\n", argv0);
+  printf("\t--host ip (default: %s), --port number (default: %u)\n\n", target.host, target.port);
+  printf("\t--sources n (default: none)\n\t\tBind to 127.0.0.1..n round robin, for more than ~28k connections to loopback.\n\n");
+  printf("\t--fast number (default: %u)\n\t\tClosed loop clients whose latency is measured.\n\n", fast);
+  printf("\t--slow number (default: %u)\n\t\tSlow clients to ramp up to.\n\n", slow);
+  printf("\t--step number (default: slow/4)\n\n");
+  printf("\t--duration secs (default: %u)\n\t\tMeasuring time per row.\n\n", seconds);
+  printf("\t--mode trickle|slowread|stall|halfclose|mix (default: mix)\n\t\tWhat the slow clients do, mix gives each client the next mode in turn.\n\n");
+  printf("\t--url /path\n\t\tWhat the fast clients fetch.\n\n");
+  printf("\t--slow-url /path (default: same as --url)\n\t\tWhat the slow clients fetch, something large makes slow reads hurt more.\n\n");
+  printf("\t--read-rate bytes/s (default: %u)\n\n", readRate);
+  printf("\t--trickle-ms ms (default: %u)\n\t\tTime between request header bytes.\n\n", trickleMs);
+  printf("\t--stall-after bytes (default: %u)\n\n", stallAfter);
+}
+
+bool SlowHarness::parse_commandline(int argc, char *argv[]) {
+  CliScanner arg(argc, argv);
+  const char *invocationName = arg();
+  const char *url = nullptr;
+  const char *slowUrl = nullptr;
+  try {
+    while (arg.stillHas(1)) {
+      StringView token = arg();
+      if (token == "--host") {
+        arg >> target.host;
+      } else if (token == "--port") {
+        arg >> target.port;
+      } else if (token == "--sources") {
+        arg >> target.sources;
+      } else if (token == "--fast") {
+        arg >> fast;
+      } else if (token == "--slow") {
+        arg >> slow;
+      } else if (token == "--step") {
+        arg >> step;
+      } else if (token == "--duration") {
+        arg >> seconds;
+      } else if (token == "--mode") {
+        const char *name;
+        arg >> name;
+        mixModes = StringView(const_cast<char *>(name)) == "mix";
+        if (!mixModes && !SlowClient::parseMode(name, mode)) {
+          return err(-1, "unknown --mode `%s'", name);
+        }
+      } else if (token == "--url") {
+        arg >> url;
+      } else if (token == "--slow-url") {
+        arg >> slowUrl;
+      } else if (token == "--read-rate") {
+        arg >> readRate;
+      } else if (token == "--trickle-ms") {
+        arg >> trickleMs;
+      } else if (token == "--stall-after") {
+        arg >> stallAfter;
+      } else if (token == "--help") {
+        usage(invocationName);
+        return false;
+      } else {
+        return err(-1, "unknown argument `%s'", token.pointer);
+      }
+    }
+    if (!url) {
+      usage(invocationName);
+      return false;
+    }
+    if (!target.resolve()) {
+      return err(-1, "--host must be a numeric address, got `%s'", target.host);
+    }
+    if (!fastMix.add(url, 1, target) || !slowMix.add(slowUrl ? slowUrl : url, 1, target)) {
+      return err(-1, "urls must start with a slash");
+    }
+    if (step == 0) {
+      step = std::max(1u, slow / 4);
+    }
+    if (fast == 0 || readRate == 0) {
+      return err(-1, "--fast and --read-rate must be nonzero");
+    }
+    return true;
+  } catch (...) {
+    return false;
+  }
+}
+
+void SlowHarness::onCapacity(LoadClient &client) {
+  if (!client.isConnected()) {
+    client.open();
+    return;
+  }
+  while (client.hasCapacity()) {
+    if (!client.submit(fastMix.pick(), Ticks::now())) {
+      break;
+    }
+  }
+}
+
+void SlowHarness::onSlowCapacity(SlowClient &client) {
+  auto now = Ticks::now();
+  if (!client.reusable()) {
+    if (client.openedAt) {
+      held.record(now - client.openedAt);
+      ++slowEnded;
+    }
+    client.open(); //keep the slow population constant
+    return;
+  }
+  if (client.hasCapacity()) {
+    client.submit(slowMix.pick(), now);
+  }
+}
+
+void SlowHarness::attach(unsigned total) {
+  while (slows.size() < total) {
+    auto which = mixModes ? SlowClient::Mode(slows.size() % 4) : mode;
+    auto client = new SlowClient(epoller, target, slowDriver, slowStats, which);
+    client->readRate = readRate;
+    client->trickleInterval = int64_t(trickleMs) * Ticks::perMilli;
+    client->stallAfter = stallAfter;
+    slows.push_back(client);
+    client->open();
+  }
+}
+
+int SlowHarness::main(int argc, char *argv[]) {
+  try {
+    if (!parse_commandline(argc, argv)) {
+      return EXIT_FAILURE;
+    }
+    raiseFdLimit(fast + slow + 64);
+    signal(SIGPIPE, SIG_IGN);
+
+    for (unsigned count = fast; count-- > 0;) {
+      auto client = new LoadClient(epoller, target, *this, fastStats);
+      fasts.push_back(client);
+      client->open();
+    }
+
+    printf("%u fast clients, slow clients doing %s, %u s per row\n", fast, mixModes ? "a mix of everything" : SlowClient::modeName(mode), seconds);
+    printf("%6s %9s %9s %9s %9s %9s %7s %9s %11s\n", "slow", "attached", "fast r/s", "p50 ms", "p99 ms", "p99.9 ms", "lost", "ended", "held p50 s");
+    for (unsigned total = 0;; total = std::min(total + step, slow)) {
+      attach(total);
+      fastStats.latency.clear();
+      auto completedBefore = fastStats.completed;
+      auto lostBefore = fastStats.errors;
+      auto endedBefore = slowEnded;
+      held.clear();
+
+      int64_t started = Ticks::now();
+      int64_t finish = started + int64_t(seconds) * Ticks::perSecond;
+      int64_t now;
+      while ((now = Ticks::now()) < finish) {
+        for (auto client: slows) {
+          client->tick(now);
+        }
+        epoller.loop(tick);
+      }
+      unsigned attached = 0;
+      for (auto client: slows) {
+        attached += client->isConnected();
+      }
+      printf("%6u %9u %9.1f %9.3f %9.3f %9.3f %7llu %9llu %11.2f\n", total, attached,
+        (fastStats.completed - completedBefore) / Ticks::seconds(now - started),
+        fastStats.latency.percentile(50) / 1e6, fastStats.latency.percentile(99) / 1e6, fastStats.latency.percentile(99.9) / 1e6,
+        static_cast<unsigned long long>(fastStats.errors - lostBefore), static_cast<unsigned long long>(slowEnded - endedBefore),
+        held.percentile(50) / 1e9);
+      fflush(stdout);
+      if (total == slow) {
+        break;
+      }
+    }
+    slowStats.report(stdout, "slow clients, whole run", 0, false);
+
+    for (auto client: fasts) {
+      delete client;
+    }
+    for (auto client: slows) {
+      delete client;
+    }
+    return EXIT_SUCCESS;
+  } catch (DarkException &ex) {
+    return ex.returncode;
+  }
+}
+
+int main(int argc, char *argv[]) {
+  SlowHarness harness;
+  return harness.main(argc, argv);
+}
@@ -40,6 +40,7 @@
 #include "directorylisting.h"
 #include "fd.h"
 #include "htmldirlister.h"
+#include "listingstream.h"
 
 static const char pkgname[] = "darkhttpd/1.16.from.git/980f";
 static const char copyright[] = "copyright (c) 2003-2024 Emil Mikulic"
@@ -69,6 +70,7 @@ static const char copyright[] = "copyright (c) 2003-2024 Emil Mikulic"
 #include <netinet/tcp.h>
 #include <sys/resource.h>  //used by reportstats
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/types.h>
@@ -83,10 +85,10 @@ using namespace DarkHttpd;
  *
  * TODO: send headers with sendfile(), this will result in fewer packets.
  */
-static ssize_t send_from_file(const int s, const int fd, ByteRange &range) {
+static ssize_t send_from_file(const int s, const int fd, ByteRange &range, off_t most) {
   /* off_t of file_length can be wider than size_t, avoid overflow in send_len */
 
-  off_t send_len = std::min(range.getLength(), off_t(std::numeric_limits<size_t>::max()));
+  off_t send_len = std::min(std::min(range.getLength(), most), off_t(std::numeric_limits<ssize_t>::max())); //size_t's max became -1 as an off_t, which sendfile refused.
 
   errno = 0;
 
@@ -230,20 +232,13 @@ static DebugLog debug(true);
 #endif
 
 
-#if defined(__GNUC__) || defined(__INTEL_COMPILER)
-#define unused __attribute__((__unused__))
-#else
-#define unused
-#endif
-
-
 //for printf, make it easy to know which token to use by forcing the data to the largest integer supported by it.
 static_assert(sizeof(unsigned long long) >= sizeof(off_t), "inadequate ull, not large enough for an off_t");
 
 
 #include "darkerror.h" //err function.
 /* close() that dies on error.  */
-static void xclose(Fd fd) {
+static void xclose(Fd &fd) {
   if (!fd.close()) {
     err(1, "close()");
   }
@@ -262,72 +257,52 @@ static void nonblock_socket(const int sock) {
   }
 }
 
-/* Resolve /./ and /../ in a URL, in-place.
- * @returns whether @param URL is legit.
- * presently bizarre sequences of slashes and dots are treated as if all the slashes preceded all of the dots. That needs to be fixed to handle ../../ and the like.
+/* Resolve /./ and /../ in a URL, in-place, and collapse runs of slashes.
+ * @returns whether @param URL is legit, i.e. starts with a slash and doesn't try to climb above it.
+ * Works a segment at a time, the former char counting version ate the character after any dot so "index.html" became "indextml".
  */
-static bool make_safe_url(StringView url) {
+static bool make_safe_url(StringView &url) {
   /* URLs not starting with a slash are illegal. */
-
   char *reader = url.begin();
   if (*reader != '/') {
     return false;
   }
-
-  char *writer = reader;
-  //counts of special chars encountered.
-  unsigned priorSlash = 1; //the leading one
-  unsigned priorDot = 0;
-
-  /* Copy to dst, while collapsing multi-slashes and handling dot-dirs. */
-  // special cases /./  /../  /a../ /a./  /.../
-  while (char c = *++reader) {
-    if (c == '/') {
-      if (priorDot) {}
-      ++priorSlash;
-      continue; //action deferred until we have seen something other than slash or dot
-    }
-    if (c == '.') {
-      ++priorDot;
+  char *root = reader;
+  char *writer = reader + 1; //keep the leading slash
+  ++reader;
+  while (*reader) {
+    if (*reader == '/') { //collapse multi-slashes
+      ++reader;
       continue;
     }
-    //not a slash nor a dot so resolve those
-    switch (priorDot) {
-      case 1: //trailing dot
-        if (take(priorSlash)) {
-          *writer++ = '/'; //one slash, and dot disappears
-        }
-        priorDot = 0;
-        continue; //do tdisappears
-      case 2:
-        //todo: backup to slash prior to counted ones, and emit nothing
-        if (take(priorSlash)) {
-          while (writer > url) {
-            if (*writer == '/') {
-              priorDot = 0;
-              break;
-            }
-          }
-          if (priorDot) { //we exited the while by running off of the end
-            *url = 0; //kill it, kill it really hard
-            return false;
-          }
-        }
-      //tried to escape
-      default:
-        if (priorDot) {
-          *url = 0; //kill it, kill it really hard
-          return false;
-        }
-        break;
+    char *segment = reader;
+    while (*reader && *reader != '/') {
+      ++reader;
     }
-    if (priorSlash) {
-      *writer++ = '/'; //one slash, and dot disappears
-      priorSlash = 0;
-      //but also emit the char
+    size_t length = reader - segment;
+    bool trailingSlash = *reader == '/';
+    if (length == 1 && segment[0] == '.') {
+      continue; //same directory, drop it
+    }
+    if (length == 2 && segment[0] == '.' && segment[1] == '.') {
+      if (writer == root + 1) {
+        *root = 0; //kill it, kill it really hard
+        return false;
+      }
+      //back up over the last segment we wrote, and its slash
+      --writer;
+      while (writer > root + 1 && writer[-1] != '/') {
+        --writer;
+      }
+      continue;
+    }
+    memmove(writer, segment, length);
+    writer += length;
+    if (trailingSlash) {
+      *writer++ = '/';
     }
-    *writer++ = c;
   }
+  *writer = 0;
   url.truncateAt(writer);
   return true;
 }
@@ -406,15 +381,15 @@ void Server::init_sockin() {
   }
 #endif
 
-#ifdef TORTURE
-  /* torture: cripple the kernel-side send buffer so we can only squeeze out
-   * one byte at a time (this is for debugging)
-   */
-  sockopt = 1;
-  if (setsockopt(sockin, SOL_SOCKET, SO_SNDBUF, &sockopt, sizeof(sockopt)) == -1) {
-    err(1, "setsockopt(SO_SNDBUF)");
+  if (torture_sndbuf) {
+    /* torture: cripple the kernel-side send buffer so we can only squeeze out
+     * a few bytes at a time (this is for debugging). Accepted sockets inherit it.
+     */
+    sockopt = torture_sndbuf;
+    if (setsockopt(sockin, SOL_SOCKET, SO_SNDBUF, &sockopt, sizeof(sockopt)) == -1) {
+      err(1, "setsockopt(SO_SNDBUF)");
+    }
   }
-#endif
 
   /* bind socket */
 #ifdef HAVE_INET6
@@ -445,10 +420,26 @@ void Server::init_sockin() {
     printf("listening on: http://%s:%u/\n", get_address_text(&addrin.sin_addr), ntohs(addrin.sin_port));
   }
 
+#if DarklySupportLinuxAccept
+  if (fastopen_queue) { //before listen
+    int queue = int(fastopen_queue);
+    if (setsockopt(sockin, IPPROTO_TCP, TCP_FASTOPEN, &queue, sizeof(queue)) == -1) {
+      warn("setsockopt(TCP_FASTOPEN)"); //net.ipv4.tcp_fastopen may not allow it, serve without
+    }
+  }
+  if (defer_accept_secs) {
+    int secs = int(defer_accept_secs);
+    if (setsockopt(sockin, IPPROTO_TCP, TCP_DEFER_ACCEPT, &secs, sizeof(secs)) == -1) {
+      warn("setsockopt(TCP_DEFER_ACCEPT)");
+    }
+  }
+#endif
+
   /* listen on socket */
   if (listen(sockin, max_connections) == -1) {
     err(1, "listen()");
   }
+  nonblock_socket(sockin); //accepting loops until the backlog is empty
 
 #if DarklySupportAcceptanceFilter
   /* enable acceptfilter (this is only available on FreeBSD) */
@@ -463,7 +454,7 @@ void Server::init_sockin() {
   }
 
 #endif
-  epoller.watch(sockin,EPOLLIN, *reinterpret_cast<EpollHandler *>(this)); //the connection socket only has read events. Probably needs HUP's as well though ...
+  epoller.watch(sockin,EPOLLIN, acceptor); //the connection socket only has read events. Probably needs HUP's as well though ...
 }
 
 void Server::usage(const char *argv0) {
@@ -489,15 +480,19 @@ void Server::usage(const char *argv0) {
 #endif
   printf("\t--maxconn number (default: system maximum)\n"
     "\t\tSpecifies how many concurrent connections to accept.\n\n");
-  printf("\t--log filename (default: stdout)\n"
+  printf("\t--log filename (default: no request log)\n"
     "\t\tSpecifies which file to append the request log to.\n\n");
   printf("\t--syslog\n"
     "\t\tUse syslog for request log.\n\n");
-  printf("\t--index filename (default: %s)\n"
-    "\t\tDefault file to serve when a directory is requested.\n\n",
+  printf("\t--index filename[,filename...] (default: %s)\n"
+    "\t\tDefault file to serve when a directory is requested, the first of them present.\n\n",
     index_name);
+  printf("\t--index-cache count (default: %zu)\n"
+    "\t\tDirectories whose index is remembered, held open. 0 looks every time.\n\n", indexes.limit);
   printf("\t--no-listing\n"
     "\t\tDo not serve listing if directory is requested.\n\n");
+  printf("\t--listing-cache bytes (default: %zu)\n"
+    "\t\tMemory for keeping rendered directory listings, 0 renders every time.\n\n", listings.limit);
 
   printf("\t--mimetypes filename (optional)\n"
     "\t\tParses specified file for extension-MIME associations.\n\n");
@@ -507,10 +502,56 @@ void Server::usage(const char *argv0) {
   printf("\t--uid uid/uname, --gid gid/gname (default: don't privdrop)\n"
     "\t\tDrops privileges to given uid:gid after initialization.\n\n");
   printf("\t--chroot (default: don't chroot)\n"
-    "\t\tLocks server into wwwroot directory for added security.\n\n");
+    "\t\tLocks server into wwwroot directory for added security.\n"
+    "\t\tRequests are confined to wwwroot without it, this also hides the rest of the filesystem from the process.\n\n");
+  printf("\t--symlinks beneath|any|none (default: %s)\n"
+    "\t\tbeneath follows symbolic links that stay inside wwwroot, any follows them anywhere,\n"
+    "\t\tnone refuses any path that has one. Kernels before 5.6 treat beneath as none.\n\n", resolver.symlinks.name());
+  printf("\t--no-watch (default: watch served directories with inotify)\n"
+    "\t\tCached file information is then only trusted for the --revalidate time.\n\n");
+  printf("\t--revalidate ms (default: %u)\n"
+    "\t\tHow long cached file information is trusted where inotify can't watch, e.g. past fs.inotify.max_user_watches.\n\n", watcher.revalidateMs);
+  printf("\t--io-threads count (default: %u)\n"
+    "\t\tThreads that read files not in the page cache, so that the event loop doesn't wait on the disk, and as many that stat large directory listings. 0 does it all from the loop.\n\n", io.threads);
+  printf("\t--read-policy match=policy (repeatable, default: sequential for whole files, ahead for ranges)\n"
+    "\t\tKernel read hints for files whose mime type starts with match, or of at least match bytes (k, M, G allowed), first match wins.\n"
+    "\t\tpolicy is normal, sequential or ahead, with +drop to drop what has been sent from the page cache, e.g. video/=ahead 1G=sequential+drop\n\n");
+  printf("\t--drop-behind bytes (default: %lld, never)\n"
+    "\t\tWithout a matching --read-policy, files at least this large drop what has been sent from the page cache.\n\n", static_cast<long long>(advice.dropBehindAbove));
+  printf("\t--keepalive-relaxed percent (default: %u), --keepalive-min secs (default: %u), --keepalive-requests count (default: %u, 0 for unlimited)\n"
+    "\t\tBelow percent of --maxconn (or of what the fd limit allows) idle keep-alives get the whole --timeout and up to count requests,\n"
+    "\t\tabove it both shrink to --keepalive-min seconds and %u requests when full. When a new connection needs room the longest idle is closed.\n\n",
+    keepAlive.relaxedPercent, keepAlive.floorSecs, keepAlive.maxRequests, keepAlive.minRequests);
+  printf("\t--shed-lag ms (default: %u), --shed-connections percent of --maxconn (default: %u), --shed-pending bytes (default: %llu, never)\n"
+    "\t\tPast any of these we are overloaded: we stop accepting, answer requests 503 and close idle keep-alives after --shed-keepalive seconds (default: %u).\n"
+    "\t\tShedding stops once all are under half their mark for a second. 0 ignores that measure.\n\n", overload.lagMs, overload.connectionPercent, llu(overload.pendingBytes), overload.keepAliveSecs);
+  printf("\t--allow cidr, --deny cidr (repeatable, default: everyone may connect)\n"
+    "\t\tWho may connect, e.g. 10.0.0.0/8 or 2001:db8::/32. The most specific match decides, with --allow rules present no match is denied.\n\n");
+  printf("\t--per-client-connections count, --per-client-requests rate[/burst] (default: no limits)\n"
+    "\t\tConnections one client address may hold open, beyond which they are closed with a 429, and requests per second, beyond which they get a 429.\n\n");
+  printf("\t--client-table slots (default: %u)\n"
+    "\t\tClient addresses tracked for those limits, fixed at startup.\n\n", clients.slots);
+  printf("\t--rate-limit rate, --rate-per-client rate, --rate-path prefix=rate (repeatable, narrowest first)\n"
+    "\t\tCap what we send in bytes per second (k, M, G allowed): in all, to each client address, and to everyone fetching under prefix.\n\n");
+  printf("\t--send-quantum bytes (default: %zu)\n"
+    "\t\tMost a connection sends before the others get a turn, so large downloads don't hold up small replies. 0 for no limit.\n\n", fair.quantum);
+  printf("\t--direct-above bytes (default: %lld, never), --direct-path prefix (repeatable)\n"
+    "\t\tFiles at least this large, or under these paths, are read with O_DIRECT on the --io-threads and sent from buffers, bypassing the page cache.\n\n", static_cast<long long>(direct.above));
+  printf("\t--direct-buffers count (default: %u), --direct-buffer-size bytes (default: %zu)\n"
+    "\t\tMemory for O_DIRECT sending, a reply that finds every buffer in use goes through the page cache.\n\n", direct.count, direct.bufferSize);
+  printf("\t--negative-cache count (default: %zu)\n"
+    "\t\tRemember this many recently missing paths, answering repeats with 404 without looking. 0 looks every time.\n\n", missing.limit);
 #ifdef DarklySupportAcceptanceFilter
   printf("\t--accf (default: don't use acceptfilter)\n"
          "\t\tUse acceptfilter. Needs the accf_http kernel module loaded.\n\n");
+#endif
+  printf("\t--accept-batch count (default: %u)\n"
+    "\t\tMost connections accepted each time the listener is ready, the rest are taken after the live ones have had a turn.\n\n", accept_batch);
+#if DarklySupportLinuxAccept
+  printf("\t--defer-accept secs (default: 0, off)\n"
+    "\t\tThe kernel holds a new connection for up to secs until its request arrives, as --accf does on FreeBSD.\n\n");
+  printf("\t--fastopen queue (default: 0, off)\n"
+    "\t\tTCP Fast Open, returning clients send their request with the SYN. Needs net.ipv4.tcp_fastopen to include 2.\n\n");
 #endif
   printf("\t--no-keepalive\n"
     "\t\tDisables HTTP Keep-Alive functionality.\n\n");
@@ -535,6 +576,17 @@ void Server::usage(const char *argv0) {
     "\t\tIf a connection is idle for more than this many seconds,\n"
     "\t\tit will be closed. Set to zero to disable timeouts.\n\n",
     timeout_secs);
+  printf("\t--max-request-header bytes (default: %zu, at most %zu)\n"
+    "\t\tRequests whose header outgrows the %zu bytes each connection has get a larger buffer from a shared pool up to this,\n"
+    "\t\tbeyond it they are answered 414 or 431, and those declaring a longer body 413.\n\n", requestBuffers.limit, RequestBuffers::Largest, Connection::Request::InlineSize);
+  printf("\t--header-timeout secs (default: %u), --min-recv-rate bytes/s (default: %u), --send-timeout secs (default: %u)\n"
+    "\t\tA request's header must all arrive within header-timeout of its first byte, and after %u seconds at no less than min-recv-rate,\n"
+    "\t\tso that trickling a byte now and then doesn't hold a connection. A reply must be sent within send-timeout. 0 disables each.\n\n",
+    deadlines.headerSecs, deadlines.minRecvRate, deadlines.sendSecs, Deadlines::RateGraceSecs);
+  printf("\t--torture-sndbuf bytes (default: %d)\n"
+    "\t\tShrink the kernel send buffer of every connection, to exercise\n"
+    "\t\tpartial sends. Pair with darkerslow for slow client testing.\n\n",
+    torture_sndbuf);
   printf("\t--auth username:password\n"
     "\t\tEnable basic authentication. This is *INSECURE*: passwords\n"
     "\t\tare sent unencrypted over HTTP, plus the password is visible\n"
@@ -556,7 +608,7 @@ public:
 
 
   template<typename StringAssignable> bool operator>>(StringAssignable &target) {
-    if (!(CliScanner(*this) >> target)) {
+    if (!(static_cast<CliScanner &>(*this) >> target)) { //formerly scanned a copy, which left the argument to be seen again as an unknown flag.
       switch (errno) {
         case EDOM:
           return err(-1, "Not enough arguments for %s", argv[argc - 1]);
@@ -613,14 +665,87 @@ bool Server::parse_commandline(int argc, char *argv[]) {
         arg >> log.file_name;
       } else if (token == "--chroot") {
         want_chroot = true;
+      } else if (token == "--symlinks") {
+        arg >> resolver.symlinks;
+      } else if (token == "--no-watch") {
+        watcher.enabled = false;
+      } else if (token == "--revalidate") {
+        arg >> watcher.revalidateMs;
+      } else if (token == "--io-threads") {
+        arg >> io.threads;
+      } else if (token == "--read-policy") {
+        arg >> advice.rules;
+      } else if (token == "--drop-behind") {
+        arg >> advice.dropBehindAbove;
+      } else if (token == "--keepalive-relaxed") {
+        arg >> keepAlive.relaxedPercent;
+      } else if (token == "--keepalive-min") {
+        arg >> keepAlive.floorSecs;
+      } else if (token == "--keepalive-requests") {
+        arg >> keepAlive.maxRequests;
+      } else if (token == "--shed-lag") {
+        arg >> overload.lagMs;
+      } else if (token == "--shed-connections") {
+        arg >> overload.connectionPercent;
+      } else if (token == "--shed-pending") {
+        arg >> overload.pendingBytes;
+      } else if (token == "--shed-keepalive") {
+        arg >> overload.keepAliveSecs;
+      } else if (token == "--allow" || token == "--deny") {
+        char *cidr;
+        arg >> cidr;
+        access.add(cidr, token == "--allow");
+      } else if (token == "--per-client-connections") {
+        arg >> clients.maxConnections;
+      } else if (token == "--per-client-requests") {
+        char *rate;
+        arg >> rate;
+        char *slash;
+        clients.rate = strtod(rate, &slash);
+        if (*slash == '/') {
+          clients.burst = strtod(slash + 1, &slash);
+        }
+        if (*slash || clients.rate < 0) {
+          err(-1, "--per-client-requests wants rate or rate/burst, not `%s'", rate);
+        }
+      } else if (token == "--client-table") {
+        arg >> clients.slots;
+      } else if (token == "--rate-limit") {
+        char *rate;
+        arg >> rate;
+        shaper.global.setRate(Shaper::parseRate(rate, "--rate-limit"));
+      } else if (token == "--rate-per-client") {
+        char *rate;
+        arg >> rate;
+        shaper.perClient = Shaper::parseRate(rate, "--rate-per-client");
+      } else if (token == "--rate-path") {
+        arg >> shaper.paths;
+      } else if (token == "--send-quantum") {
+        arg >> fair.quantum;
+      } else if (token == "--direct-above") {
+        arg >> direct.above;
+      } else if (token == "--direct-path") {
+        char *prefix;
+        arg >> prefix;
+        direct.addPrefix(prefix);
+      } else if (token == "--direct-buffers") {
+        arg >> direct.count;
+      } else if (token == "--direct-buffer-size") {
+        arg >> direct.bufferSize;
+      } else if (token == "--negative-cache") {
+        arg >> missing.limit;
 #if DarklySupportDaemon
       } else if (token == "--daemon") {
         want_daemon = true;
 #endif
       } else if (token == "--index") {
         arg >> index_name;
+      } else if (token == "--index-cache") {
+        arg >> indexes.limit;
       } else if (token == "--no-listing") {
         no_listing = true;
+      } else if (token == "--listing-cache") {
+        arg >> listings.limit;
       } else if (token == "--mimetypes") {
         arg >> contentType.fileName;
       } else if (token == "--create-mimetypes") {
@@ -637,6 +762,17 @@ bool Server::parse_commandline(int argc, char *argv[]) {
 #endif
       } else if (token == "--no-keepalive") {
         want_keepalive = false;
+      } else if (token == "--accept-batch") {
+        arg >> accept_batch;
+        if (!accept_batch) {
+          err(-1, "--accept-batch must be at least 1");
+        }
+#if DarklySupportLinuxAccept
+      } else if (token == "--defer-accept") {
+        arg >> defer_accept_secs;
+      } else if (token == "--fastopen") {
+        arg >> fastopen_queue;
+#endif
 #if   DarklySupportAcceptanceFilter
     } else if (token ==  "--accf")  {
       want_accf = true;
@@ -662,6 +798,19 @@ bool Server::parse_commandline(int argc, char *argv[]) {
         want_server_id = false;
       } else if (token == "--timeout") {
         arg >> timeout_secs;
+      } else if (token == "--max-request-header") {
+        arg >> requestBuffers.limit;
+        if (requestBuffers.limit > RequestBuffers::Largest) {
+          err(-1, "--max-request-header can be at most %zu", RequestBuffers::Largest);
+        }
+      } else if (token == "--header-timeout") {
+        arg >> deadlines.headerSecs;
+      } else if (token == "--min-recv-rate") {
+        arg >> deadlines.minRecvRate;
+      } else if (token == "--send-timeout") {
+        arg >> deadlines.sendSecs;
+      } else if (token == "--torture-sndbuf") {
+        arg >> torture_sndbuf;
       } else if (token == "--auth") {
         arg >> auth; //rest of parsing and checking is in operator= of Authorization.
       } else if (token == "--header") {
@@ -691,8 +840,140 @@ bool Server::parse_commandline(int argc, char *argv[]) {
 }
 
 
+void Server::Acceptor::onEpoll(unsigned epoll_flags unused) {
+  unsigned batch = 0; //connections made, what the stats count
+  for (unsigned tries = 0; tries < service.accept_batch && service.accepting; ++tries) { //the listener stays ready if we leave some, level triggered epoll brings us back
+    bool acquired;
+    if (!service.accept_connection(acquired)) {
+      break;
+    }
+    batch += acquired;
+  }
+  auto &fyi = service.fyi;
+  ++fyi.acceptWakeups;
+  fyi.accepted += batch;
+  fyi.acceptBatchMost = std::max(fyi.acceptBatchMost, batch);
+  unsigned bucket = 0;
+  while (bucket < 4 && batch >> (bucket + 1)) {
+    ++bucket;
+  }
+  ++fyi.acceptBatches[bucket];
+}
+
+void Server::Acceptor::onTimer(unsigned which) {
+  if (which == ticket) {
+    service.resumeAccepting(); //if the fds are still short accept fails and pauses again
+  }
+}
+
+void Server::pauseAccepting(bool retry) {
+  if (accepting) {
+    epoller.remove(sockin); //else a listening socket we don't accept from is reported ready on every wait
+    accepting = false;
+    ++fyi.acceptPauses;
+  }
+  if (retry) {
+    timers.schedule(acceptor, ++acceptor.ticket, Ticks::now() + AcceptRetryMs * Ticks::perMilli);
+  }
+}
+
+void Server::resumeAccepting() {
+  if (accepting || overload.shedding || (max_connections > 0 && live >= unsigned(max_connections))) {
+    return;
+  }
+  accepting = epoller.watch(sockin, EPOLLIN, acceptor);
+}
+
+Connection *Server::acquire(int fd) {
+  Connection *conn = pool;
+  if (conn) {
+    pool = conn->next;
+    ++fyi.pooled;
+  } else {
+    conn = new Connection(*this);
+  }
+  conn->start(fd);
+  conn->prev = nullptr;
+  conn->next = connections;
+  if (connections) {
+    connections->prev = conn;
+  }
+  connections = conn;
+  ++live;
+  return conn;
+}
+
+void Server::release(Connection *conn) {
+  notIdle(conn);
+  (conn->prev ? conn->prev->next : connections) = conn->next;
+  if (conn->next) {
+    conn->next->prev = conn->prev;
+  }
+  clients.disconnect(conn->tracked);
+  conn->tracked = nullptr;
+  --live;
+  resumeAccepting(); //an fd and a place under --maxconn are free
+  conn->recycle();
+  conn->state = Connection::BORN;
+  conn->next = pool;
+  pool = conn;
+}
+
+void Server::nowIdle(Connection *conn) {
+  conn->idleNewer = nullptr;
+  conn->idleOlder = idleNewest;
+  (idleNewest ? idleNewest->idleNewer : idleOldest) = conn;
+  idleNewest = conn;
+}
+
+void Server::notIdle(Connection *conn) {
+  if (!conn->idleOlder && idleOldest != conn) {
+    return;
+  }
+  (conn->idleOlder ? conn->idleOlder->idleNewer : idleOldest) = conn->idleNewer;
+  (conn->idleNewer ? conn->idleNewer->idleOlder : idleNewest) = conn->idleOlder;
+  conn->idleNewer = conn->idleOlder = nullptr;
+}
+
+bool Server::reapIdle() {
+  auto conn = idleOldest; //between requests, not one that has yet to send its first or is part way through sending one
+  if (!conn) {
+    return false;
+  }
+  conn->rq.keepalive.dieNow = true;
+  release(conn);
+  ++keepAlive.stats.reaped;
+  return true;
+}
+
+void Server::finished(Connection &conn) {
+  if (conn.reply.http_code == 0) {
+    return; //nothing was asked of us
+  }
+  auto &tally = fyi.allocations[conn.reply.kind];
+  ++tally.requests;
+  tally.calls += conn.allocated;
+  conn.allocated = 0;
+  if (conn.reply.startedAt) { //not for errors found while receiving the request
+    fair.record(conn.reply.sent, Ticks::now() - conn.reply.startedAt, conn.reply.deferrals);
+  }
+  if (log.wanted()) {
+    conn.logOn(&log);
+  }
+}
+
+/** accept, non-blocking and close-on-exec in the one call where we can */
+static int acceptFrom(int listener, sockaddr *addr, socklen_t *length) {
+#if DarklySupportLinuxAccept
+  return accept4(listener, addr, length, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+  return accept(listener, addr, length);
+#endif
+}
+
 /* Accept a connection from sockin and add it to the connection queue. */
-void Server::accept_connection() {
+bool Server::accept_connection(bool &acquired) {
+  acquired = false;
   sockaddr_in addrin;
 #ifdef HAVE_INET6
   sockaddr_in6 addrin6;
@@ -700,34 +981,62 @@ void Server::accept_connection() {
   socklen_t sin_size;
   Connection *conn;
   int fd;
+  auto heapBefore = AllocationCounter::read();
 
 #ifdef HAVE_INET6
   if (inet6) {
     sin_size = sizeof(addrin6);
     memset(&addrin6, 0, sin_size);
-    fd = accept(sockin, reinterpret_cast<sockaddr *>(&addrin6), &sin_size);
+    fd = acceptFrom(sockin, reinterpret_cast<sockaddr *>(&addrin6), &sin_size);
   } else
 #endif
   {
     sin_size = sizeof(addrin);
     memset(&addrin, 0, sin_size);
-    fd = accept(sockin, reinterpret_cast<sockaddr *>(&addrin), &sin_size);
+    fd = acceptFrom(sockin, reinterpret_cast<sockaddr *>(&addrin), &sin_size);
   }
 
   if (fd == -1) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR || errno == ECONNABORTED) {
+      return errno == ECONNABORTED; //drained, or one gave up while queued
+    }
     /* Failed to accept, but try to keep serving existing connections. */
     if (errno == EMFILE || errno == ENFILE) {
-      accepting = false;
+      if (reapIdle()) {
+        return true; //an fd to spare now
+      }
+      pauseAccepting(true); //releasing a connection or the timer resumes
     }
     warn("accept()");
-    return;
+    return false;
   }
-  //todo: see if there is a closed connection object to use. IE pool them.
-  /* Allocate and initialize struct connection. */
-  conn = new Connection(*this, fd);
-  // conn->clear(); //in case we someday pull from pool instead of malloc.
-  connections.push_front(conn);
-  epoller.watch(fd,EPOLLIN | EPOLLOUT | EPOLLHUP, *reinterpret_cast<EpollHandler *>(this)); //todo: perhaps other EPOLLxxx are needed to catch all connection events?
+  ClientTable::Entry *tracked = nullptr;
+  if (access.enabled() || clients.enabled()) {
+#ifdef HAVE_INET6
+    auto key = inet6 ? ClientTable::keyFor(&addrin6.sin6_addr, true) : ClientTable::keyFor(&addrin.sin_addr.s_addr, false);
+#else
+    auto key = ClientTable::keyFor(&addrin.sin_addr.s_addr, false);
+#endif
+    if (!access.allows(key)) {
+      ++access.stats.denied;
+      close(fd); //not a byte, as if we weren't here
+      return true;
+    }
+    bool refused;
+    tracked = clients.connect(key, Ticks::now(), refused);
+    if (refused) { //no Connection for it, one pre-rendered send and close
+      send(fd, errorPages.refusal.data(), errorPages.refusal.size(), MSG_DONTWAIT | MSG_NOSIGNAL); //best effort, a full socket just sees the close
+      close(fd);
+      return true;
+    }
+  }
+  conn = acquire(fd);
+  acquired = true;
+  conn->tracked = tracked;
+  if (max_connections > 0 && live >= unsigned(max_connections) && !reapIdle()) {
+    pauseAccepting(false); //releasing one resumes
+  }
+  conn->listenFor(EPOLLIN); //EPOLLOUT only while a send is waiting on the socket, HUP and ERR come regardless.
 
 #ifdef HAVE_INET6
   if (inet6) {
@@ -740,8 +1049,19 @@ void Server::accept_connection() {
 
   debug("accepted connection from %s:%u (fd %d)\n", inet_ntoa(addrin.sin_addr), ntohs(addrin.sin_port), int(conn->socket)); //CLion wrong thinks the cast on conn->socket is not needed.
 
+  auto heapAccepted = AllocationCounter::read();
+  fyi.acceptAllocations += heapAccepted - heapBefore;
+#if DarklySupportLinuxAccept
+  if (defer_accept_secs || fastopen_queue) { //the request is likely here already, else the recv costs more than waiting for EPOLLIN
+    conn->poll_recv_request();
+  }
+#else
   /* The accept is due to reception of the start of the request, so there will be data to read */
   conn->poll_recv_request();
+#endif
+  conn->rearm();
+  conn->allocated += AllocationCounter::read() - heapAccepted;
+  return true;
 }
 
 /* Add a connection's details to the logfile. */
@@ -763,29 +1083,66 @@ void Connection::Replier::Block::recycle(bool andForget) {
   if (andForget) { //suspicious fragment in the original, abandoned an open file descriptor, potentially leaking it.
     fd.forget(); // but it might be still open ?!
   }
-}
-
-FILE *Connection::Replier::Block::createTemp() {
-  return fd.createTemp("darkerhttpdXXXXXX");
+  memory = nullptr;
+  range.clear();
 }
 
 off_t Connection::Replier::Block::getLength() {
   if (range.begin.given && range.end.given) {
-    return range.end.given - range.begin.given;
+    return range.end.number - range.begin.number; //was the difference of the given flags, i.e. always zero.
   } else {
     return -1;
   }
 }
 
+const char *Connection::Replier::kindName(Kind kind) {
+  static const char *names[KindCount] = {"static", "not modified", "listing", "error", "redirect"};
+  return kind < KindCount ? names[kind] : "?";
+}
+
 void Connection::Replier::clear() {
+  if (directBuffer) {
+    if (!loading) {
+      directPool->give(directBuffer);
+    } //else a worker is still reading into it, Connection::loaded gives it back
+    directBuffer = nullptr;
+  }
+  ++ioTicket; //a load still in progress is no longer for us
+  reading = {};
+  loading = false;
+  hotTo = 0;
+  startedAt = 0;
+  sent = 0;
+  deferrals = 0;
+  shaper->release(shaping);
+  throttled = false;
+  ++timerTicket; //a timer still pending is no longer for us
+  if (index) {
+    content.fd.forget(); //it belongs to the IndexCache
+    index.reset();
+  }
   header_only = false;
   http_code = 0;
+  kind = StaticFile;
+  headerUsed = 0;
+  headerOverflow = false;
 
   header.recycle(true);
+  fixedHeader.recycle(true);
   content.recycle(true); //todo:1 might be conditional on actual file vs generated content.
+  pinned.reset();
+  producer.reset();
+  body.release();
 }
 
 void Connection::onEpoll(unsigned epoll_flags) {
+  auto heapBefore = AllocationCounter::read();
+  deferred = false; //if it was, this is its turn
+  allowance = service.fair.allowance();
+  if ((epoll_flags & (EPOLLERR | EPOLLHUP)) && !(epoll_flags & (EPOLLIN | EPOLLOUT))) { //nothing to read and no sending to do, else it would be reported forever
+    rq.keepalive.dieNow = true;
+    markDone();
+  }
   if (epoll_flags & EPOLLIN) {
     if (state == RECV_REQUEST) {
       poll_recv_request();
@@ -802,78 +1159,186 @@ void Connection::onEpoll(unsigned epoll_flags) {
       //todo: debug("unexpected output notification, while ....");
     }
   }
+  rearm();
+  allocated += AllocationCounter::read() - heapBefore;
 }
 
 Connection::~Connection() {
-  recycle(); //for memory leak test, which should be moot now that we have gotten rid of all dynamically allocated chunks.
-  service.epoller.remove(socket);
+  if (socket.seemsOk()) {
+    recycle(); //for memory leak test, which should be moot now that we have gotten rid of all dynamically allocated chunks.
+  }
 }
 
-Connection::Connection(Server &parent, int fd): socket(fd), service(parent), rq(service.timeout_secs), reply{} {
+Connection::Connection(Server &parent): service(parent), rq(), reply{} {
+  reply.body.pool = &service.buffers;
+  reply.directPool = &service.direct;
+  rq.buffers = &service.requestBuffers;
+  reply.shaper = &service.shaper;
+}
+
+void Connection::start(int fd) {
+  socket = fd;
   memset(&client, 0, sizeof(client));
-  nonblock_socket(socket);
+#if !DarklySupportLinuxAccept
+  nonblock_socket(socket); //accept4 did it
+#endif
+  clear();
+  rq.keepalive.dieNow = true;
+  allocated = 0;
+  served = 0;
+  allowance = service.fair.allowance(); //the first request is read and answered straight from accepting
   last_active = service.since(0);
+  progressAt = requestAt = Ticks::now();
   state = RECV_REQUEST;
 }
 
-bool Connection::Request::Lifetime::timeToDie(time_t beenAlive) {
-  if (max == 0) {
-    max = cli_timeout; //might still be zero.
-  }
-  if (requested > max) {
-    requested = max;
-  }
-
-  //order of checks is important!
-  if (requested > beenAlive) {
-    //do nothing
-  } else if (max > beenAlive) {
-    //still do nothing
-  } else {
-    // debug("poll_check_timeout on socket:%d marking connection closed\n", int(socket));
-    dieNow = true;
-    return true;
-    // state = DONE;
-  }
-  return false;
-}
-
-void Connection::Request::clear() {
-  received = StringView(theRequest, sizeof(theRequest) - 1); //prepare to receive
+void Connection::Request::clear(bool keepPipelined) {
+  size_t leftover = keepPipelined && headerEnd && headerEnd < received.start ? received.start - headerEnd : 0;
+  if (theRequest != inlineRequest && leftover <= InlineSize) {
+    memcpy(inlineRequest, theRequest + headerEnd, leftover);
+    buffers->give(theRequest, capacity);
+    theRequest = inlineRequest;
+    capacity = InlineSize;
+  } else if (leftover) {
+    memmove(theRequest, theRequest + headerEnd, leftover); //staying in a larger buffer if it needs one
+  }
+  received = StringView(theRequest, capacity, 0); //start counts bytes received, length is the room left.
+  received.chop(leftover);
+  theRequest[leftover] = 0;
+  headerEnd = 0;
   method = Request::NotMine;
   url = nullptr;
   referer = nullptr;
   user_agent = nullptr;
   authorization = nullptr;
+  if_mod_since = Now();
+  if_none_match = nullptr;
+  http11 = false;
   range.clear();
+  contentLength = 0;
+  keepalive.requested = 0;
+  keepalive.max = 0;
 }
 
-Connection::Request::Request(unsigned &cli_timeout): keepalive(cli_timeout) {
+Connection::Request::Request() {
   clear();
 }
 
-void Connection::clear() {
-  rq.clear();
+void Connection::clear(bool keepPipelined) {
+  if (deferred) {
+    service.fair.cancel(*this);
+    deferred = false;
+  }
+  service.pending -= counted;
+  counted = 0;
+  rq.clear(keepPipelined);
   reply.clear();
 }
 
-/* Recycle a finished connection for HTTP/1.1 Keep-Alive. */
+/* Close a finished connection so that it can be pooled. */
 void Connection::recycle() {
   clear(); //legacy, separate heap usage clear from the rest.
   debug("free_connection(%d)\n", int(socket));
+  listenFor(0);
   xclose(socket);
   rq.keepalive.dieNow = true; //todo: check original code
   state = RECV_REQUEST; /* ready for another */
 }
 
-/* If a connection has been idle for more than timeout_secs, it will be
- * marked as DONE and killed off in httpd_poll().
- */
-void Connection::poll_check_timeout() {
-  if (rq.keepalive.timeToDie(service.since(last_active))) {
-    debug("poll_check_timeout on socket:%d marking connection closed\n", int(socket));
-    state = DONE;
+void Connection::progressed() {
+  last_active = service.now();
+  progressAt = Ticks::now();
+}
+
+void Connection::markDone() {
+  if (state == DONE) {
+    return; //already on the list
+  }
+  state = DONE;
+  service.notIdle(this);
+  nextDone = service.done;
+  service.done = this;
+}
+
+void Connection::recount() {
+  size_t now = state == SEND_HEADER || state == SEND_REPLY ? reply.pending() : 0;
+  service.pending += now - counted; //unsigned wraparound makes a decrease come out right
+  counted = now;
+}
+
+/** @returns the earlier of two deadlines, where 0 is none */
+static int64_t sooner(int64_t one, int64_t other) {
+  return one && other ? std::min(one, other) : one | other;
+}
+
+int64_t Connection::deadline() {
+  auto &limits = service.deadlines;
+  switch (state) {
+    case RECV_REQUEST:
+      if (served && !rq.theRequest[0]) { //idle keep-alive, between requests
+        unsigned allowed = rq.keepalive.idleSecs(service.keepAliveTerms().idleSecs);
+        if (service.overload.shedding && (!allowed || service.overload.keepAliveSecs < allowed)) {
+          allowed = service.overload.keepAliveSecs;
+        }
+        return allowed ? progressAt + allowed * Ticks::perSecond : 0;
+      } else {
+        int64_t due = limits.headerSecs ? requestAt + limits.headerSecs * Ticks::perSecond : 0;
+        if (limits.minRecvRate) { //the rate it has averaged must keep up, so each byte buys 1/rate more seconds
+          due = sooner(due, requestAt + Server::Deadlines::RateGraceSecs * Ticks::perSecond + int64_t(rq.received.start) * Ticks::perSecond / limits.minRecvRate);
+        }
+        return due;
+      }
+    case SEND_HEADER:
+    case SEND_REPLY: {
+      int64_t due = service.timeout_secs ? progressAt + service.timeout_secs * Ticks::perSecond : 0; //sending ones keep the whole timeout, else a full house or shedding would cut off the replies in progress
+      if (limits.sendSecs && reply.startedAt) {
+        due = sooner(due, reply.startedAt + limits.sendSecs * Ticks::perSecond);
+      }
+      return due;
+    }
+    default:
+      return 0;
+  }
+}
+
+void Connection::rearm() {
+  auto due = deadline();
+  if (!due || (watchdog.armedFor && watchdog.armedFor <= due)) {
+    return; //none, or the pending entry comes first and will look again
+  }
+  watchdog.armedFor = due;
+  service.timers.schedule(watchdog, ++watchdog.ticket, due);
+}
+
+void Connection::Watchdog::onTimer(unsigned which) {
+  if (which != ticket) {
+    return; //superseded by an earlier one
+  }
+  armedFor = 0;
+  conn.expire();
+}
+
+void Connection::expire() {
+  auto due = deadline();
+  if (!due) {
+    return;
+  }
+  auto now = Ticks::now();
+  if (due > now) {
+    rearm(); //it got somewhere since
+    return;
+  }
+  auto &limits = service.deadlines;
+  if (state != RECV_REQUEST) {
+    ++(limits.sendSecs && reply.startedAt && now >= reply.startedAt + limits.sendSecs * Ticks::perSecond ? limits.stats.send : limits.stats.stalled);
+  } else if (served && !rq.theRequest[0]) {
+    ++limits.stats.idle;
+  } else {
+    ++(limits.headerSecs && now >= requestAt + limits.headerSecs * Ticks::perSecond ? limits.stats.header : limits.stats.slow);
   }
+  debug("deadline passed on socket:%d marking connection closed\n", int(socket));
+  rq.keepalive.dieNow = true;
+  markDone();
 }
 
 
@@ -905,7 +1370,8 @@ static void urldecode(StringView &url) {
 }
 
 void Connection::startHeader(const int errcode, const char *errtext) {
-  reply.header.createTemp();
+  reply.headerUsed = 0;
+  reply.headerOverflow = false;
 
   if (errcode > 0) {
     reply.http_code = errcode;
@@ -913,40 +1379,67 @@ void Connection::startHeader(const int errcode, const char *errtext) {
   if (!errtext) {
     errtext = ""; //don't want a "(null)" comment which is what some printf's do for a null pointer.
   }
-  reply.header.fd.printf("HTTP/1.1 %d %s\r\n", reply.http_code, errtext);
+  catf("HTTP/1.1 %d %s\r\n", reply.http_code, errtext);
+}
+
+void Connection::catf(const char *format, ...) {
+  size_t room = sizeof(reply.headerText) - reply.headerUsed;
+  va_list args;
+  va_start(args, format);
+  int added = vsnprintf(&reply.headerText[reply.headerUsed], room, format, args);
+  va_end(args);
+  if (added < 0 || size_t(added) >= room) {
+    reply.headerOverflow = true; //endHeader will replace it with something short and truthful.
+    return;
+  }
+  reply.headerUsed += added;
 }
 
 void Connection::catDate() {
-  reply.header.fd.printf("Date: %s\r\n", service.timetText());
+  catf("Date: %s\r\n", service.timetText());
 }
 
 void Connection::catServer() {
   if (service.want_server_id) {
-    reply.header.fd.printf("Server: %s\r\n", pkgname);
+    catf("Server: %s\r\n", pkgname);
   }
 }
 
 void Connection::catFixed(const char *fixedText) {
-  reply.header.fd.printf(fixedText);
+  catf("%s", fixedText);
 }
 
 void Connection::catKeepAlive() {
   if (rq.keepalive.dieNow) {
-    reply.header.fd.printf("Connection: close\r\n");
+    catf("Connection: close\r\n");
   } else {
-    //legacy ignored incoming Keep-alive values and passed server setting back.
-    reply.header.fd.printf("Keep-Alive: timeout=%d,max=%d\r\n", rq.keepalive.requested ? rq.keepalive.requested : service.timeout_secs, rq.keepalive.max ? rq.keepalive.max : service.timeout_secs); //Keep-Alive: timeout=5, max=997
+    if (!rq.http11) {
+      catf("Connection: keep-alive\r\n"); //1.0 clients only keep it if told
+    }
+    //what poll_check_timeout and poll_recv_request will actually apply, as of now
+    auto terms = service.keepAliveTerms();
+    auto idle = rq.keepalive.idleSecs(terms.idleSecs);
+    if (terms.requests) {
+      auto left = terms.requests > served ? terms.requests - served : 1;
+      if (idle) {
+        catf("Keep-Alive: timeout=%u, max=%u\r\n", idle, left);
+      } else {
+        catf("Keep-Alive: max=%u\r\n", left);
+      }
+    } else if (idle) {
+      catf("Keep-Alive: timeout=%u\r\n", idle);
+    }
   }
 }
 
 void Connection::catCustomHeaders() {
   for (auto custom_Hdr: service.custom_hdrs) {
-    reply.header.fd.printf("%s\r\n", custom_Hdr);
+    catf("%s\r\n", custom_Hdr);
   }
 }
 
 void Connection::catContentLength(off_t off) {
-  reply.header.fd.printf("Content-Length: %llu\r\n", llu(off));
+  catf("Content-Length: %llu\r\n", llu(off));
 }
 
 void Connection::startCommonHeader(int errcode, const char *errtext, off_t contentLength = ~0UL) {
@@ -962,95 +1455,130 @@ void Connection::startCommonHeader(int errcode, const char *errtext, off_t conte
 }
 
 
+static const char authenticateHeader[] = "WWW-Authenticate: Basic realm=\"simple file access\""; //todo:1 make realm text configurable, a cli in fact since the user might want it to reflect which wwwroot is in use.
+
 void Connection::catAuth() {
   if (service.auth) {
-    reply.header.fd.printf("WWW-Authenticate: Basic realm=\"simple file access\"\r\n"); //todo:1 make realm text configurable, a cli in fact since the user might want it to reflect which wwwroot is in use.
+    catf("%s\r\n", authenticateHeader);
   }
 }
 
 void Connection::catGeneratedOn(bool toReply) {
   if (service.want_server_id) {
-    (toReply ? reply.content.fd : reply.header.fd).printf("Generated by %s on %s\n", pkgname, service.timetText());
+    if (toReply) {
+      reply.body.printf("Generated by %s on %s\n", pkgname, service.timetText());
+    } else {
+      catf("Generated by %s on %s\n", pkgname, service.timetText());
+    }
   }
 }
 
 
 void Connection::endHeader() {
-  reply.header.fd.printf("\r\n");
-  reply.header.recordSize();
-  //too soon, not until after sending completes. reply.header.fd.close(); //todo: but we need the name so that we can pass that to sendfile.
+  catf("\r\n");
+  if (reply.headerOverflow) { //custom headers can make this happen, better to say so than to send half a header.
+    static const char tooBig[] = "HTTP/1.1 500 Reply header too large\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+    rq.keepalive.dieNow = true;
+    reply.header_only = true;
+    reply.http_code = 500;
+    reply.kind = Replier::ErrorPage;
+    reply.header.fromMemory(tooBig, sizeof(tooBig) - 1);
+    return;
+  }
+  reply.header.fromMemory(reply.headerText, reply.headerUsed);
+}
+
+void Connection::endHeaderWith(const std::string &fixed) {
+  if (reply.headerOverflow) {
+    endHeader(); //which replaces it all
+    return;
+  }
+  reply.header.fromMemory(reply.headerText, reply.headerUsed);
+  reply.fixedHeader.fromMemory(fixed.data(), fixed.size());
 }
 
+/* generated pages are built in pooled buffers, small enough to be complete, and so sized, before the header is built. */
 void Connection::startReply(int errcode, const char *errtext) {
-  reply.content.createTemp();
-  reply.content.fd.printf("<!DOCTYPE html><html><head><title>%d %s</title></head><body>\n" "<h1>%s</h1>\n", errcode, errtext, errtext);
+  reply.body.start(false);
+  reply.body.printf("<!DOCTYPE html><html><head><title>%d %s</title></head><body>\n" "<h1>%s</h1>\n", errcode, errtext, errtext);
 }
 
 void Connection::addFooter() {
-  reply.content.fd.putln("<hr>");
+  reply.body += "<hr>\n";
   catGeneratedOn(true);
-  reply.content.fd.putln("</body></html>");
+  reply.body += "</body></html>\n";
 }
 
 /* A default reply for any (erroneous) occasion. */
 void Connection::error_reply(const int errcode, const char *errname, const char *format, ...) {
+  reply.kind = Replier::ErrorPage;
   startReply(errcode, errname);
   va_list va;
   va_start(va, format);
-  reply.content.fd.vprintln(format, va);
+  reply.body.vprintf(format, va);
   va_end(va);
+  reply.body += '\n';
   addFooter();
   endReply();
 
-  startCommonHeader(errcode, errname, reply.content.getLength());
+  startCommonHeader(errcode, errname, reply.body.pending());
   catFixed("Content-Type: text/html; charset=UTF-8\r\n"); //todo: use catMime();
   catAuth();
   endHeader();
 
-  reply.header_only = false;
+  reply.header_only = rq.method == Request::HEAD; //was false, which sent the page to HEAD requests
 }
 
 void Connection::endReply() {
-  reply.content.recordSize();
-  //too soon, don't close until after sent.  reply.content.fd.close();
-}
-
-void Connection::redirect(const char *proto, const char *hostname, const char *url) {
-  startReply(reply.http_code = 301, "Moved Permanently");
-  reply.content.fd.printf("Moved to: <a href=\"");
-  if (proto) {
-    reply.content.fd.printf(proto);
-  }
-  if (hostname) {
-    reply.content.fd.printf(hostname);
+  reply.body.flush(true);
+  if (reply.body.wasTruncated()) {
+    rq.keepalive.dieNow = true;
   }
-  reply.content.fd.printf(url);
+}
 
-  reply.content.fd.printf("\">");
-  if (proto) {
-    reply.content.fd.printf(proto);
-  }
-  if (hostname) {
-    reply.content.fd.printf(hostname);
-  }
-  reply.content.fd.printf(url);
+void Connection::errorPage(ErrorPages::Which which) {
+  auto &page = service.errorPages[which];
+  reply.kind = Replier::ErrorPage;
+  startHeader(page.code, page.name);
+  catDate();
+  catKeepAlive();
+  endHeaderWith(page.headers);
+  reply.content.fromMemory(page.body.data(), page.body.size()); //any file that was opened is closed by clear()
+  reply.header_only = rq.method == Request::HEAD;
+}
 
-  reply.content.fd.printf("</a>\n");
-  addFooter();
+void Connection::redirect(const char *proto, const char *hostname, const char *url) {
+  reply.kind = Replier::Redirect;
+  if (!proto) {
+    proto = "";
+  }
+  if (!hostname) {
+    hostname = "";
+  }
+  reply.http_code = 301;
+  auto &page = service.errorPages.redirect;
+  reply.body.start(false);
+  //was printf(url), a format string from the client, and unescaped in the markup.
+  auto target = [&] {
+    HtmlDirLister::append_escaped(reply.body, proto);
+    HtmlDirLister::append_escaped(reply.body, hostname);
+    HtmlDirLister::append_escaped(reply.body, url);
+  };
+  reply.body += page.lead;
+  target();
+  reply.body += "\">";
+  target();
+  reply.body += page.trail;
   endReply();
 
   startHeader(301, "Moved Permanently");
-  reply.content.fd.printf("Date: %s\r\n", service.timetText());
-  catServer();
-
+  catDate();
   /* "Accept-Ranges: bytes\r\n" - not relevant here */
-  reply.content.fd.printf("Location: %s%s\r\n", hostname, url);
+  catf("Location: %s%s%s\r\n", proto, hostname, url);
   catKeepAlive();
-  catCustomHeaders();
-  catContentLength(reply.content.getLength());
-  catFixed("Content-Type: text/html; charset=UTF-8\r\n"); //todo: use catMime();
+  catContentLength(reply.body.pending());
   //no auth?
-  endHeader();
+  endHeaderWith(page.headers); //Server, custom headers and Content-Type
 }
 
 void Connection::redirect_https() {
@@ -1059,12 +1587,12 @@ void Connection::redirect_https() {
 
   /* make sure it's safe */
   if (!make_safe_url(rq.url)) {
-    error_reply(400, "Bad Request", "You requested an invalid URL.");
+    errorPage(ErrorPages::BadUrl);
     return;
   }
 
   if (!rq.hostname) {
-    error_reply(400, "Bad Request", "Missing 'Host' header.");
+    errorPage(ErrorPages::MissingHost);
     return;
   }
   redirect("https://", rq.hostname, rq.url);
@@ -1076,7 +1604,7 @@ void Connection::redirect_https() {
  */
 bool Connection::Request::parse() {
   //restart parse with each chunk until we parse a complete chunk. Seems wasteful but since it is rare that we don't get the whole request header in the first block we are going to keep the code simple.
-  StringView scanner(theRequest, received.start); //perhaps -1?
+  StringView scanner(theRequest, headerEnd); //not what was pipelined after it
 
   auto methodToken = scanner.cutToken(' ', false);
   if (!methodToken) {
@@ -1106,6 +1634,8 @@ bool Connection::Request::parse() {
 
   auto protocol = scanner.cutToken('\n', false);
   protocol.trimTrailing(" \t\r\n"); // \n  is superfluous, but I am hoping that we always use the same 'whitespace' string and can share that.
+  http11 = protocol == "HTTP/1.1"; //for chunked replies, anything older gets its end of body by closure
+  keepalive.dieNow = !http11; //1.1 is persistent unless it says close, 1.0 only if it asks
   //todo: check for http.1.
 
   do {
@@ -1116,6 +1646,7 @@ bool Connection::Request::parse() {
       //todo:distinguish eof from end of header
       break;
     }
+    headerline.trimLeading(" \t"); //else "Connection: close" never matched "close"
     if (headername == "Referer") { //only used in connection log message :(
       referer = headerline;
       continue;
@@ -1132,6 +1663,10 @@ bool Connection::Request::parse() {
       if_mod_since = headerline;
       continue;
     }
+    if (headername == "If-None-Match") {
+      if_none_match = headerline;
+      continue;
+    }
     if (headername == "Host") { //seems to only be used by forwarding, we may ifdef it away soon.
       hostname = headerline; //Host: <host>[:<port>]
       continue;
@@ -1142,8 +1677,11 @@ bool Connection::Request::parse() {
     }
     if (headername == "Connection") {
       headerline.trimTrailing(" \t\r\n");
-      keepalive.dieNow = headerline == "close";
-      //anything else is do linger. //expect another header like "Keep-Alive: timeout=5, max=200"
+      if (headerline == "close") {
+        keepalive.dieNow = true;
+      } else if (headerline == "keep-alive") {
+        keepalive.dieNow = false; //expect another header like "Keep-Alive: timeout=5, max=200"
+      }
       continue;
     }
     if (headername == "Keep-Alive") { //a header not to be confused with similar value for Connection:
@@ -1163,7 +1701,10 @@ bool Connection::Request::parse() {
       }
       continue;
     }
-    //future possiblities: Content-Length: for put's or push's
+    if (headername == "Content-Length") { //only so that we can refuse it, we have no methods with bodies yet
+      contentLength = strtoull(headerline.begin(), nullptr, 10);
+      continue;
+    }
     if (headername == "Range") {
       range.parse(headerline);
     }
@@ -1173,19 +1714,74 @@ bool Connection::Request::parse() {
 }
 
 ssize_t Connection::Request::receive(int socket) {
-  return recv(socket, received.begin(), sizeof(theRequest) - received.length, MSG_DONTWAIT); //MSG_DONTWAIT in case we are wrong about there being at least one byte of data present when a connection is
+  auto recvd = recv(socket, received.begin(), received.length, MSG_DONTWAIT); //MSG_DONTWAIT in case we are wrong about there being at least one byte of data present when a connection is
+  if (recvd > 0) {
+    received.chop(recvd);
+    *received.begin() = 0; //make the buff into a null terminated string, theRequest has room for this one past capacity.
+  }
+  return recvd;
 }
 
-static bool file_exists(const char *path) {
-  struct stat filestat;
-  return stat(path, &filestat) == -1 && errno == ENOENT ? false : true;
+bool Connection::Request::grow() {
+  size_t size;
+  auto bigger = buffers ? buffers->take(capacity + 1, size) : nullptr;
+  if (!bigger) {
+    return false;
+  }
+  if (theRequest == inlineRequest) {
+    ++buffers->stats.promoted;
+  }
+  auto got = received.start;
+  memcpy(bigger, theRequest, got + 1); //with its null
+  if (theRequest != inlineRequest) {
+    buffers->give(theRequest, capacity);
+  }
+  theRequest = bigger;
+  capacity = size;
+  received = StringView(theRequest, capacity, 0);
+  received.chop(got);
+  return true;
+}
+
+bool Connection::Request::headerComplete() {
+  auto crlf = strstr(theRequest, "\r\n\r\n");
+  auto lf = strstr(theRequest, "\n\n");
+  if (crlf && (!lf || crlf < lf)) {
+    headerEnd = crlf + 4 - theRequest;
+  } else if (lf) {
+    headerEnd = lf + 2 - theRequest;
+  } else {
+    headerEnd = 0;
+  }
+  return headerEnd;
+}
+
+/* map a failed resolve or open onto a reply, from errno */
+void Connection::openFailed() {
+  switch (errno) {
+    case EACCES:
+      errorPage(ErrorPages::Forbidden);
+      break;
+    case ELOOP: //symlink refused by --symlinks
+    case EXDEV: //symlink tried to leave wwwroot
+      errorPage(ErrorPages::NotServedHere);
+      break;
+    case ENOENT:
+    case ENOTDIR: //e.g. a trailing slash on a file
+    case ENAMETOOLONG:
+      errorPage(ErrorPages::NotFound);
+      break;
+    default:
+      error_reply(500, "Internal Server Error", "The URL you requested cannot be returned: %s.", strerror(errno));
+      break;
+  }
 }
 
 /* Process a GET/HEAD request. */
 void Connection::process_get() {
   /* make sure it's safe */
   if (!make_safe_url(rq.url)) {
-    error_reply(400, "Bad Request", "You requested an invalid URL.");
+    errorPage(ErrorPages::BadUrl);
     return;
   }
 #if DarklySupportForwarding
@@ -1196,50 +1792,71 @@ void Connection::process_get() {
   }
 #endif
   const char *mimetype(nullptr);
-  char target[FILENAME_MAX];
-  *rq.url.put(target, true) = 0;
-
-  if (rq.url.endsWith('/')) {
-    /* does it end in a slash? serve up url/index_name */
-    strcat(target, service.index_name);
-    if (!file_exists(target)) {
-      urlDoDirectory();
-    }
-    mimetype = service.contentType(service.index_name);
-  } else {
-    /* points to a file */
-    mimetype = service.contentType(rq.url);
+  /* resolve beneath wwwroot, make_safe_url left a leading slash that we skip. open+fstat, plus openat+fstat of the index for a directory. */
+  std::string_view relative(rq.url.begin() + 1, rq.url.length - 1);
+  auto now = Ticks::now();
+  if (service.missing.find(relative, now)) {
+    errorPage(ErrorPages::NotFound);
+    return;
   }
+  IndexCache::Pin index = rq.url.endsWith('/') ? service.indexes.find(relative, now) : nullptr;
+  if (index && index->file) { //already open and statted, no syscalls at all
+    useIndex(index);
+    mimetype = index->mimetype;
+  } else {
+    reply.content.fd = service.resolver.open(rq.url.begin() + 1, O_RDONLY | O_NONBLOCK);
+    if (!reply.content.fd.seemsOk()) {
+      bool missing = errno == ENOENT;
+      openFailed();
+      if (missing && service.missing.limit) {
+        unsigned trustMs = service.watcher.coverNearest(relative) ? service.missing.watchedMs : service.watcher.revalidateMs;
+        service.missing.remember(relative, now + trustMs * Ticks::perMilli);
+      }
+      return;
+    }
 
-  debug("url=\"%s\", target=\"%s\", content-type=\"%s\"\n", rq.url.begin(), target, mimetype);
+    reply.content.statSize(); //start with full possible size, reduce to requested range later.
 
-  /* open file */
-  reply.content.fd = open(target, O_RDONLY | O_NONBLOCK);
+    if (!reply.content) {
+      error_reply(500, "Internal Server Error", "fstat() failed: %s.", strerror(errno));
+      return;
+    }
 
-  if (!reply.content.fd.seemsOk()) { /* open() failed */
-    if (errno == EACCES) {
-      error_reply(403, "Forbidden", "You don't have permission to access this URL.");
-    } else if (errno == ENOENT) {
-      error_reply(404, "Not Found", "The URL you requested was not found.");
+    if (reply.content.fd.isDir()) {
+      if (!rq.url.endsWith('/')) { //relative links in the index or listing would be wrong without the slash
+        char withSlash[FILENAME_MAX];
+        *rq.url.put(withSlash, true) = 0;
+        strncat(withSlash, "/", sizeof(withSlash) - strlen(withSlash) - 1);
+        redirect(nullptr, nullptr, withSlash);
+        return;
+      }
+      /* serve up the first of the index names present, else a listing */
+      Fd directory = reply.content.fd;
+      reply.content.fd.forget();
+      reply.content.range.clear(); //that was the directory's size
+      if (!index) {
+        index = resolveIndex(directory, relative, now);
+      }
+      if (index && !index->file) {
+        urlDoDirectory(directory);
+      }
+      directory.close();
+      if (!index || !index->file) {
+        return; //listed, or resolveIndex made an error reply
+      }
+      useIndex(index);
+      mimetype = index->mimetype;
     } else {
-      error_reply(500, "Internal Server Error", "The URL you requested cannot be returned: %s.", strerror(errno));
+      /* points to a file */
+      mimetype = service.contentType(rq.url);
     }
-    return;
   }
 
-  reply.content.statSize(); //start with full possible size, reduce to requested range later.
-
-  if (!reply.content) {
-    error_reply(500, "Internal Server Error", "fstat() failed: %s.", strerror(errno));
-    return;
-  }
+  debug("url=\"%s\", content-type=\"%s\"\n", rq.url.begin(), mimetype);
 
   /* make sure it's a regular file */
-  if (reply.content.fd.isDir()) {
-    urlDoDirectory();
-    return;
-  } else if (!reply.content.fd.isRegularFile()) {
-    error_reply(403, "Forbidden", "Not a regular file.");
+  if (!reply.content.fd.isRegularFile()) {
+    errorPage(ErrorPages::NotRegular);
     return;
   }
 
@@ -1248,6 +1865,7 @@ void Connection::process_get() {
   /* check for If-Modified-Since, may not have to send */
   if (rq.if_mod_since && lastmod <= rq.if_mod_since) { //original code compared for equal, making this useless. We want file mod time any time after the given
     debug("not modified since %s\n", rq.if_mod_since.image);
+    reply.kind = Replier::NotModified;
     reply.header_only = true;
     startCommonHeader(304, "Not Modified"); //leaving off third arg leaves off ContentLength header, apparently not needed with a 304.
     endHeader();
@@ -1257,24 +1875,61 @@ void Connection::process_get() {
   if (!!rq.range) {
     //now is the time to shrink the content range to that requested.
     if (!reply.content.range.restrictTo(rq.range)) {
-      error_reply(416, "Requested Range Not Satisfiable", "You requested an invalid range or a range outside of the file or the file is not normal.");
+      errorPage(ErrorPages::BadRange);
+      return; //was falling through to a 206 header
     }
     startCommonHeader(206, "Partial Content", reply.content.getLength());
+    catf("Content-Range: bytes %llu-%llu/%llu\r\n", llu(reply.content.range.begin), llu(reply.content.range.end - 1), llu(reply.content.fd.getLength())); //closed interval on the wire, was also sent on every 200
   } else {
     startCommonHeader(200, "OK", reply.content.getLength());
   }
   debug("sending %llu-%llu/%llu\n", llu(reply.content.range.begin), llu(reply.content.range.end), llu(reply.content.fd.getLength()));
 
-  reply.header.fd.printf("Content-Range: bytes %llu-%llu/%llu\r\n", llu(reply.content.range.begin), llu(reply.content.range.end), llu(reply.content.fd.getLength())); //may make this conditional on a partial range.if so just move it into the above 'if'
-  reply.header.fd.printf("Content-Type: %s\r\n", mimetype);
-  reply.header.fd.printf("Last-Modified: %s\r\n", lastmod);
+  catf("Content-Type: %s\r\n", mimetype);
+  catf("Last-Modified: %s\r\n", lastmod.image);
   endHeader();
+  if (!reply.header_only) {
+    if (service.shaper.enabled()) {
+      reply.shaping = service.shaper.assign(std::string_view(reinterpret_cast<const char *>(&client), sizeof(client)), relative, now);
+    }
+    if (!reply.index && service.io.enabled() && service.direct.wants(relative, reply.content.fd.getLength())) {
+      startDirect();
+    }
+    if (!reply.directBuffer) {
+      service.advice.start(reply.reading, service.advice.choose(mimetype, reply.content.fd.getLength(), !!rq.range), reply.content.fd, reply.content.range.begin.number);
+    }
+  }
+}
+
+void Connection::startDirect() {
+  auto buffer = service.direct.take();
+  int flags = buffer ? fcntl(reply.content.fd, F_GETFL) : -1;
+  if (flags == -1 || fcntl(reply.content.fd, F_SETFL, flags | O_DIRECT) == -1) { //EINVAL where the filesystem can't
+    if (buffer) {
+      service.direct.give(buffer);
+    }
+    ++service.direct.stats.fallbacks;
+    return;
+  }
+  ++service.direct.stats.replies;
+  reply.directBuffer = buffer;
+  reply.directAt = 0;
+  reply.directGot = 0;
 }
 
 /* Process a request: build the header and reply, advance state. */
 void Connection::process_request() {
   service.fyi.num_requests++;
-
+  reply.startedAt = Ticks::now();
+
+  if (service.overload.shedding) {
+    ++service.overload.stats.shed;
+    rq.keepalive.dieNow = true; //one connection fewer
+    errorPage(ErrorPages::Unavailable);
+  } else if (tracked && !service.clients.request(*tracked, reply.startedAt)) {
+    rq.keepalive.dieNow = true; //it must connect again, which --per-client-connections also limits
+    errorPage(ErrorPages::TooManyRequests);
+  } else
 #if DarklySupportForwarding
   if (service.forward.to_https && is_https_redirect) { //this seems to forward all traffic to https due to clause of "no X-forward-proto", but it replicates original source's logic.
     redirect_https();
@@ -1282,14 +1937,14 @@ void Connection::process_request() {
 #endif
   /* fail if: (auth_enabled) AND (client supplied invalid credentials) */
   if (!service.auth(rq.authorization)) {
-    error_reply(401, "Unauthorized", "Access denied due to invalid credentials.");
+    errorPage(ErrorPages::Unauthorized);
   } else if (rq.method == Request::GET) {
     process_get();
   } else if (rq.method == Request::HEAD) {
     reply.header_only = true; //setting early so that process can skip steps such as just sizing a response rather than generating it.
     process_get();
   } else {
-    error_reply(501, "Not Implemented", "The method you specified is not implemented.");
+    errorPage(ErrorPages::NotImplemented);
   }
   /* advance state */
   state = SEND_HEADER;
@@ -1299,7 +1954,8 @@ void Connection::process_request() {
 void Connection::poll_recv_request() {
   // char buf[1 << 15]; //32k is excessive, refuse any request that is longer than a header+maximum filename + any options allowed with a '?' for processing a file (of which the only ones of interest are directory listing options).
   assert(state == RECV_REQUEST);
-  ssize_t recvd = recv(socket, rq.received.begin(), sizeof(rq.theRequest) - rq.received.length, MSG_DONTWAIT); //MSG_DONTWAIT in case we are wrong about there being at least one byte of data present when a connection is accepted.
+  bool fresh = served && !rq.theRequest[0]; //the first bytes of another request, the first one is timed from the accept
+  ssize_t recvd = rq.receive(socket);
   debug("poll_recv_request(%d) got %d bytes\n", int(socket), int(recvd));
   if (recvd == -1) {
     if (errno == EAGAIN) {
@@ -1308,35 +1964,69 @@ void Connection::poll_recv_request() {
     }
     debug("recv(%d) error: %s\n", int(socket), strerror(errno));
     rq.keepalive.dieNow = true;
-    state = DONE;
+    markDone();
     return;
   }
-  if (recvd == 0) {
-    return; //original asserted here, but a 0 return is legal, while rare.
+  if (recvd == 0) { //original asserted here, it is the client hanging up. Ignoring it left epoll reporting it forever.
+    rq.keepalive.dieNow = true;
+    markDone();
+    return;
   }
   service.fyi.total_in += recvd;
-  last_active = service.now();
+  progressed();
+  if (fresh) {
+    requestAt = progressAt;
+    service.notIdle(this);
+  }
+  takeRequest();
+}
 
-  *rq.received.begin() = 0; //make the buff into a null terminated string.
+void Connection::takeRequest() {
+  if (!rq.headerComplete()) {
+    if (rq.received.length || rq.grow()) {
+      return; //wait for the rest, this used to reply 400 to anything that didn't arrive in one piece.
+    }
+    ++service.requestBuffers.stats.tooLong;
+    rq.keepalive.dieNow = true;
+    errorPage(strchr(rq.theRequest, '\n') ? ErrorPages::HeaderTooLong : ErrorPages::UriTooLong); //no end to the request line yet
+    state = SEND_HEADER;
+    poll_send_header();
+    return;
+  }
 
   bool readyToRoll = rq.parse();
   /* cmdline flag can be used to deny keep-alive */
   if (!service.want_keepalive) {
     rq.keepalive.dieNow = true; //override parse.
   }
+  ++served;
+  if (!rq.keepalive.dieNow) {
+    auto limit = service.keepAliveTerms().requests;
+    if ((limit && served >= limit) || (rq.keepalive.max && served >= rq.keepalive.max)) {
+      rq.keepalive.dieNow = true; //this is its last
+      ++service.keepAlive.stats.spent;
+    }
+  }
 
 
   if (!readyToRoll) {
     //todo: distinguish between not all here yet and too corrupt to process.
-    error_reply(400, "Bad Request", "You sent a request that the server couldn't understand.");
-
-    // /* die if it's too large */
-    // if (request.length > MAX_REQUEST_LENGTH) {
-    //   default_reply(413, "Request Entity Too Large", "Your request was dropped because it was too long.");
-    //   state = SEND_HEADER;
-    // }
+    errorPage(ErrorPages::Garbled);
+    state = SEND_HEADER;
+    poll_send_header();
     return;
   }
+  if (rq.contentLength) {
+    rq.keepalive.dieNow = true; //we don't read bodies, what follows the header isn't another request
+    if (rq.contentLength > service.requestBuffers.limit) {
+      ++service.requestBuffers.stats.tooLong;
+      errorPage(ErrorPages::ContentTooLarge);
+      state = SEND_HEADER;
+      poll_send_header();
+      return;
+    }
+  }
+  process_request();
   /* if we've moved on to the next state, try to send right away, instead of
    * going through another iteration of the select() loop.
    */
@@ -1345,9 +2035,27 @@ void Connection::poll_recv_request() {
   }
 }
 
-int Connection::sendRange(Replier::Block &sending) {
-  auto sent = send_from_file(socket, sending.fd, sending.range);
-  last_active = service.now(); //keeps alive while shuffling bytes to client.
+int Connection::sendRange(Replier::Block &sending, off_t most) {
+  if (sending.range.begin >= sending.range.end) {
+    return -2; //empty file, else the zero byte send below looks like a closure
+  }
+  ssize_t sent;
+  if (sending.memory) {
+    sent = send(socket, sending.memory + sending.range.begin.number, sending.range.getLength(), MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (sent > 0) {
+      sending.range.begin.number += sent;
+    }
+  } else {
+    if (allowance < size_t(most)) {
+      most = allowance;
+    }
+    most = shaped(std::min(sending.range.getLength(), most));
+    if (!most) {
+      return 0; //throttled, as if the socket were full
+    }
+    sent = send_from_file(socket, sending.fd, sending.range, most);
+  }
+  progressed(); //keeps alive while shuffling bytes to client.
   debug("sendRange(%d) sent %d bytes\n", int(socket), (int) sent);
   debug("socket(%d) sent %ld: [%llu-%llu] of %s\n", int(socket), sent, llu(sending.range.begin), llu(sending.range.end), "someday the filename will go here");
 
@@ -1360,13 +2068,13 @@ int Connection::sendRange(Replier::Block &sending) {
     if (sent == -1) {
       debug("send(%d) error: %s\n", int(socket), strerror(errno));
       debug("send_from_file returned %lld (errno=%d %s)\n", llu(sent), errno, strerror(errno));
-      return errno;
+      return -1; //was errno, which the callers took as "some sent ok" and so left the connection hanging.
     }
     //what does zero bytes mean?
     //if header: rq.keepalive.dieNow = true;
     return -1;
   }
-  service.fyi.total_out += sent;
+  spend(sent);
 
   /* check if we're done sending */
   return sending.range.begin >= sending.range.end ? -2 : 0; //>= instead of == while working on off by one issue.
@@ -1374,20 +2082,25 @@ int Connection::sendRange(Replier::Block &sending) {
 
 /* Sending header.  Assumes conn->header is not NULL. */
 void Connection::poll_send_header() {
+  if (reply.gathered()) {
+    poll_send_generated(); //the header goes out with the first of the body
+    return;
+  }
   switch (sendRange(reply.header)) {
     case -1: //abnormal  termination
       rq.keepalive.dieNow = true;
-      state = DONE;
+      markDone();
       break;
     case -2: //add data sent
       if (reply.header_only) {
-        state = DONE;
+        markDone();
       } else {
         state = SEND_REPLY;
         poll_send_reply();
       }
       break;
-    default: //some sent ok, expect event on reply.fd
+    default: //some sent ok, the socket is full
+      listenFor(EPOLLOUT);
       break;
   }
 }
@@ -1395,34 +2108,388 @@ void Connection::poll_send_header() {
 
 /* Sending reply. */
 void Connection::poll_send_reply() {
-  switch (sendRange(reply.content)) {
+  if (reply.gathered()) {
+    poll_send_generated();
+    return;
+  }
+  if (reply.loading) {
+    return; //a worker is reading the window in, loaded() will call again
+  }
+  if (!allowance) { //the header took it all
+    sendLater();
+    return;
+  }
+  if (reply.directBuffer) {
+    poll_send_direct();
+    return;
+  }
+  off_t most = std::numeric_limits<off_t>::max();
+  auto &range = reply.content.range;
+  service.advice.advance(reply.reading, reply.content.fd, range.begin.number, range.end.number); //before the residency check, so a hint ahead is already under way
+  if (service.io.enabled() && range.getLength() > 0) {
+    if (reply.hotTo == 0 && range.getLength() <= off_t(IoPool::ProbeAbove)) { //a small reply, a probe costs more than the rare miss
+      reply.hotTo = range.end.number;
+      ++service.io.stats.unprobed;
+    } else if (range.begin.number >= reply.hotTo) { //check the next window, so that sendfile doesn't block the loop on the disk
+      size_t window = std::min(off_t(IoPool::Window), range.getLength());
+      reply.hotTo = range.begin.number + window;
+      if (!service.io.resident(reply.content.fd, range.begin.number, window) && service.io.load(*this, reply.ioTicket, reply.content.fd, range.begin.number, window)) {
+        reply.loading = true;
+        listenFor(0);
+        return;
+      }
+      ++service.io.stats.inlined;
+    }
+    most = reply.hotTo - range.begin.number;
+  }
+  switch (sendRange(reply.content, most)) {
     case -1: //abnormal  termination
       debug("send(%d) closure\n", int(socket));
       rq.keepalive.dieNow = true;
-      state = DONE;
+      markDone();
       return;
     case -2: //add data sent
-      state = DONE;
+      service.advice.advance(reply.reading, reply.content.fd, range.begin.number, range.end.number); //drops the last of it
+      markDone();
       return;
-    default: //some sent ok, expect event on reply.fd
+    default: //some sent ok, the socket is full or the turn is over
+      sendLater();
       break;
   }
 }
 
-void Connection::generate_dir_listing(const char *path, const char *decoded_url) {
+/* Sending an O_DIRECT file, from the buffer a worker read the part at range.begin into. Ranges work as for sendfile, reads are aligned down and the front of the buffer skipped. */
+void Connection::poll_send_direct() {
+  auto &range = reply.content.range;
+  while (true) {
+    if (range.begin.number >= range.end.number) {
+      markDone();
+      return;
+    }
+    off_t have = reply.directAt + reply.directGot;
+    if (range.begin.number < reply.directAt || range.begin.number >= have) {
+      reply.directAt = range.begin.number & ~off_t(DirectPool::Align - 1);
+      reply.directGot = 0;
+      if (!service.io.read(*this, reply.ioTicket, reply.content.fd, reply.directAt, reply.directBuffer, service.direct.bufferSize)) {
+        rq.keepalive.dieNow = true;
+        markDone();
+        return;
+      }
+      reply.loading = true;
+      listenFor(0);
+      return;
+    }
+    size_t length = shaped(std::min(size_t(std::min(off_t(range.end.number), have) - range.begin.number), allowance));
+    if (!length) {
+      sendLater();
+      return;
+    }
+    auto sent = send(socket, reply.directBuffer + (range.begin.number - reply.directAt), length, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (sent == -1) {
+      if (errno == EAGAIN) {
+        listenFor(EPOLLOUT);
+        return;
+      }
+      debug("send(%d) error: %s\n", int(socket), strerror(errno));
+      rq.keepalive.dieNow = true;
+      markDone();
+      return;
+    }
+    progressed();
+    spend(sent);
+    range.begin.number += sent;
+    if (size_t(sent) < length || !allowance) {
+      sendLater();
+      return;
+    }
+  }
+}
+
+void Connection::loaded(unsigned ticket, char *into, ssize_t got) {
+  if (ticket != reply.ioTicket || !reply.loading) {
+    if (into) {
+      service.direct.give(into); //the request it was read for has gone, Replier::clear left the buffer to us
+    }
+    return; //timed out or closed while the worker read, and maybe onto another request by now
+  }
+  reply.loading = false;
+  allowance = service.fair.allowance();
+  if (into) {
+    if (got <= 0 || reply.directAt + got <= off_t(reply.content.range.begin.number)) { //a read error or the file shrank. The header promised more, closing is all we can do.
+      //a short read that stops before where we are sending from would otherwise be read again, forever
+      debug("direct read(%d) failed: %s\n", int(socket), got < 0 ? strerror(-got) : "end of file");
+      rq.keepalive.dieNow = true;
+      markDone();
+      return;
+    }
+    reply.directGot = got;
+    service.direct.stats.bytes += got;
+  }
+  poll_send_reply();
+}
+
+/* Sending what is left of the header, its pre-rendered part, and a body from memory or generated, in one sendmsg, running the body's producer each time the socket has taken all that it made.
+ * The producer only gets ahead of the socket by the ring's few buffers, after that it waits for EPOLLOUT. */
+void Connection::poll_send_generated() {
+  state = SEND_REPLY;
+  bool withBody = !reply.header_only;
+  Replier::Block *blocks[] = {&reply.header, &reply.fixedHeader, withBody ? &reply.content : nullptr};
+  while (true) {
+    if (withBody && !reply.body.pending() && reply.producer && !reply.loading) {
+      bool more = reply.producer->produce(reply.body);
+      reply.body.flush(!more);
+      if (!more) {
+        reply.producer.reset();
+      } else if (reply.producer->waiting()) {
+        reply.loading = true; //on the StatPool, loaded() calls again
+      }
+      if (reply.body.wasTruncated()) {
+        rq.keepalive.dieNow = true; //the body is short, the client can only tell from the closure
+      }
+    }
+    iovec iov[3 + BodyRing::Slots + 1];
+    unsigned used = 0;
+    size_t offered = 0;
+    for (auto block: blocks) {
+      if (block && block->memory && block->unsent()) {
+        iov[used++] = {const_cast<char *>(block->memory) + block->range.begin.number, block->unsent()};
+        offered += block->unsent();
+      }
+    }
+    if (withBody) {
+      used += reply.body.gather(iov + used);
+      offered += reply.body.pending();
+    }
+    if (!used) {
+      if (reply.loading) {
+        listenFor(0);
+        return;
+      }
+      markDone();
+      return;
+    }
+    if (!allowance) {
+      sendLater();
+      return;
+    }
+    msghdr message{};
+    message.msg_iov = iov;
+    message.msg_iovlen = used;
+    auto sent = sendmsg(socket, &message, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (sent == -1) {
+      if (errno == EAGAIN) {
+        listenFor(EPOLLOUT);
+        return;
+      }
+      debug("sendmsg(%d) error: %s\n", int(socket), strerror(errno));
+      rq.keepalive.dieNow = true;
+      markDone();
+      return;
+    }
+    progressed();
+    spend(sent);
+    size_t left = sent;
+    for (auto block: blocks) {
+      if (block && block->memory) {
+        size_t taken = std::min(left, block->unsent());
+        block->range.begin.number += taken;
+        left -= taken;
+      }
+    }
+    if (withBody) {
+      reply.body.consume(left);
+    }
+    if (size_t(sent) < offered) {
+      listenFor(EPOLLOUT); //the socket is full, no point in asking again until it says so
+      return;
+    }
+  }
+}
+
+void Connection::spend(ssize_t sent) {
+  service.fyi.total_out += sent;
+  reply.sent += sent;
+  allowance -= std::min(allowance, size_t(sent));
+  if (service.shaper.enabled()) {
+    service.shaper.spend(reply.shaping, sent); //headers and generated bodies count too, though only files wait for tokens
+  }
+  recount();
+}
+
+size_t Connection::shaped(size_t wanted) {
+  if (!service.shaper.enabled()) {
+    return wanted;
+  }
+  auto may = service.shaper.allow(reply.shaping, wanted, Ticks::now(), reply.wakeAt);
+  reply.throttled = !may;
+  return may;
+}
+
+void Connection::onTimer(unsigned ticket) {
+  if (ticket != reply.timerTicket || !reply.throttled) {
+    return; //closed or onto another request since parking
+  }
+  reply.throttled = false;
+  onEpoll(EPOLLOUT);
+}
+
+void Connection::sendLater() {
+  recount(); //one that is stuck counts even if it never got to send
+  if (reply.throttled) {
+    listenFor(0); //nothing to do until the tokens are there, whatever the socket says
+    service.timers.schedule(*this, reply.timerTicket, reply.wakeAt);
+    return;
+  }
+  if (allowance) {
+    listenFor(EPOLLOUT);
+    return;
+  }
+  listenFor(0); //the socket is probably still writable, epoll would call us straight back
+  deferred = true;
+  ++reply.deferrals;
+  service.fair.defer(*this);
+}
+
+/* change what epoll tells us about, a remove and a watch as our Epoller has no modify. Sending only listens for EPOLLOUT when a send came up short,
+ * so a small reply that goes out at once costs no epoll_ctl at all, and an idle keep-alive connection isn't woken for being writable. */
+void Connection::listenFor(unsigned flags) {
+  if (flags == interest) {
+    return;
+  }
+  if (interest) {
+    service.epoller.remove(socket);
+  }
+  interest = flags;
+  if (interest) {
+    service.epoller.watch(socket, interest, *this);
+  }
+}
+
+void Connection::generate_dir_listing(int dirfd, const char *decoded_url) {
   //preparing to have different listing generators, such as "system("ls") with '?'params fed to ls as its params.
-  HtmlDirLister(*this)(path, decoded_url);
+  reply.kind = Replier::Listing;
+  struct stat dir;
+  if (fstat(dirfd, &dir) == -1) {
+    error_reply(500, "Internal Server Error", "Couldn't list directory: %s", strerror(errno));
+    return;
+  }
+  char key[FILENAME_MAX + 100];
+  auto keyLength = ListingCache::makeKey(key, sizeof(key), dir, decoded_url, rq.urlParams ? rq.urlParams : "");
+  auto now = Ticks::now();
+  reply.pinned = keyLength ? service.listings.find({key, keyLength}, now) : nullptr;
+  if (!reply.pinned) {
+    auto stream = std::make_unique<ListingStream>();
+    stream->options.parse(rq.urlParams); //after the key is made, this splits the text up
+    stream->options.followSymlinks = service.resolver.symlinks.policy == Resolver::SymlinkPolicy::Any;
+    stream->pool = &service.statPool;
+    stream->waiter = this;
+    stream->ticket = reply.ioTicket;
+    if (!stream->begin(dirfd, decoded_url)) {
+      if (errno == EACCES) {
+        errorPage(ErrorPages::Forbidden);
+      } else if (errno == ENOENT) {
+        errorPage(ErrorPages::NotFound);
+      } else {
+        error_reply(500, "Internal Server Error", "Couldn't list directory: %s", strerror(errno));
+      }
+      return;
+    }
+    stream->footer = "<hr>\n";
+    if (service.want_server_id) { //the time is when it was rendered, which is still true when served from the cache
+      char generated[200];
+      stream->footer.append(generated, snprintf(generated, sizeof(generated), "Generated by %s on %s\n", pkgname, service.timetText()));
+    }
+    stream->footer += "</body></html>\n";
+
+    if (stream->entries() > ListingStream::StreamAbove || stream->deferred()) { //too big to build before sending, nor worth caching, or waiting on the pool
+      rq.keepalive.dieNow |= !rq.http11; //without chunking the end of the body is the end of the connection
+      startCommonHeader(200, "OK");
+      catf("Content-Type: %s\r\n", stream->contentType());
+      if (rq.http11) {
+        catFixed("Transfer-Encoding: chunked\r\n");
+      }
+      endHeader();
+      reply.body.start(rq.http11);
+      reply.producer = std::move(stream);
+      return;
+    }
+
+    stream->pool = nullptr; //a page this small is statted inline
+    auto rendered = std::make_unique<ListingCache::Rendered>();
+    auto &body = rendered->body;
+    StringSink whole{body};
+    while (stream->produce(whole)) {}
+    rendered->contentType = stream->contentType();
+    snprintf(rendered->etag, sizeof(rendered->etag), "\"%llx-%zx\"", llu(dir.st_mtim.tv_sec * 1000000000LL + dir.st_mtim.tv_nsec), std::hash<std::string>{}(body));
+    std::string_view relative(decoded_url);
+    while (relative.starts_with('/')) {
+      relative.remove_prefix(1);
+    }
+    while (relative.ends_with('/')) {
+      relative.remove_suffix(1);
+    }
+    rendered->directory = relative;
+    if (!service.watcher.cover(rendered->directory)) {
+      rendered->expires = now + service.watcher.revalidateMs * Ticks::perMilli;
+    }
+    reply.pinned = keyLength ? service.listings.keep({key, keyLength}, std::move(rendered)) : ListingCache::Pin(std::move(rendered));
+  }
+
+  auto &listing = *reply.pinned;
+  if (rq.if_none_match && (rq.if_none_match == "*" || std::string_view(rq.if_none_match.begin(), rq.if_none_match.length).find(listing.etag) != std::string_view::npos)) { //a list of tags, a substring search suffices as ours are quoted
+    reply.kind = Replier::NotModified;
+    reply.header_only = true;
+    startCommonHeader(304, "Not Modified");
+    catf("ETag: %s\r\n", listing.etag);
+    endHeader();
+    return;
+  }
+  startCommonHeader(200, "OK", listing.body.size());
+  catf("Content-Type: %s\r\n", listing.contentType);
+  catf("ETag: %s\r\n", listing.etag);
+  endHeader();
+  reply.content.fromMemory(listing.body.data(), listing.body.size());
+}
+
+IndexCache::Pin Connection::resolveIndex(int dirfd, std::string_view url, int64_t now) {
+  auto resolution = std::make_unique<IndexCache::Resolution>();
+  for (auto &name: service.indexes.names) {
+    resolution->file = service.resolver.openIn(dirfd, name.c_str(), O_RDONLY | O_NONBLOCK);
+    if (resolution->file.seemsOk()) {
+      if (resolution->file.getLength() < 0 || !resolution->file.isRegularFile()) {
+        errorPage(ErrorPages::NotRegular);
+        return nullptr;
+      }
+      resolution->mimetype = service.contentType(name.c_str());
+      break;
+    }
+    if (errno != ENOENT) {
+      openFailed();
+      return nullptr;
+    }
+  }
+  resolution->directory = url.substr(0, url.empty() ? 0 : url.size() - 1);
+  if (!service.watcher.cover(resolution->directory)) {
+    resolution->expires = now + service.watcher.revalidateMs * Ticks::perMilli;
+  }
+  return service.indexes.keep(url, std::move(resolution));
 }
 
-void Connection::urlDoDirectory() {
+void Connection::useIndex(const IndexCache::Pin &index) {
+  reply.index = index;
+  reply.content.fd = index->file; //a copy with its stat, clear() forgets rather than closes it
+  reply.content.statSize();
+}
+
+void Connection::urlDoDirectory(int dirfd) {
   if (service.no_listing) {
     /* Return 404 instead of 403 to make --no-listing
      * indistinguishable from the directory not existing.
      * i.e.: Don't leak information.
      */
-    error_reply(404, "Not Found", "The URL you requested was not found.");
+    errorPage(ErrorPages::NotFound);
   } else {
-    generate_dir_listing(rq.url, rq.url); //todo: modify this to generate a content file, swapping out the file name and proceding in this module to get it sent.
+    generate_dir_listing(dirfd, rq.url);
   }
 }
 
@@ -1432,7 +2499,14 @@ void Connection::urlDoDirectory() {
 void Server::httpd_poll() {
   // bool bother_with_timeout = false;
 
-  NanoSeconds timeout(timeout_secs);
+  double wait = fair.pending() ? 0 : IdleWakeSecs; //those waiting their turn to send can't wait on epoll, deadlines are on the timers
+  if (auto due = timers.next()) {
+    wait = std::min(wait, std::max(Ticks::seconds(due - Ticks::now()), 0.0));
+  }
+  if (overload.shedding) {
+    wait = std::min(wait, Overload::RecheckMs / 1000.0);
+  }
+  NanoSeconds timeout(wait);
   //
   // if (accepting) {
   //   epoller.watch(sockin,EPOLLIN,nullptr);
@@ -1472,26 +2546,56 @@ void Server::httpd_poll() {
   // if (debug("select() with max_fd %d timeout %d\n", max_fd, bother_with_timeout ? (int) timeout.tv_sec : 0)) {
   //   gettimeofday(&t0, nullptr);
   // }
-  if (epoller.loop(timeout)) {
-        for (auto conn: connections) {
-          conn->poll_check_timeout();
-        // int socket = conn->socket;
-
-      //
-      /* Handling SEND_REPLY could have set the state to done. */
-      if (conn->state == Connection::DONE) {
-        /* clean out finished connection */
-        if (conn->rq.keepalive.dieNow) {
-          //todo: return to pool rather than immediately discarding
-          connections.remove(conn);
-          delete conn;
-        } else { //keeping alive.
-          conn->clear();
-        }
+  auto cpuBefore = Ticks::cpu();
+  bool worked = epoller.loop(timeout);
+  auto returned = Ticks::now(); //loop() includes the wait, lag is timed from here
+  if (timers.fire(returned)) {
+    worked = true;
+  }
+  if (fair.round()) {
+    worked = true; //some may be DONE
+  }
+  auto cpuDispatched = Ticks::cpu();
+  fyi.dispatchCpu += cpuDispatched - cpuBefore;
+  if (worked) {
+    ++fyi.wakeups;
+  }
+  //only those that reached DONE are looked at, they put themselves on the list, so an idle connection costs nothing here
+  while (auto conn = done) {
+    done = conn->nextDone;
+    conn->nextDone = nullptr;
+    ++fyi.doneHandled;
+    finished(*conn);
+    /* clean out finished connection */
+    if (conn->rq.keepalive.dieNow) {
+      release(conn);
+      continue;
+    }
+    //keeping alive.
+    conn->clear(true);
+    conn->state = Connection::RECV_REQUEST; //else it never read its next request
+    conn->listenFor(EPOLLIN);
+    conn->progressAt = Ticks::now(); //idle from now
+    if (conn->rq.received.start) { //the client sent its next request without waiting for this reply
+      conn->requestAt = conn->progressAt;
+      conn->takeRequest(); //if it is all here it is answered now, as epoll won't say anything about bytes we already have. It comes back on this list when done.
+    } else {
+      nowIdle(conn);
+    }
+    conn->rearm();
+  }
+  fyi.doneCpu += Ticks::cpu() - cpuDispatched;
+  //lag is the wall time from the wakeup to the last finished connection, so blocking and time spent off the cpu count as much as work does.
+  auto drained = Ticks::now();
+  if (overload.update(drained, drained - returned, live, max_connections > 0 ? unsigned(max_connections) : 0, pending)) {
+    if (overload.shedding) {
+      pauseAccepting(false); //resumeAccepting won't while shedding
+      for (auto conn = connections; conn; conn = conn->next) {
+        conn->rearm(); //idle ones now have overload.keepAliveSecs, once an episode
       }
+    } else {
+      resumeAccepting();
     }
-  } else {
-    //todo: debug message about failed poll attempt
   }
 
   // if (debug(nullptr)) {
@@ -1611,6 +2715,13 @@ void Server::stop_running(int sig unused) {
   }
 }
 
+/* report stats at the next opportunity, printf is not safe in a signal handler */
+void Server::want_stats(int sig unused) {
+  if (forSignals) {
+    forSignals->statsWanted = true;
+  }
+}
+
 void Server::ReallyDarkLogger::put(Connection::Request::HttpMethods method) {
   switch (method) {
     case Connection::Request::GET:
@@ -1642,6 +2753,49 @@ void Server::reportStats() const {
     static_cast<unsigned int>(r.ru_stime.tv_usec / 10000));
   printf("Requests: %llu\n", llu(fyi.num_requests));
   printf("Bytes: %llu in, %llu out\n", llu(fyi.total_in), llu(fyi.total_out));
+  printf("Wakeups: %llu, dispatch %.3f us/wakeup, finishing %.3f us/wakeup for %.1f connections\n", llu(fyi.wakeups),
+    fyi.wakeups ? fyi.dispatchCpu / 1e3 / fyi.wakeups : 0.0,
+    fyi.wakeups ? fyi.doneCpu / 1e3 / fyi.wakeups : 0.0,
+    fyi.wakeups ? double(fyi.doneHandled) / fyi.wakeups : 0.0);
+  printf("Pooled connections reused: %llu\n", llu(fyi.pooled));
+  printf("Body buffers: %llu taken, %llu allocated, %zu outstanding, %zu peak\n", llu(buffers.stats.taken), llu(buffers.stats.allocated), buffers.stats.outstanding, buffers.stats.peak);
+  printf("Disk reads: %llu small replies sent unprobed, %llu windows sent inline, %llu deferred, %llu loaded, %.3f s of blocking kept off the loop\n", llu(io.stats.unprobed), llu(io.stats.inlined), llu(io.stats.deferred), llu(io.stats.completed), Ticks::seconds(io.stats.stalled));
+  printf("Listing stats: %llu batches of %llu entries on threads, %.3f s kept off the loop\n", llu(statPool.stats.batches), llu(statPool.stats.entries), Ticks::seconds(statPool.stats.stalled));
+  printf("Direct reads: %llu replies, %llu fell back to the page cache, %llu reads, %llu bytes\n", llu(direct.stats.replies), llu(direct.stats.fallbacks), llu(io.stats.reads), llu(direct.stats.bytes));
+  printf("Send fairness: %zu byte turns, %llu deferred in %llu rounds, %zu most waiting, %llu most turns for one reply\n", fair.quantum, llu(fair.stats.deferred), llu(fair.stats.rounds), fair.stats.longest, llu(fair.stats.deferredMost));
+  for (auto [title, histogram]: {std::pair{"one turn", &fair.stats.small}, std::pair{"several turns", &fair.stats.large}}) {
+    printf("  replies in %s: %llu, request to last byte p50 %.3f ms, p99 %.3f ms, max %.3f ms\n", title, llu(histogram->count()), histogram->percentile(50) / 1e6, histogram->percentile(99) / 1e6, histogram->percentile(100) / 1e6);
+  }
+  printf("Request buffers: %llu requests outgrew the %zu inline bytes (%.2f%%), taken", llu(requestBuffers.stats.promoted), Connection::Request::InlineSize, fyi.num_requests + requestBuffers.stats.tooLong ? 100.0 * requestBuffers.stats.promoted / (fyi.num_requests + requestBuffers.stats.tooLong) : 0.0); //those refused never got to be counted as requests
+  for (unsigned which = 0; which < RequestBuffers::Classes; ++which) {
+    printf(" %zuK:%llu", (RequestBuffers::Smallest << which) >> 10, llu(requestBuffers.stats.taken[which]));
+  }
+  printf(", %llu allocated, %u in use (most %u), %zu idle, %llu too long\n", llu(requestBuffers.stats.allocated), requestBuffers.stats.inUse, requestBuffers.stats.mostInUse, requestBuffers.idleCount(), llu(requestBuffers.stats.tooLong));
+  printf("Deadlines: closed %llu idle, %llu slow to send a header, %llu slower than --min-recv-rate, %llu stalled sending, %llu over --send-timeout\n", llu(deadlines.stats.idle), llu(deadlines.stats.header), llu(deadlines.stats.slow), llu(deadlines.stats.stalled), llu(deadlines.stats.send));
+  printf("Keep-alive: room for %u, %llu idle closed to make room, %llu closed at their request limit", keepAlive.capacity, llu(keepAlive.stats.reaped), llu(keepAlive.stats.spent));
+  if (keepAlive.stats.shortest != ~0u) {
+    printf(", idle timeout went down to %u s", keepAlive.stats.shortest);
+  }
+  printf("\n");
+  printf("Overload: %llu episodes, %.3f s shedding, %llu requests answered 503, worst lag %.3f ms, worst pending %llu bytes\n", llu(overload.stats.episodes), Ticks::seconds(overload.stats.sheddingFor), llu(overload.stats.shed), overload.stats.worstLag / 1e6, llu(overload.stats.worstPending));
+  printf("Access list: %zu ranges, %llu connections denied\n", access.size(), llu(access.stats.denied));
+  printf("Accepting: %llu connections in %llu wakeups, most %u at once, by batch 0-1:%llu 2-3:%llu 4-7:%llu 8-15:%llu 16+:%llu\n", llu(fyi.accepted), llu(fyi.acceptWakeups), fyi.acceptBatchMost, llu(fyi.acceptBatches[0]), llu(fyi.acceptBatches[1]), llu(fyi.acceptBatches[2]), llu(fyi.acceptBatches[3]), llu(fyi.acceptBatches[4]));
+  printf("Client table: %u slots, %u live, %llu tracked (%llu in aged slots), %llu untracked, %llu connections refused, %llu requests limited. Accepting paused %llu times\n", clients.slots, clients.stats.live, llu(clients.stats.tracked), llu(clients.stats.reused), llu(clients.stats.untracked), llu(clients.stats.refused), llu(clients.stats.limited), llu(fyi.acceptPauses));
+  printf("Rate limits: %llu sends throttled, %.3f s parked, %llu bytes shaped, %zu client buckets, %llu swept. Timers: %llu scheduled, %llu fired, %zu most pending\n", llu(shaper.stats.throttled), Ticks::seconds(shaper.stats.parked), llu(shaper.stats.shaped), shaper.clients(), llu(shaper.stats.swept), llu(timers.stats.scheduled), llu(timers.stats.fired), timers.stats.longest);
+  printf("Read advice: %llu sequential, %llu windows ahead, %llu dropped behind\n", llu(advice.stats.sequential), llu(advice.stats.ahead), llu(advice.stats.dropped));
+  printf("Negative cache: %llu hits (opens saved), %llu remembered, %zu entries, %llu evicted, %llu invalidated\n", llu(missing.stats.hits), llu(missing.stats.remembered), missing.entries(), llu(missing.stats.evictions), llu(missing.stats.invalidated));
+  printf("Index cache: %llu hits, %llu misses, %zu entries, %llu evicted, %llu invalidated\n", llu(indexes.stats.hits), llu(indexes.stats.misses), indexes.entries(), llu(indexes.stats.evictions), llu(indexes.stats.invalidated));
+  printf("Listing cache: %llu hits, %llu misses, %zu entries, %zu bytes, %llu evicted, %llu invalidated\n", llu(listings.stats.hits), llu(listings.stats.misses), listings.entries(), listings.used(), llu(listings.stats.evictions), llu(listings.stats.invalidated));
+  printf("Watches: %llu held, %llu refused, %llu events, %llu invalidations, %llu overflows\n", llu(watcher.stats.watches), llu(watcher.stats.refused), llu(watcher.stats.events), llu(watcher.stats.invalidations), llu(watcher.stats.overflows));
+#if DarklyCountAllocations
+  printf("Heap calls: %llu accepting", llu(fyi.acceptAllocations));
+  for (unsigned kind = 0; kind < Connection::Replier::KindCount; ++kind) {
+    auto &tally = fyi.allocations[kind];
+    printf(", %s %.2f/request (%llu calls in %llu)", Connection::Replier::kindName(Connection::Replier::Kind(kind)), tally.requests ? double(tally.calls) / tally.requests : 0.0, llu(tally.calls), llu(tally.requests));
+  }
+  printf("\n");
+#endif
+  fflush(stdout);
 }
 
 bool Server::prepareToRun() {
@@ -1670,11 +2824,37 @@ bool Server::prepareToRun() {
     err(1, "signal(SIGTERM)");
     return false;
   }
+  if (signal(SIGUSR1, want_stats) == SIG_ERR) {
+    err(1, "signal(SIGUSR1)");
+    return false;
+  }
 
   /* security */
   if (want_chroot) {
     change_root();
   }
+  resolver.begin(wwwroot.length ? wwwroot.begin() : "/"); //after chroot, before dropping privileges which might lose access to it.
+  clients.begin();
+  access.compile();
+  keepAlive.begin(max_connections);
+  errorPages.render(want_server_id ? pkgname : nullptr, custom_hdrs, auth ? authenticateHeader : nullptr);
+  watcher.subscribe(listings);
+  watcher.subscribe(missing);
+  watcher.subscribe(indexes);
+  indexes.setNames(index_name);
+  int notices = watcher.begin(wwwroot.length ? wwwroot.begin() : "/");
+  if (notices != -1) {
+    epoller.watch(notices, EPOLLIN, watcher);
+  }
+  int loads = io.begin(); //threads, so after any daemon fork
+  if (loads != -1) {
+    epoller.watch(loads, EPOLLIN, io);
+  }
+  statPool.threads = io.threads;
+  int statted = statPool.begin();
+  if (statted != -1) {
+    epoller.watch(statted, EPOLLIN, statPool);
+  }
   try {
     if (drop_gid) {
       drop_gid();
@@ -1697,10 +2877,16 @@ bool Server::prepareToRun() {
 }
 
 void Server::freeall() {
+  io.finish(); //before the connections its workers would call back
+  statPool.finish();
   /* close and free connections */
-  for (auto conn: connections) {
-    connections.remove(conn);
-    conn->clear();
+  while (auto conn = connections) {
+    connections = conn->next;
+    delete conn;
+  }
+  while (auto conn = pool) {
+    pool = conn->next;
+    delete conn;
   }
 #if DarklySupportForwarding
   forward.map.clear(); // todo; free contents first! Must establish that all were malloc'd
@@ -1817,6 +3003,10 @@ int Server::main(int argc, char **argv) {
     /* main loop */
     while (running) {
       httpd_poll();
+      if (statsWanted) {
+        statsWanted = false;
+        reportStats();
+      }
     }
     /* clean exit */
     xclose(sockin);
@@ -1839,8 +3029,12 @@ int Server::main(int argc, char **argv) {
 }
 
 const char * Server::timetText() {
-  thread_local Now imager(now()); //bridge while reconciling time types.Should implement writing to a FILE rather than passing the string to a writer.
-  imager.format();
+  //wall clock, now() is the epoller's monotonic time which dated every reply 1970. Formatted only when the second changes, which under load is once per many replies.
+  thread_local Now imager;
+  time_t wall = time(nullptr);
+  if (wall != time_t(imager)) {
+    imager = Now(wall);
+  }
   return imager.image;
 }
 
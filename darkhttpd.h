@@ -33,6 +33,7 @@
 
 #pragma once
 
+#include "alloccount.h"
 #include "byterange.h"
 #include "darklogger.h"
 #include "stringview.h"
@@ -41,13 +42,33 @@
 #include "fd.h"
 #include "mimer.h"
 #include "now.h"
+#include "resolver.h"
+#include "fswatch.h"
+#include "listingcache.h"
+#include "missingcache.h"
+#include "indexcache.h"
+#include "iopool.h"
+#include "statpool.h"
+#include "readadvice.h"
+#include "directio.h"
+#include "sendscheduler.h"
+#include "shaper.h"
+#include "timerheap.h"
+#include "clienttable.h"
+#include "accesslist.h"
+#include "overload.h"
+#include "keepalive.h"
+#include "requestbuffers.h"
+#include "bodyproducer.h"
+#include "errorpages.h"
+#include "ticks.h"
 
 #include "epoller.h"
 #include <vector>
 #include <cstring>
+#include <limits>
 #include <cstdint>
 #include <cstdio>
-#include <forward_list>
 
 
 #include <netinet/in.h>
@@ -65,20 +86,40 @@
 #endif
 #endif
 
+//Linux has accept4, TCP_DEFER_ACCEPT and TCP_FASTOPEN, #define DarklySupportLinuxAccept 0 to accept as on other platforms.
+#ifndef DarklySupportLinuxAccept
+#ifdef __linux__
+#define DarklySupportLinuxAccept true
+#endif
+#endif
+
 class DarkException;
 
 namespace DarkHttpd {
   class Server; //server and connection know about each other. Can subclass the shared part and have a clean hierarchy.
 
-  struct Connection : EpollHandler {
+  struct Connection : EpollHandler, IoWaiter, TimerWaiter {
     Fd socket;
     Server &service;
+    Connection *next = nullptr; //Server's list of live connections, or its pool of idle ones. Intrusive so that accepting doesn't allocate a list node.
+    Connection *prev = nullptr; //in the live list, so that leaving it doesn't take a walk
+    Connection *nextDone = nullptr; //Server's list of those that reached DONE since it last looked
+    Connection *idleNewer = nullptr; //Server's list of idle keep-alives, in the order they went idle
+    Connection *idleOlder = nullptr;
 #ifdef HAVE_INET6
     in6_addr client;
 #else
     in_addr_t client;
 #endif
     NanoSeconds last_active = 0;
+    int64_t progressAt = 0; //Ticks of the last bytes in or out, for the deadlines
+    int64_t requestAt = 0; //Ticks the first byte of the request being received came, or of the accept
+    unsigned interest = 0; //what the epoller was last told to watch for
+    bool deferred = false; //in the SendScheduler's line, waiting for its next turn
+    ClientTable::Entry *tracked = nullptr; //its client's entry for the abuse limits, null when untracked
+    size_t allowance = 0; //bytes this turn may still send
+    unsigned served = 0; //requests read on this connection, for the keep-alive request limit
+    size_t counted = 0; //what this connection's reply adds to the Server's pending
 
     enum {
       BORN = 0, /* constructed, not fully initialized */
@@ -90,10 +131,15 @@ namespace DarkHttpd {
 
 
     struct Request {
-      //the following should be a runtime or at least compile time option. This code doesn't support put or post so it does not receive arbitrarily large requests.
-      static constexpr size_t RequestSizeLimit = 1500; //vastly more than is needed for most GET'ing, this would only be small for a PUT and we will stream around the buffer by parsing as the content arrives and recognizing the PUT and the header boundary soon enough to do that.
-      char theRequest[RequestSizeLimit + 1/*for null terminator */];
+      //This code doesn't support put or post so it does not receive arbitrarily large requests.
+      static constexpr size_t InlineSize = 1024; //more than most GET'ing needs, a header that outgrows it moves to one from the RequestBuffers, up to --max-request-header.
+      char inlineRequest[InlineSize + 1/*for null terminator */];
+      char *theRequest = inlineRequest;
+      size_t capacity = InlineSize; //of theRequest, not counting the null
+      RequestBuffers *buffers = nullptr; //where theRequest comes from when it isn't inlineRequest
       StringView received{nullptr, 0, 0}; //bytes in.
+      size_t headerEnd = 0; //bytes of theRequest through the blank line, what follows is the next request when the client pipelines
+      uint64_t contentLength = 0; //of a body we don't read
 
       /* request fields */
       enum HttpMethods {
@@ -109,36 +155,63 @@ namespace DarkHttpd {
       StringView authorization;
       bool is_https_redirect; //This just indicates protocol that the client says that they sent out, in case intervening layers strip that info. Its only use should be on outgoing redirection requests. Should be named 'redirect_is_https'
       Now if_mod_since;
+      StringView if_none_match; //ETag list, we only hand out ETags for listings
+      bool http11 = false;
       ByteRange range;
 
       struct Lifetime {
         bool dieNow = true;
-        unsigned requested = 0;
-        unsigned max = 0;
+        unsigned requested = 0; //client's Keep-Alive: timeout=
+        unsigned max = 0; //client's Keep-Alive: max=
 
-        bool timeToDie(time_t beenAlive);
-
-        unsigned &cli_timeout;
-
-        Lifetime(unsigned &cli_Timeout) : cli_timeout{cli_Timeout} {}
+        /** @returns the idle timeout of @param offered seconds, or the client's if it asked for less. 0 is none. */
+        unsigned idleSecs(unsigned offered) const {
+          return requested && (requested < offered || !offered) ? requested : offered;
+        }
       } keepalive;
 
-      void clear();
+      /** forget this request, keeping what arrived after its header when @param keepPipelined, as that is the start of the next one */
+      void clear(bool keepPipelined = false);
 
-      Request(unsigned &cli_timeout);
+      Request();
 
       bool parse();
 
-      /* call recv on the socket */
+      /* call recv on the socket, appending to what has been received */
       ssize_t receive(int socket);
+
+      /** move what has been received to a larger buffer. @returns false when that would be over the limit. */
+      bool grow();
+
+      /** whether the blank line that ends the header has arrived, noting where it is in headerEnd */
+      bool headerComplete();
     } rq;
 
     struct Replier {
       int http_code = 0;
       bool header_only = false; //todo: this is ugly, should be in range of checking get vs head and content size.
 
+      /** which path produced the reply, for the per path statistics */
+      enum Kind {
+        StaticFile = 0,
+        NotModified,
+        Listing,
+        ErrorPage,
+        Redirect,
+        KindCount
+      } kind = StaticFile;
+
+      static const char *kindName(Kind kind);
+
+      /** the header is built here rather than in a temp file, it is small and goes out with one send. */
+      static constexpr size_t HeaderSizeLimit = 1024;
+      char headerText[HeaderSizeLimit];
+      size_t headerUsed = 0;
+      bool headerOverflow = false;
+
       struct Block {
         Fd fd;
+        const char *memory = nullptr; //when not null the block is sent from here rather than from fd.
         // bool dont_free = false;
         //altering range begin rather than having a separate variable which usually was added to it dynamically  size_t sent = 0;
         ByteRange range; //tracks sending.
@@ -154,15 +227,23 @@ namespace DarkHttpd {
           range.setForSize(fd.getLength()); //we'll apply request range to this momentarily
         }
 
-        FILE *createTemp();
+        void fromMemory(const char *text, size_t length) {
+          memory = text;
+          range.setForSize(length);
+        }
 
         off_t getLength();
 
+        /** bytes of range not yet sent */
+        size_t unsent() const {
+          return range.begin.number < range.end.number ? range.end.number - range.begin.number : 0;
+        }
+
         /** @returns whether we have a good range and good fd
          * this is a key functionality, its logic must be based on httpd, not personal opinion of what makes a file good or bad.
          */
         bool operator!() {
-          return !fd.seemsOk() || getLength() < 0;
+          return (!memory && !fd.seemsOk()) || getLength() < 0;
         }
 
         bool isRegularFile() {
@@ -171,11 +252,53 @@ namespace DarkHttpd {
       };
 
       Block header;
+      Block fixedHeader; //the pre-rendered rest of the header after the per request lines in header, from ErrorPages
       Block content;
+      ListingCache::Pin pinned; //a cached listing that content.memory points into, held until sent.
+      IndexCache::Pin index; //an index file that content.fd shares with the cache, held until sent.
+      BodyRing body; //generated content, sent instead of content when in use
+      std::unique_ptr<BodyProducer> producer; //when not null body is refilled from it as the socket takes it.
+
+      /* reading content that isn't in the page cache on an IoPool worker */
+      unsigned ioTicket = 0; //changes with each request, so a late load is recognized
+      bool loading = false;
+      off_t hotTo = 0; //content is known resident up to here
+      ReadAdvice::Cursor reading; //page cache hints for content
+
+      /* O_DIRECT sending, content is read into directBuffer by an IoPool worker and sent from there */
+      char *directBuffer = nullptr;
+      off_t directAt = 0; //file offset of directBuffer[0]
+      size_t directGot = 0; //bytes the read put there
+      DirectPool *directPool = nullptr;
+
+      /* for the fairness statistics */
+      int64_t startedAt = 0; //Ticks when the request was complete
+      uint64_t sent = 0;
+      unsigned deferrals = 0; //turns that ended with the allowance spent
+
+      /* rate limits */
+      Shaper::Grant shaping; //the client and path buckets content is charged to
+      Shaper *shaper = nullptr;
+      bool throttled = false; //out of tokens, parked on the timers until wakeAt
+      int64_t wakeAt = 0;
+      unsigned timerTicket = 0; //changes with each request, so a late timer is recognized
+
+      /** whether it is all in memory, and so goes out through poll_send_generated */
+      bool gathered() const {
+        return body.inUse() || fixedHeader.memory || content.memory;
+      }
+
+      /** bytes still to send, what is in the body ring but not what its producer has yet to make */
+      size_t pending() const {
+        return header.unsent() + fixedHeader.unsent() + (header_only ? 0 : content.unsent() + body.pending());
+      }
 
       void clear();
     } reply;
 
+    /* heap calls made while handling this connection's current request, only nonzero when built with DarklyCountAllocations */
+    uint64_t allocated = 0;
+
     /* epoll event handler for a connection */
     void onEpoll(unsigned epoll_flags) override;
 
@@ -183,17 +306,51 @@ namespace DarkHttpd {
 
     void logOn(DarkLogger *log);
 
-    Connection(Server &parent, int fd); //only called via new in socket acceptor code.
+    Connection(Server &parent); //only called via new in socket acceptor code, when the pool is empty.
+
+    /* take on a freshly accepted socket, a pooled connection is reused this way. */
+    void start(int fd);
 
-    /* forget the past request, and everything parsed from it or generated for it */
-    void clear();
+    /* forget the past request, and everything parsed from it or generated for it. @param keepPipelined is for Request::clear */
+    void clear(bool keepPipelined = false);
 
     void recycle();
 
-    void poll_check_timeout();
+    /** bytes went in or out */
+    void progressed();
+
+    /** this request is over, and perhaps the connection: state becomes DONE and the Server is told, no one has to go looking */
+    void markDone();
+
+    /** bring the Server's pending up to date with what this reply has left to send */
+    void recount();
+
+    /** @returns Ticks by which the current state must have got somewhere, 0 for no deadline */
+    int64_t deadline();
+
+    /** make sure the watchdog will fire no later than deadline() */
+    void rearm();
+
+    /** the watchdog fired, close if the deadline has really passed */
+    void expire();
+
+    /** watches the deadlines on the TimerHeap, no per connection scanning. An entry is only added when the deadline moves earlier than the one pending,
+     * one that finds the deadline has since moved later just re-arms, so a busy connection costs an entry per deadline, not per byte. */
+    struct Watchdog : TimerWaiter {
+      Connection &conn;
+      unsigned ticket = 0;
+      int64_t armedFor = 0; //due of the latest entry, 0 when none is pending
+
+      Watchdog(Connection &conn) : conn{conn} {}
+
+      void onTimer(unsigned ticket) override;
+    } watchdog{*this};
 
     void startHeader(int errcode, const char *errtext);
 
+    /* printf onto the end of the header */
+    void catf(const char *format, ...) checkFargs(2, 3);
+
     void catDate();
 
     void catServer();
@@ -214,6 +371,9 @@ namespace DarkHttpd {
 
     void endHeader();
 
+    /** end the header with @param fixed, pre-rendered through its blank line */
+    void endHeaderWith(const std::string &fixed);
+
     void startReply(int errcode, const char *errtext);
 
     void addFooter();
@@ -222,6 +382,9 @@ namespace DarkHttpd {
 
     void endReply();
 
+    /** one of the pre-rendered errors, no formatting past the status line, Date and keep-alive */
+    void errorPage(ErrorPages::Which which);
+
     void redirect(const char *protocol, const char *hostpart, const char *uripart);
 
     void redirect_https();
@@ -232,23 +395,81 @@ namespace DarkHttpd {
 
     void poll_recv_request();
 
-    int sendRange(Replier::Block &sending);
+    /** act on what has been received: wait for more, refuse it, or answer it. Also for a request that was pipelined behind the last one. */
+    void takeRequest();
+
+    /** send some of @param sending, at most @param most bytes of a file */
+    int sendRange(Replier::Block &sending, off_t most = std::numeric_limits<off_t>::max());
 
     void poll_send_header();
 
     void poll_send_reply();
 
-    void generate_dir_listing(const char *path, const char *decoded_url);
+    void poll_send_generated();
+
+    /** count @param sent against this turn's allowance */
+    void spend(ssize_t sent);
+
+    /** a send came up short: park on the timers if throttled, wait for EPOLLOUT if the socket is full, else go to the back of the SendScheduler's line */
+    void sendLater();
+
+    /** @returns how much of @param wanted the rate limits let us send now, when 0 reply.throttled is set */
+    size_t shaped(size_t wanted);
+
+    /** a throttled reply has tokens again */
+    void onTimer(unsigned ticket) override;
+
+    /** the IoPool has read in the window poll_send_reply was waiting for, or read into the direct buffer */
+    void loaded(unsigned ticket, char *into, ssize_t got) override;
+
+    /** switch content to O_DIRECT sending if a buffer is free and the filesystem allows it */
+    void startDirect();
+
+    void poll_send_direct();
+
+    /** what epoll should wake us for, 0 for nothing */
+    void listenFor(unsigned flags);
+
+    void generate_dir_listing(int dirfd, const char *decoded_url);
+
+    /** try the index names in @param dirfd for @param url (relative, with trailing slash). @returns the cached resolution, null when it made an error reply instead. */
+    IndexCache::Pin resolveIndex(int dirfd, std::string_view url, int64_t now);
+
+    /** send the index file of @param index */
+    void useIndex(const IndexCache::Pin &index);
 
-    void urlDoDirectory();
+    /** listing of @param dirfd, or 404 if listings are disabled */
+    void urlDoDirectory(int dirfd);
+
+    void openFailed();
   }; //end of connection child class
 
   class Server {
     friend Connection; //division of source into Server and Connection was done just to make more clear what is shared/configuration and what is per-request.
+    /** the listening socket's event handler. The Server itself is not an EpollHandler, this was formerly faked with a reinterpret_cast. */
+    struct Acceptor : EpollHandler, TimerWaiter {
+      Server &service;
+      unsigned ticket = 0; //of the retry after running out of fds
+
+      Acceptor(Server &service) : service{service} {}
+
+      void onEpoll(unsigned epoll_flags) override;
+
+      void onTimer(unsigned ticket) override;
+    } acceptor{*this};
+
+    /** the longest the loop sleeps with nothing to do, everything that must happen at a time is on the timers */
+    static constexpr double IdleWakeSecs = 30;
+
+    /** how long to wait before accepting again after EMFILE or ENFILE, when it wasn't one of our connections that had the fds */
+    static constexpr int64_t AcceptRetryMs = 1000;
+
     /** until we use the full signal set ability to pass our object we only allow one DarkHttpd per process.*/
     static Server *forSignals; //epoll will let us eliminate this, it adds a user pointer to the notification structure.
     static void stop_running(int sig);
 
+    static void want_stats(int sig);
+
 #ifdef HAVE_INET6
     bool inet6 = false; /* whether the socket uses inet6 */
 #endif
@@ -260,7 +481,21 @@ namespace DarkHttpd {
     bool want_daemon = false;
 #endif
 
-    int max_connections = -1; /* kern.ipc.somaxconn */
+    int max_connections = -1; /* kern.ipc.somaxconn, and when positive a cap on live connections */
+    unsigned accept_batch = 64; //most connections accepted per wakeup of the listener, the rest wait for the next so that live ones get a turn
+#if DarklySupportLinuxAccept
+    unsigned defer_accept_secs = 0; //TCP_DEFER_ACCEPT, the kernel holds a connection until its request arrives, Linux's accf_http
+    unsigned fastopen_queue = 0; //TCP_FASTOPEN, returning clients send their request with the SYN
+#endif
+    unsigned live = 0; //connections acquired and not yet released
+    uint64_t pending = 0; //bytes replies have left to send, kept up as they send
+
+    /* shrink the kernel send buffer of accepted sockets so that replies go out a few bytes per send, for exercising partial sends. Was the TORTURE compile time option, which now just sets the default. */
+#ifdef TORTURE
+    int torture_sndbuf = 1;
+#else
+    int torture_sndbuf = 0;
+#endif
 
     /* If a connection is idle for timeout_secs or more, it gets closed and
          * removed from the connlist.
@@ -268,6 +503,22 @@ namespace DarkHttpd {
     unsigned timeout_secs = 30;
     bool want_keepalive = true;
 
+    /** limits on the phases of a connection besides --timeout, so that trickling bytes doesn't keep one open forever. 0 disables each. */
+    struct Deadlines {
+      unsigned headerSecs = 20; //--header-timeout, from the first byte of a request (or the accept) to the end of its header
+      unsigned minRecvRate = 100; //--min-recv-rate, bytes per second while receiving a header, after RateGraceSecs
+      unsigned sendSecs = 0; //--send-timeout, from starting to answer a request to the last byte sent
+      static constexpr unsigned RateGraceSecs = 5;
+
+      struct Stats {
+        uint64_t header = 0;
+        uint64_t slow = 0; //under minRecvRate
+        uint64_t idle = 0;
+        uint64_t stalled = 0; //sending made no progress for --timeout
+        uint64_t send = 0;
+      } stats;
+    } deadlines;
+
     /* the number below should be #defined in user build system to something like maximum number of events to handle per millisecond or so */
     Epoller<22> epoller;
 
@@ -290,9 +541,81 @@ namespace DarkHttpd {
 
     bool want_chroot = false;
 
-    const char *index_name = "index.html";
+    const char *index_name = "index.html"; //comma separated, IndexCache splits it
+    IndexCache indexes;
     bool no_listing = false;
 
+    /** every request is opened relative to wwwroot through this, so --chroot is no longer needed to stay inside it */
+    Resolver resolver;
+
+    /** tells whatever caches file information when the files change */
+    FsWatcher watcher;
+
+    /** rendered directory listings */
+    ListingCache listings;
+
+    /** buffers for O_DIRECT sending, declared before io so that its workers are gone before these are freed */
+    DirectPool direct;
+
+    /** reads in file windows that aren't in the page cache */
+    IoPool io;
+
+    /** statx for big directory listings */
+    StatPool statPool;
+
+    /** shares the sending among connections with a lot to send */
+    SendScheduler fair;
+
+    /** egress rate limits */
+    Shaper shaper;
+
+    /** watches for overload and says when to shed it */
+    Overload overload;
+
+    /** for request headers too big for a Connection's own buffer */
+    RequestBuffers requestBuffers;
+
+    /** idle timeout and request limit of keep-alives, by how full we are */
+    KeepAlivePolicy keepAlive;
+
+    KeepAlivePolicy::Terms keepAliveTerms() {
+      return keepAlive.terms(live, timeout_secs);
+    }
+
+    /** close the idle keep-alive that has been idle longest, to make room for a new connection. @returns whether there was one */
+    bool reapIdle();
+
+    /** keep-alives between requests, linked through Connection::idleNewer and idleOlder, the oldest has been idle longest as each goes on the end */
+    Connection *idleOldest = nullptr;
+    Connection *idleNewest = nullptr;
+
+    /** @param conn has answered its request and waits for another */
+    void nowIdle(Connection *conn);
+
+    /** @param conn is no longer idle, if it was: a request started coming in, or it is closing */
+    void notIdle(Connection *conn);
+
+    /** --allow and --deny, checked at accept */
+    AccessList access;
+
+    /** per client address connection and request limits */
+    ClientTable clients;
+
+    /** wakes connections parked by the shaper */
+    TimerHeap timers;
+
+    /** page cache hints per reply */
+    ReadAdvice advice;
+
+    /** paths recently found missing */
+    MissingCache missing;
+
+    /** buffers for generated bodies, shared by all connections */
+    BufferPool buffers;
+
+    /** fixed error pages and the redirect page's pieces, built once the command line is known */
+    ErrorPages errorPages;
+
     DropPrivilege drop_uid{false};
     DropPrivilege drop_gid{true};
 
@@ -303,9 +626,14 @@ namespace DarkHttpd {
     Fd sockin; /* socket to accept connections from */
     bool accepting = true; /* set to 0 to stop accept()ing */
     volatile bool running = false; /* signal handler sets this to false */
+    volatile bool statsWanted = false; /* SIGUSR1 sets this, so that a test harness can sample us while running */
 
-    /** the entries will all be dynamically allocated */
-    std::forward_list<Connection *> connections;
+    /** the entries will all be dynamically allocated, linked through Connection::next and prev */
+    Connection *connections = nullptr;
+    /** those that reached DONE, linked through Connection::nextDone, for httpd_poll to release or ready for their next request */
+    Connection *done = nullptr;
+    /** closed connections kept for reuse, so that a steady stream of connects doesn't churn the heap */
+    Connection *pool = nullptr;
 
     // /* this is now redundant and also stale when compared to the EpollerCore::elapsed */
     // Now now;
@@ -322,7 +650,24 @@ namespace DarkHttpd {
 
     void init_sockin();
 
-    void accept_connection();
+    /** accept one connection. @param acquired is set when it got a Connection, not for one aborted, denied or refused.
+     * @returns whether to try for another, false when the backlog is empty or accepting paused */
+    bool accept_connection(bool &acquired);
+
+    /** a pooled or new connection for @param fd */
+    Connection *acquire(int fd);
+
+    /** close @param conn and return it to the pool */
+    void release(Connection *conn);
+
+    /** stop watching sockin while we can't take more, with @param retry when only a timer will tell us that we can again */
+    void pauseAccepting(bool retry);
+
+    /** watch sockin again, if we are under --maxconn */
+    void resumeAccepting();
+
+    /** statistics and the request log for the request @param conn just finished */
+    void finished(Connection &conn);
 
     // void log_connection(const Connection *conn);
 
@@ -439,6 +784,25 @@ namespace DarkHttpd {
       uint64_t num_requests = 0;
       uint64_t total_in = 0;
       uint64_t total_out = 0;
+      /* cost of the event loop, so that idle connection overhead can be measured */
+      uint64_t wakeups = 0; //epoller.loop returns that had work
+      int64_t dispatchCpu = 0; //ns of cpu spent inside epoller.loop, i.e. handling events
+      int64_t doneCpu = 0; //ns of cpu spent releasing or resetting connections that reached DONE
+      uint64_t doneHandled = 0; //connections taken off the done list
+      uint64_t pooled = 0; //accepts that reused a pooled Connection
+      uint64_t acceptPauses = 0; //times sockin was unwatched for --maxconn or lack of fds
+      uint64_t accepted = 0;
+      uint64_t acceptWakeups = 0;
+      uint64_t acceptBatches[5] = {}; //wakeups that accepted 0-1, 2-3, 4-7, 8-15 and 16 or more
+      unsigned acceptBatchMost = 0;
+
+      /* heap use per reply path, all zero unless built with DarklyCountAllocations */
+      struct Allocations {
+        uint64_t requests = 0;
+        uint64_t calls = 0;
+      } allocations[Connection::Replier::KindCount];
+
+      uint64_t acceptAllocations = 0; //heap calls in accepting, before any request is read.
     } fyi;
 
   public:
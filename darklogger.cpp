@@ -9,19 +9,22 @@
 
 bool DarkLogger::begin() {
   if (file_name == nullptr) {
-    os = &std::cout;
+    file = stdout;
   } else {
-    fstream.open(file_name);
-    if (!fstream) {
+    file = fopen(file_name, "a");
+    if (!file) {
       DarkHttpd::err(1, "opening logfile: fopen(\"%s\")", file_name);
       return false;
     }
-    os = &fstream;
   }
   return true;
 }
 
 void DarkLogger::close() {
-  fstream.flush();
-  fstream.close();
+  if (file && file != stdout) {
+    fclose(file);
+  } else if (file) {
+    fflush(file);
+  }
+  file = nullptr;
 }
@@ -4,23 +4,26 @@
 */
 
 #pragma once
+#include <concepts>
 #include <cstdio>
-#include <fstream>
-#include <iomanip>
-#include <iostream>
 #include <sys/syslog.h>
+#include <type_traits>
 
 #include "now.h"
 
 struct DarkLogger {
   bool syslog_enabled = false;
   char *file_name = nullptr; /* NULL = no logging */
-  // FILE *file = nullptr;
-  std::ofstream fstream;
-  std::ostream *os = &std::cout;
+  /* stdio rather than iostreams: its buffer is allocated once when the file is opened, formatting a line doesn't touch the heap. */
+  FILE *file = stdout;
 
   bool operator !() const {
-    return !os;
+    return !file;
+  }
+
+  /** whether someone asked for a request log */
+  bool wanted() const {
+    return file_name || syslog_enabled;
   }
 
   /* open the file, perhaps emit a line to make it easy to find start and stop times */
@@ -31,7 +34,7 @@ struct DarkLogger {
 
 /** attempts to have out of line non template put members got tedious as the compiler tries way too hard to find variations to pick from and has no syntax for coercing priority. */
   template<typename Scalar> void put(Scalar item) {
-    if constexpr (std::is_convertible<Scalar,time_t>::value) {
+    if constexpr (std::same_as<Scalar, time_t>) {
 #define CLF_DATE_LEN 29 /* strlen("[10/Oct/2000:13:55:36 -0700]")+1 */
       char dest[CLF_DATE_LEN];
       tm tm;
@@ -45,12 +48,20 @@ struct DarkLogger {
       // put<time_t>(item);
     } else if constexpr (std::same_as<StringView, Scalar>) {
       if (syslog_enabled) {
-        syslog(LOG_INFO, "%*s", int(item.length), item.begin());
+        syslog(LOG_INFO, "%.*s", int(item.length), item.begin());
+      } else if (item.notTrivial()) {
+        fwrite(item.begin(), item.length, 1, file);
       } else {
-        *os << std::setw(item.length) << item.begin();
+        fputc('-', file); //CLF's placeholder for an absent field
       }
+    } else if constexpr (std::is_convertible_v<Scalar, const char *>) {
+      fputs(item ? item : "-", file);
+    } else if constexpr (std::same_as<Scalar, char>) {
+      fputc(item, file);
+    } else if constexpr (std::is_floating_point_v<Scalar>) {
+      fprintf(file, "%.3f", item);
     } else {
-      *os << item;
+      fprintf(file, "%lld", static_cast<long long>(item)); //integers and enums
     }
   }
 
@@ -0,0 +1,65 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+#include "directio.h"
+
+#include "fswatch.h"
+
+#include <cstdlib>
+
+using namespace DarkHttpd;
+
+bool DirectPool::wants(std::string_view relative, off_t size) const {
+  if (!count) {
+    return false;
+  }
+  if (above && size >= above) {
+    return true;
+  }
+  for (auto &prefix: prefixes) {
+    if (FsWatcher::covers(prefix, relative)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+char *DirectPool::take() {
+  if (!idle.empty()) {
+    auto buffer = idle.back();
+    idle.pop_back();
+    return buffer;
+  }
+  if (all.size() >= count) {
+    return nullptr;
+  }
+  bufferSize = (bufferSize + Align - 1) & ~(Align - 1);
+  auto buffer = static_cast<char *>(aligned_alloc(Align, bufferSize));
+  if (buffer) {
+    all.push_back(buffer);
+  }
+  return buffer;
+}
+
+void DirectPool::give(char *buffer) {
+  idle.push_back(buffer);
+}
+
+void DirectPool::addPrefix(const char *prefix) {
+  std::string_view trimmed(prefix);
+  while (trimmed.starts_with('/')) {
+    trimmed.remove_prefix(1);
+  }
+  while (trimmed.ends_with('/')) {
+    trimmed.remove_suffix(1);
+  }
+  prefixes.emplace_back(trimmed);
+}
+
+DirectPool::~DirectPool() {
+  for (auto buffer: all) {
+    free(buffer);
+  }
+}
@@ -0,0 +1,51 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <sys/types.h>
+#include <vector>
+
+namespace DarkHttpd {
+  /** the opt in path for archive files: read with O_DIRECT on an IoPool worker into one of a few aligned buffers, and send from that,
+   * so that a rarely fetched multi-GB file doesn't push the site's hot files out of the page cache.
+   * Memory is bounded by count * bufferSize, a reply that finds them all in use is sent through the page cache as before.
+   */
+  class DirectPool {
+    std::vector<char *> idle;
+    std::vector<char *> all; //freed at exit, including any a worker still had
+
+  public:
+    /** O_DIRECT wants offsets, lengths and the buffer aligned to the logical block size, this covers every device we'll meet */
+    static constexpr size_t Align = 4096;
+
+    off_t above = 0; //--direct-above, files at least this large, 0 for none
+    std::vector<std::string> prefixes; //--direct-path, relative to wwwroot, without leading slash
+    unsigned count = 8; //--direct-buffers
+    size_t bufferSize = 1 << 20; //--direct-buffer-size, rounded up to Align
+
+    struct Stats {
+      uint64_t replies = 0;
+      uint64_t fallbacks = 0; //wanted direct but no buffer was free, or the filesystem refused O_DIRECT
+      uint64_t bytes = 0; //read with O_DIRECT
+    } stats;
+
+    /** whether @param relative (to wwwroot) of @param size should bypass the page cache */
+    bool wants(std::string_view relative, off_t size) const;
+
+    /** @returns an aligned buffer of bufferSize, null if count are already out */
+    char *take();
+
+    void give(char *buffer);
+
+    /** from cli, adds a prefix */
+    void addPrefix(const char *prefix);
+
+    ~DirectPool();
+  };
+}
@@ -1,4 +1,3 @@
-
 /**
 // Created by andyh on 1/23/25.
 // Copyright (c) 2025 Andy Heilveil, (github/980f). All rights reserved.
@@ -6,36 +5,140 @@
 
 #include "directorylisting.h"
 
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
-bool DirectoryListing::operator()(const char *path, bool includeHidden) {
-  DIRwrapper dir;
-  if (!dir(path)) {
-    return false;
+/** what getdents64 fills its buffer with, glibc only declares it for some versions */
+struct linux_dirent64 {
+  ino64_t d_ino;
+  off64_t d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+  char d_name[];
+};
+
+static uint64_t prefixOf(const char *name) {
+  uint64_t prefix = 0;
+  for (unsigned i = 0; i < sizeof(prefix); ++i) {
+    prefix <<= 8;
+    if (*name) {
+      prefix |= static_cast<unsigned char>(*name++);
+    }
   }
+  return prefix;
+}
+
+DirectoryListing::~DirectoryListing() {
+  if (listing != -1) {
+    ::close(listing);
+  }
+}
 
-  dir.foreach([&](dirent *ent, const char *dirpath) {
-    char currname[FILENAME_MAX]; //workspace for extended path.
+bool DirectoryListing::open(int dirfd) {
+  listing = openat(dirfd, ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC); //a fresh open rather than dup, dirfd may be O_PATH and we want our own offset.
+  return listing != -1;
+}
 
+bool DirectoryListing::readBatch(bool includeHidden, std::string_view prefix) {
+  alignas(linux_dirent64) char batch[64 * 1024]; //a few hundred names per syscall, where readdir's buffer is sized for a handful.
+  auto got = syscall(SYS_getdents64, listing, batch, sizeof(batch));
+  if (got <= 0) {
+    if (got == 0) {
+      errno = 0;
+    }
+    return false;
+  }
+  for (long offset = 0; offset < got;) {
+    auto ent = reinterpret_cast<linux_dirent64 *>(batch + offset);
+    offset += ent->d_reclen;
     if (ent->d_name[0] == '.') {
-      if (ent->d_name[1] == 0 || ent->d_name[1] == '.' || !includeHidden) {
-        return; /* skip "." and ".." */
+      if (ent->d_name[1] == 0 || (ent->d_name[1] == '.' && ent->d_name[2] == 0) || !includeHidden) {
+        continue; /* skip "." and ".." */ //was skipping every name starting with "..", even with includeHidden
       }
     }
+    if (!std::string_view(ent->d_name).starts_with(prefix)) {
+      continue;
+    }
+    Entry entry;
+    entry.prefix = prefixOf(ent->d_name);
+    entry.name = names.size();
+    entry.is_dir = ent->d_type == DT_DIR;
+    entry.statted = ent->d_type != DT_UNKNOWN && ent->d_type != DT_LNK; //only as far as is_dir goes, symlinks are statted to find that out.
+    names.insert(names.end(), ent->d_name, ent->d_name + strlen(ent->d_name) + 1);
+    ing.push_back(entry);
+  }
+  return true;
+}
 
-    snprintf(currname, sizeof currname, "%s%s", dirpath, ent->d_name); //we only call this routine if we saw a '/' at the end of the path, so we don't add one here.
-    struct stat s;
-    if (stat(currname, &s) == -1) {
-      return; /* skip un-stat-able files */
+void DirectoryListing::stat(size_t first, size_t pastEnd, bool typesOnly) {
+  pastEnd = std::min(pastEnd, ing.size());
+  //statx is relative to the directory, no path building nor rewalking. DONT_SYNC takes what the client already knows, where NFS would otherwise revalidate every entry.
+  for (size_t which = first; which < pastEnd; ++which) {
+    auto &entry = ing[which];
+    if (typesOnly && entry.statted) {
+      continue; //d_type already told us
     }
-    auto repack = new dlent(); //#freed in DirectoryListing destructor
-    repack->name = strdup(ent->d_name); //if we run out of heap we get mullpointer, we don't want to kill the whole app when that happens but might want to stop the listing process.
-    repack->is_dir = S_ISDIR(s.st_mode);
-    repack->size = s.st_size;
-    repack->mtime = s.st_mtim;
-    ing.push_front(repack);
+    struct statx s;
+    if (statx(listing, nameOf(entry), AT_STATX_DONT_SYNC | (followSymlinks ? 0 : AT_SYMLINK_NOFOLLOW), typesOnly ? STATX_TYPE : STATX_TYPE | STATX_SIZE | STATX_MTIME, &s) == -1) {
+      entry.missing = true; /* skip un-stat-able files */
+      continue;
+    }
+    entry.statted = true;
+    entry.is_dir = S_ISDIR(s.stx_mode);
+    if (!typesOnly) {
+      entry.size = s.stx_size;
+      entry.mtime = {static_cast<time_t>(s.stx_mtime.tv_sec), static_cast<long>(s.stx_mtime.tv_nsec)};
+    }
+  }
+}
+
+void DirectoryListing::dropMissing() {
+  std::erase_if(ing, [](const Entry &entry) {
+    return entry.missing;
   });
+}
+
+void DirectoryListing::sort(Order order, bool descending) {
+  if (order == Unsorted) {
+    return;
+  }
+  auto byName = [this](const Entry &a, const Entry &b) {
+    if (a.prefix != b.prefix) {
+      return a.prefix < b.prefix;
+    }
+    return strcmp(nameOf(a), nameOf(b)) < 0; //same byte order as the prefix compare
+  };
+  std::sort(ing.begin(), ing.end(), byName);
+  if (order == ByMtime) {
+    std::stable_sort(ing.begin(), ing.end(), [](const Entry &a, const Entry &b) {
+      return a.mtime.tv_sec != b.mtime.tv_sec ? a.mtime.tv_sec < b.mtime.tv_sec : a.mtime.tv_nsec < b.mtime.tv_nsec;
+    });
+  } else if (order == BySize) {
+    std::stable_sort(ing.begin(), ing.end(), [](const Entry &a, const Entry &b) {
+      return a.size < b.size;
+    });
+  }
+  if (descending) {
+    std::reverse(ing.begin(), ing.end());
+  }
+}
 
-  ing.sort(dlent::sortOnName);
+bool DirectoryListing::operator()(int dirfd, bool includeHidden, bool typesOnly) {
+  if (!open(dirfd)) {
+    return false;
+  }
+  while (readBatch(includeHidden, {})) {}
+  if (errno) {
+    return false;
+  }
+  stat(0, ing.size(), typesOnly);
+  dropMissing();
+  sort(ByName);
   return true;
 }
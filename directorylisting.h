@@ -1,76 +1,80 @@
-
 /**
 // Created by andyh on 1/23/25.
 // Copyright (c) 2025 Andy Heilveil, (github/980f). All rights reserved.
 */
 
 #pragma once
-#include <cstdio>
-#include <cstring>
-#include <dirent.h>
-#include <forward_list>
-#include <functional>
-
-/** manage lifetime of libc directory lister, can live outside this namespace */
-  struct DIRwrapper {
-    DIR *raw;
-    const char *path = nullptr;
+#include <cstdint>
+#include <ctime>
+#include <string_view>
+#include <vector>
+
+/* listing mechanism, a reworking of what stat returns for a name.
+ * Names are read with getdents64 in large batches relative to the directory fd and kept in one arena, entries in one contiguous vector.
+ * Large directories have their statx calls handed to the server's StatPool by the listing, which is what matters on NFS where each one is a round trip.
+ * The phases are public so that a streamed listing can take the directory a batch at a time, or stat only the page it is sending.
+ */
+class DirectoryListing {
+public:
+  struct Entry {
+    uint64_t prefix = 0; //first bytes of the name, big endian, so that most sort compares don't touch the arena.
+    uint32_t name = 0; //offset into the arena
+    bool is_dir = false; /* If the entry is a directory and not a file. */
+    bool missing = false; //stat failed, it went away or we may not look at it
+    bool statted = false;
+    uint64_t size = 0; /* The size of the entry, in bytes.            */
+    timespec mtime{0, 0}; /* When the file was last modified.            */
+  };
 
-    ~DIRwrapper() {
-      closedir(raw);
-    }
+  enum Order {
+    ByName = 0,
+    ByMtime,
+    BySize,
+    Unsorted //directory order, which lets a listing be sent as it is read
+  };
 
-    bool operator ()(const char *path) {
-      raw = opendir(path);
-      return raw != nullptr;
-    }
+  /** beyond this many entries the stat calls are worth handing to other threads */
+  static constexpr size_t ParallelAbove = 2048;
 
-    dirent *next() {
-      return readdir(raw);
-    }
+private:
+  int listing = -1; //our own open of the directory, for its read offset
+  std::vector<char> names; //NUL terminated, back to back
 
-    void foreach(std::function<void(dirent *, const char *)> body) {
-      while (auto entry = next()) {
-        body(entry, path);
-      }
-    }
-  };
+public:
+  std::vector<Entry> ing; //this name will make sense at point of use.
+  bool followSymlinks = false; //stat what links point to, only when the server will follow them anywhere, else a listing would show what lies outside wwwroot
 
-  /* listing mechanism, a reworking of what stat returns for a name */
-  class DirectoryListing {
-    struct dlent {
-      char *name = nullptr; /* The strdup'd name/path of the entry.       */
-      bool is_dir = false; /* If the entry is a directory and not a file. */
-      size_t size = 0; /* The size of the entry, in bytes.            */
-      timespec mtime; /* When the file was last modified.            */
+  ~DirectoryListing();
 
-      dlent(): mtime{0, 0} {}
+  const char *nameOf(const Entry &entry) const {
+    return &names[entry.name];
+  }
 
-      ~dlent() {
-        free(name);
-      }
+  /** start reading the directory open as @param dirfd, which remains the caller's. @returns false with errno set. */
+  bool open(int dirfd);
 
-      static int sortOnName(dlent *a, dlent *b) {
-        return strcmp(a->name, b->name);
-      }
+  /** append one getdents64 batch of names to ing, leaving out hidden ones unless @param includeHidden and those not starting with @param prefix.
+   * @returns false at the end of the directory, with errno set if that was an error rather than the end. */
+  bool readBatch(bool includeHidden, std::string_view prefix);
 
-      //can add other standard sorts here.
-    };
+  /** fill in what stat says for ing[first..pastEnd), marking those that failed as missing. Threads may each take a separate range of the same listing.
+   * @param typesOnly is for when only is_dir is wanted, the d_type from the directory suffices for most file systems. */
+  void stat(size_t first, size_t pastEnd, bool typesOnly = false);
 
-  public:
-    std::forward_list<dlent *> ing; //this name will make sense at point of use.
+  /** drop the entries whose stat failed */
+  void dropMissing();
 
-    ~DirectoryListing() {
-      for (auto dlent: ing) {
-        delete(dlent);
-      }
-      ing.clear();
-    }
+  /** ByMtime and BySize need the entries statted, ties keep name order. */
+  void sort(Order order, bool descending = false);
 
-  public:
+  /** forget the entries, keeping the memory for the next batch */
+  void clear() {
+    ing.clear();
+    names.clear();
+  }
 
-    /* Make sorted list of files in a directory.  Returns number of entries, or -1
-     * if error occurs.
-     */
-    bool operator()(const char *path, bool includeHidden);
-  };
+  /* Make sorted list of files in the directory open as @param dirfd.
+   * @returns false with errno set if it couldn't be read.
+   */
+  bool operator()(int dirfd, bool includeHidden, bool typesOnly = false);
+};
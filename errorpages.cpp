@@ -0,0 +1,92 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+#include "errorpages.h"
+
+using namespace DarkHttpd;
+
+static const struct {
+  int code;
+  const char *name;
+  const char *detail;
+  unsigned retryAfter = 0; //seconds, for a Retry-After header
+} catalog[ErrorPages::WhichCount] = {
+  {400, "Bad Request", "You requested an invalid URL."},
+  {400, "Bad Request", "Missing 'Host' header."},
+  {431, "Request Header Fields Too Large", "Your request header was too long."},
+  {414, "URI Too Long", "The URL you requested was too long."},
+  {413, "Content Too Large", "Your request has a body larger than this server accepts."},
+  {400, "Bad Request", "You sent a request that the server couldn't understand."},
+  {401, "Unauthorized", "Access denied due to invalid credentials."},
+  {403, "Forbidden", "You don't have permission to access this URL."},
+  {403, "Forbidden", "The URL you requested is not served from here."},
+  {403, "Forbidden", "Not a regular file."},
+  {404, "Not Found", "The URL you requested was not found."},
+  {416, "Requested Range Not Satisfiable", "You requested an invalid range or a range outside of the file or the file is not normal."},
+  {429, "Too Many Requests", "You have too many connections or are making requests too quickly, please slow down.", 1},
+  {501, "Not Implemented", "The method you specified is not implemented."},
+  {503, "Service Unavailable", "The server is overloaded, please try again shortly.", 5},
+};
+
+/* same markup as Connection::startReply, the catalog text has nothing that needs escaping */
+static std::string heading(int code, const char *name) {
+  return "<!DOCTYPE html><html><head><title>" + std::to_string(code) + ' ' + name + "</title></head><body>\n<h1>" + name + "</h1>\n";
+}
+
+void ErrorPages::render(const char *serverId, const std::vector<const char *> &custom, const char *authenticate) {
+  //the per request Date is in the page header, the footer doesn't repeat it so that it can be fixed.
+  std::string footer = "<hr>\n";
+  if (serverId) {
+    footer += "Generated by ";
+    footer += serverId;
+    footer += '\n';
+  }
+  footer += "</body></html>\n";
+
+  std::string common;
+  if (serverId) {
+    common += "Server: ";
+    common += serverId;
+    common += "\r\n";
+  }
+  std::string customs;
+  for (auto line: custom) {
+    customs += line;
+    customs += "\r\n";
+  }
+  static const char html[] = "Content-Type: text/html; charset=UTF-8\r\n";
+
+  for (unsigned which = 0; which < WhichCount; ++which) {
+    auto &page = pages[which];
+    auto &entry = catalog[which];
+    page.code = entry.code;
+    page.name = entry.name;
+    page.body = heading(entry.code, entry.name);
+    page.body += entry.detail;
+    page.body += '\n';
+    page.body += footer;
+
+    page.headers = common;
+    page.headers += "Accept-Ranges: bytes\r\n";
+    page.headers += customs;
+    page.headers += "Content-Length: " + std::to_string(page.body.size()) + "\r\n";
+    page.headers += html;
+    if (entry.code == 401 && authenticate) {
+      page.headers += authenticate;
+      page.headers += "\r\n";
+    }
+    if (entry.retryAfter) {
+      page.headers += "Retry-After: " + std::to_string(entry.retryAfter) + "\r\n";
+    }
+    page.headers += "\r\n";
+  }
+
+  auto &tooMany = pages[TooManyRequests];
+  refusal = "HTTP/1.1 429 Too Many Requests\r\nConnection: close\r\n" + tooMany.headers + tooMany.body; //no Date, it is fixed
+
+  redirect.headers = common + customs + html + "\r\n";
+  redirect.lead = heading(301, "Moved Permanently") + "Moved to: <a href=\"";
+  redirect.trail = "</a>\n" + footer;
+}
@@ -0,0 +1,62 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace DarkHttpd {
+  /** the error replies whose text never varies, rendered once at startup so that a storm of 404's costs a sendmsg each and no formatting.
+   * Only the status line, Date and the keep-alive decision are per request, the connection puts those in front of the template. */
+  class ErrorPages {
+  public:
+    enum Which {
+      BadUrl = 0,
+      MissingHost,
+      HeaderTooLong,
+      UriTooLong,
+      ContentTooLarge,
+      Garbled,
+      Unauthorized,
+      Forbidden,
+      NotServedHere,
+      NotRegular,
+      NotFound,
+      BadRange,
+      TooManyRequests,
+      NotImplemented,
+      Unavailable,
+      WhichCount
+    };
+
+    struct Page {
+      int code = 0;
+      const char *name = nullptr; //reason phrase
+      std::string headers; //everything after the per request lines, through the blank line that ends the header.
+      std::string body;
+    };
+
+    /** pieces of the 301 page, the target is escaped into the body between them */
+    struct Redirect {
+      std::string headers; //as for Page, but Content-Length comes with the per request lines
+      std::string lead; //through the opening of the href
+      std::string trail; //from the end of the link through the footer
+    } redirect;
+
+    /** a whole 429 response, for connections refused at accept, which are closed without reading their request, so it can't depend on it */
+    std::string refusal;
+
+    /** build all the templates, @param serverId is the Server: and footer name, null when --no-server-id. @param custom are --header lines, without line ends. @param authenticate is added to the 401 when not null. */
+    void render(const char *serverId, const std::vector<const char *> &custom, const char *authenticate);
+
+    const Page &operator[](Which which) const {
+      return pages[which];
+    }
+
+  private:
+    Page pages[WhichCount];
+  };
+}
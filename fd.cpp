@@ -33,21 +33,25 @@ int Fd::operator=(FILE *fopened) {
 FILE *Fd::createTemp(const char *format) {
   strncpy(tmpname, format, sizeof(tmpname));
   *this = mkstemp(tmpname);
+  if (seemsOk()) {
+    ::unlink(tmpname); //we only ever use it through fd, this keeps them from piling up in the working directory.
+  }
   return getStream();
 }
 
 bool Fd::close() {
   if (seemsOk()) {
-    int fi = ::close(fd);
+    int fi = stream ? fclose(stream) : ::close(fd);
     fd = -1;
-    return fi != -1;
+    stream = nullptr;
+    return fi == 0;
   }
   return true; // already closed is same as just now successfully closed.
 }
 
 size_t Fd::vprintln(const char *format, va_list va) {
   FILE *stream = getStream();
-  auto added = fprintf(stream, format, va);
+  auto added = vfprintf(stream, format, va); //was fprintf, which took the va_list for the first argument
   fputc('\n', stream);
   return ++added;
 }
@@ -73,6 +77,9 @@ off_t Fd::getLength() {
 }
 
 long int Fd::getPosition() {
+  if (stream) {
+    fflush(stream); //else what printf put in the stream buffer is not counted
+  }
   return lseek (fd, 0, SEEK_CUR);
 }
 
@@ -81,7 +88,7 @@ bool Fd::isDir() {
 }
 
 bool Fd::isRegularFile() {
-  return !S_ISREG(filestat.st_mode);
+  return S_ISREG(filestat.st_mode); //was inverted, which refused every regular file.
 }
 
 size_t Fd::printf(const char *format, ...) {
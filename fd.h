@@ -31,7 +31,7 @@ namespace DarkHttpd {
     }
 
     FILE *stream = nullptr;
-    //this is the filename after createTemp is called, and it lingers after the file is closed. TODO: this doesn't actually work. We will need to keep the file open when passing it to sendfile.
+    //this is the filename createTemp made, it is unlinked at once as we keep the file open until it has been sent.
     char tmpname[L_tmpnam];
 
   public:
@@ -40,7 +40,7 @@ namespace DarkHttpd {
         return nullptr; //todo: or perhaps spew to stderr?? This will likely segv.
       }
       if (stream == nullptr) {
-        stream = fdopen(fd, "rwb"); //using b as we must use network line endings, not the platform's idea of them
+        stream = fdopen(fd, "r+b"); //using b as we must use network line endings, not the platform's idea of them. "rwb" was read only to glibc.
       }
       return stream;
     }
@@ -72,7 +72,7 @@ namespace DarkHttpd {
       return fd != -1;
     }
 
-    /** @returns whether close() thinks it worked , but we discard our fd value regardless of that */
+    /** @returns whether close() thinks it worked , but we discard our fd value regardless of that. Closes the stream if we made one, which would otherwise leak its buffer. */
     bool close();
 
     /** lose track of the fd regardless of the associated file's state. Most uses seem like bugs, potential leaks of OS file handles eventually exhausting them.*/
@@ -0,0 +1,158 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+#include "fswatch.h"
+
+#include "darkerror.h"
+
+#include <cerrno>
+#include <climits>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+using namespace DarkHttpd;
+
+/* content changes, metadata changes, and names coming and going. IN_ONLYDIR as we only ever watch directories. */
+static constexpr uint32_t WatchMask = IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+
+int FsWatcher::begin(const char *wwwroot) {
+  root = wwwroot;
+  if (!enabled) {
+    return -1;
+  }
+  notifier = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (!notifier.seemsOk()) {
+    warn("inotify_init1, caches will revalidate every %u ms", revalidateMs);
+    enabled = false;
+    return -1;
+  }
+  return notifier;
+}
+
+void FsWatcher::finish() {
+  notifier.close(); //releases all the watches
+  byPath.clear();
+  byWatch.clear();
+  stats.watches = 0;
+}
+
+bool FsWatcher::cover(std::string_view relative) {
+  if (!enabled) {
+    return false;
+  }
+  if (byPath.find(relative) != byPath.end()) {
+    return true;
+  }
+  if (exhausted) {
+    return false;
+  }
+  std::string path = root;
+  if (!relative.empty()) {
+    path += '/';
+    path += relative;
+  }
+  int wd = inotify_add_watch(notifier, path.c_str(), WatchMask);
+  if (wd == -1) {
+    if (errno == ENOSPC) {
+      exhausted = true;
+    }
+    if (errno != ENOENT && errno != ENOTDIR) { //coverNearest probes for those
+      ++stats.refused;
+    }
+    return false;
+  }
+  auto known = byWatch.find(wd);
+  if (known != byWatch.end()) { //same directory by another name, e.g. through a symlink. Keep the first name, events are reported against it.
+    byPath.emplace(relative, wd);
+    return true;
+  }
+  byPath.emplace(relative, wd);
+  byWatch.emplace(wd, relative);
+  ++stats.watches;
+  return true;
+}
+
+bool FsWatcher::coverNearest(std::string_view relative) {
+  if (!enabled) {
+    return false;
+  }
+  while (!relative.empty()) {
+    relative = directoryOf(relative);
+    if (cover(relative)) {
+      return true;
+    }
+    if (errno != ENOENT && errno != ENOTDIR) {
+      return false; //can't be helped by going up, e.g. out of watches
+    }
+  }
+  return false;
+}
+
+void FsWatcher::deliver(std::string_view path, bool andBelow) {
+  for (auto cache: caches) {
+    cache->invalidate(path, andBelow);
+    ++stats.invalidations;
+  }
+}
+
+void FsWatcher::deliverAll() {
+  for (auto cache: caches) {
+    cache->invalidateAll();
+    ++stats.invalidations;
+  }
+}
+
+void FsWatcher::onEpoll(unsigned epoll_flags unused) {
+  alignas(inotify_event) char events[16 * (sizeof(inotify_event) + NAME_MAX + 1)];
+  while (true) {
+    auto got = read(notifier, events, sizeof(events));
+    if (got <= 0) {
+      return; //EAGAIN, we have drained it
+    }
+    for (char *cursor = events; cursor < events + got;) {
+      auto event = reinterpret_cast<inotify_event *>(cursor);
+      cursor += sizeof(inotify_event) + event->len;
+      ++stats.events;
+      if (event->mask & IN_Q_OVERFLOW) {
+        ++stats.overflows;
+        deliverAll();
+        continue;
+      }
+      auto watched = byWatch.find(event->wd);
+      if (watched == byWatch.end()) {
+        continue; //already forgotten
+      }
+      std::string_view directory = watched->second;
+      if (event->mask & IN_IGNORED) { //watch went away, with its directory or because we removed it
+        std::erase_if(byPath, [wd = event->wd](const auto &each) {
+          return each.second == wd;
+        });
+        byWatch.erase(watched);
+        --stats.watches;
+        exhausted = false; //there is room for another
+        continue;
+      }
+      if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) {
+        deliver(directory, true);
+        continue;
+      }
+      if (!event->len) {
+        deliver(directory, false); //attributes of the directory itself
+        continue;
+      }
+      char child[PATH_MAX];
+      int length = directory.empty() ? snprintf(child, sizeof(child), "%s", event->name) : snprintf(child, sizeof(child), "%.*s/%s", int(directory.size()), directory.data(), event->name);
+      if (length < 0 || size_t(length) >= sizeof(child)) {
+        deliver(directory, true); //can't name it, be generous
+        continue;
+      }
+      //a directory changing, or anything coming or going, can take a whole subtree with it. A file's content or attributes are only its own, e.g. a log being appended to.
+      deliver(std::string_view(child, length), (event->mask & (IN_ISDIR | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO)) != 0);
+      if (event->mask & (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO)) {
+        deliver(directory, false); //listing and index decisions for the directory itself
+      }
+    }
+  }
+}
@@ -0,0 +1,94 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+#pragma once
+
+#include "fd.h"
+#include "stringhash.h"
+#include "stringview.h"
+
+#include "epoller.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace DarkHttpd {
+  /** anything that remembers things about files under wwwroot, and so must forget them when they change */
+  struct FsCache {
+    /** forget what is known about @param path (relative to wwwroot, no leading slash, "" is wwwroot itself), and if @param andBelow about everything under it too. */
+    virtual void invalidate(std::string_view path, bool andBelow) = 0;
+
+    /** forget everything, events were lost */
+    virtual void invalidateAll() = 0;
+
+    virtual ~FsCache() = default;
+  };
+
+  /** inotify watches on the directories we have served from, added lazily as caches ask for them, with events delivered through the server's Epoller.
+   * Where the kernel won't give us another watch (fs.inotify.max_user_watches) caches are told to fall back to revalidating after a TTL.
+   */
+  class FsWatcher : public EpollHandler {
+    Fd notifier;
+    std::string root; //wwwroot as a path, inotify won't take a dirfd
+
+    StringMap<int> byPath;
+    std::unordered_map<int, std::string> byWatch;
+    std::vector<FsCache *> caches;
+    bool exhausted = false; //the kernel refused a watch, don't ask again until one is released
+
+    void deliver(std::string_view path, bool andBelow);
+
+    void deliverAll();
+
+  public:
+    bool enabled = true; //--no-watch clears this, everything then runs on the TTL
+    unsigned revalidateMs = 2000; //how long to trust an unwatched cache entry, --revalidate
+
+    struct Stats {
+      uint64_t watches = 0; //currently held
+      uint64_t refused = 0; //add_watch failures, mostly the user watch limit
+      uint64_t events = 0;
+      uint64_t invalidations = 0; //cache invalidate calls made on behalf of events
+      uint64_t overflows = 0; //event queue overflows, each of which flushed every cache
+    } stats;
+
+    /** start watching, @returns the inotify fd for the caller to give to its Epoller, -1 if disabled or unavailable. */
+    int begin(const char *wwwroot);
+
+    void finish();
+
+    /** @param cache will get invalidations from now on */
+    void subscribe(FsCache &cache) {
+      caches.push_back(&cache);
+    }
+
+    /** make sure changes in directory @param relative (no leading or trailing slash, "" for wwwroot) will be delivered.
+     * @returns whether they will, else the caller should only trust what it caches for revalidateMs. Costs a hash lookup once the directory is watched. */
+    bool cover(std::string_view relative);
+
+    /** cover the nearest existing directory at or above the directory of @param relative, for caches of things that don't exist.
+     * Creating the missing path's first missing component is then an event in a watched directory. */
+    bool coverNearest(std::string_view relative);
+
+    /** whether @param path is @param prefix or is under it */
+    static bool covers(std::string_view prefix, std::string_view path) {
+      if (prefix.empty()) {
+        return true; //wwwroot is above everything
+      }
+      return path.starts_with(prefix) && (path.size() == prefix.size() || path[prefix.size()] == '/');
+    }
+
+    /** the directory part of a relative path, "" for things in wwwroot itself */
+    static std::string_view directoryOf(std::string_view path) {
+      auto slash = path.rfind('/');
+      return slash == std::string_view::npos ? std::string_view() : path.substr(0, slash);
+    }
+
+    /** inotify events are ready */
+    void onEpoll(unsigned epoll_flags) override;
+  };
+}
@@ -1,7 +1,101 @@
-
 /**
 // Created by andyh on 1/23/25.
 // Copyright (c) 2025 Andy Heilveil, (github/980f). All rights reserved.
 */
 
 #include "htmldirlister.h"
+
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+using DarkHttpd::BodySink;
+
+void HtmlDirLister::append_escaped(BodySink &dst, const char *src) {
+  while (*src) {
+    auto plain = strcspn(src, "<>&'\""); //runs of ordinary text go in one piece
+    dst.append(src, plain);
+    src += plain;
+    switch (*src++) {
+      case '<':
+        dst += "&lt;";
+        break;
+      case '>':
+        dst += "&gt;";
+        break;
+      case '&':
+        dst += "&amp;";
+        break;
+      case '\'':
+        dst += "&apos;";
+        break;
+      case '"':
+        dst += "&quot;";
+        break;
+      default: //the terminator
+        return;
+    }
+  }
+}
+
+void HtmlDirLister::htmlencode(BodySink &dst, const char *src) {
+  static const char hex[] = "0123456789ABCDEF";
+
+  while (*src) {
+    auto plain = src;
+    while (is_unreserved(*plain)) {
+      ++plain;
+    }
+    dst.append(src, plain - src);
+    src = plain;
+    if (unsigned char c = *src) { //unsigned, else utf-8 bytes indexed hex[] with a negative number
+      char escaped[3] = {'%', hex[c >> 4], hex[c & 0xF]};
+      dst.append(escaped, 3);
+      ++src;
+    }
+  }
+}
+
+void HtmlDirLister::head(BodySink &html, const char *decoded_url) {
+  html += "<!DOCTYPE html>\n<html>\n<head>\n<title>";
+  append_escaped(html, decoded_url);
+  html += "</title>\n"
+    "<meta name=\"viewport\" content=\"width=device-width, initial-scale=1\">\n"
+    "</head>\n<body>\n<h1>";
+  append_escaped(html, decoded_url);
+  html += "</h1>\n<table border=\"0\">\n";
+}
+
+void HtmlDirLister::row(BodySink &html, const char *name, const DirectoryListing::Entry &entry) {
+  /** The time formatting that we use in directory listings.
+   * An example of the default is 2013-09-09 13:01, which should be compatible with xbmc/kodi. */
+  static const char *const DIR_LIST_MTIME_FORMAT = "%Y-%m-%d %R";
+  static const unsigned DIR_LIST_MTIME_SIZE = 16 + 1; /* How large the buffer will need to be. */
+
+  html += "<tr><td><a href=\""; //was "<tr>td>"
+  htmlencode(html, name);
+  if (entry.is_dir) {
+    html += '/';
+  }
+  html += "\">";
+  append_escaped(html, name);
+  if (entry.is_dir) {
+    html += '/';
+  }
+  html += "</a></td><td>";
+
+  char mtimeImage[DIR_LIST_MTIME_SIZE];
+  tm tm;
+  localtime_r(&entry.mtime.tv_sec, &tm); //local computer time? should be option between that and a tz from header.
+  html.append(mtimeImage, strftime(mtimeImage, sizeof mtimeImage, DIR_LIST_MTIME_FORMAT, &tm));
+  html += "</td><td>";
+  if (!entry.is_dir) {
+    char sizeImage[24];
+    html.append(sizeImage, snprintf(sizeImage, sizeof sizeImage, "%10llu", static_cast<unsigned long long>(entry.size)));
+  }
+  html += "</td></tr>\n";
+}
+
+void HtmlDirLister::tail(BodySink &html) {
+  html += "</table>\n";
+}
@@ -0,0 +1,83 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+#include "indexcache.h"
+
+#include <climits>
+
+using namespace DarkHttpd;
+
+void IndexCache::setNames(const char *commaList) {
+  names.clear();
+  std::string_view list(commaList);
+  while (!list.empty()) {
+    auto comma = list.find(',');
+    auto name = list.substr(0, comma);
+    if (!name.empty()) {
+      names.emplace_back(name);
+    }
+    if (comma == std::string_view::npos) {
+      break;
+    }
+    list.remove_prefix(comma + 1);
+  }
+}
+
+IndexCache::Pin IndexCache::find(std::string_view url, int64_t now) {
+  auto entry = lru.lookup(url);
+  if (entry == lru.end()) {
+    ++stats.misses;
+    return nullptr;
+  }
+  if (entry->value->expires && entry->value->expires < now) {
+    ++stats.invalidated;
+    ++stats.misses;
+    lru.drop(entry);
+    return nullptr;
+  }
+  lru.touch(entry);
+  ++stats.hits;
+  return entry->value;
+}
+
+IndexCache::Pin IndexCache::keep(std::string_view url, std::unique_ptr<Resolution> resolution) {
+  Pin pin{std::move(resolution)};
+  if (!limit) {
+    return pin;
+  }
+  stats.evictions += lru.insert(url, pin, limit);
+  return pin;
+}
+
+void IndexCache::drop(std::string_view directory) {
+  char url[PATH_MAX];
+  if (directory.size() + 1 >= sizeof(url)) {
+    return; //too long to have been served
+  }
+  directory.copy(url, directory.size());
+  url[directory.size()] = '/';
+  auto entry = lru.lookup({url, directory.empty() ? 0 : directory.size() + 1}); //wwwroot's url is empty, not "/"
+  if (entry != lru.end()) {
+    ++stats.invalidated;
+    lru.drop(entry);
+  }
+}
+
+void IndexCache::invalidate(std::string_view path, bool andBelow) {
+  if (!andBelow) { //path itself if it is a directory, and the one it is in, as path might be its index. Exact keys, this is what a file being written costs.
+    drop(path);
+    drop(FsWatcher::directoryOf(path));
+    return;
+  }
+  stats.invalidated += lru.dropIf([path](const auto &entry) {
+    auto &directory = entry.value->directory;
+    //the directory it is in as that might be an index name coming or going, or everything under a path that was replaced.
+    return directory == FsWatcher::directoryOf(path) || FsWatcher::covers(path, directory);
+  });
+}
+
+void IndexCache::invalidateAll() {
+  stats.invalidated += lru.clear();
+}
@@ -0,0 +1,72 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+#pragma once
+
+#include "fswatch.h"
+#include "lru.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace DarkHttpd {
+  /** what a directory url resolves to: one of the index names, held open with its stat, or nothing, meaning list the directory.
+   * A hit for an index costs no syscalls at all, the file is shared by every reply that sends it as sendfile doesn't move its position.
+   */
+  class IndexCache : public FsCache {
+  public:
+    struct Resolution {
+      Fd file; //statted, not open when there is no index
+      const char *mimetype = nullptr;
+      std::string directory; //relative to wwwroot, no trailing slash, for invalidation
+      int64_t expires = 0; //Ticks, 0 when the directory is watched
+
+      ~Resolution() {
+        file.close();
+      }
+    };
+
+    /** held by a connection while it sends the file */
+    using Pin = std::shared_ptr<const Resolution>;
+
+  private:
+    Lru<Pin> lru; //by url, relative with its trailing slash. The file closes when the last reply sending it lets go.
+
+    /** drop the entry for @param directory (relative, no trailing slash), if there is one */
+    void drop(std::string_view directory);
+
+  public:
+    /** the --index names, tried in order */
+    std::vector<std::string> names;
+    size_t limit = 256; //directories, each with an open file, --index-cache, 0 disables
+
+    struct Stats {
+      uint64_t hits = 0;
+      uint64_t misses = 0;
+      uint64_t evictions = 0; //for space
+      uint64_t invalidated = 0; //by events or expiry
+    } stats;
+
+    /** split @param commaList into names */
+    void setNames(const char *commaList);
+
+    /** @returns what @param url (relative, ending in a slash or empty) resolved to if still good at @param now */
+    Pin find(std::string_view url, int64_t now);
+
+    /** keep @param resolution for @param url, if caching. @returns a pin for it whether kept or not. */
+    Pin keep(std::string_view url, std::unique_ptr<Resolution> resolution);
+
+    void invalidate(std::string_view path, bool andBelow) override;
+
+    void invalidateAll() override;
+
+    size_t entries() const {
+      return lru.size();
+    }
+  };
+}
@@ -0,0 +1,183 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+#include "iopool.h"
+
+#include "darkerror.h"
+#include "ticks.h"
+
+#include <cerrno>
+#include <fcntl.h>
+#include <memory>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/* cachestat(2), Linux 6.5+. Declared here as libc and older kernel headers don't have it, the layout is fixed ABI. */
+#ifndef SYS_cachestat
+#define SYS_cachestat 451 //same number on every architecture
+#endif
+
+namespace {
+  struct CachestatRange {
+    uint64_t off;
+    uint64_t len;
+  };
+
+  struct Cachestat {
+    uint64_t nr_cache;
+    uint64_t nr_dirty;
+    uint64_t nr_writeback;
+    uint64_t nr_evicted;
+    uint64_t nr_recently_evicted;
+  };
+}
+
+using namespace DarkHttpd;
+
+int IoPool::begin() {
+  if (!threads) {
+    return -1;
+  }
+  doneSignal = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (!doneSignal.seemsOk()) {
+    warn("eventfd, sending cold files from the event loop");
+    return -1;
+  }
+  for (unsigned count = threads; count-- > 0;) {
+    workers.emplace_back([this](std::stop_token stop) {
+      work(stop);
+    });
+  }
+  return doneSignal;
+}
+
+void IoPool::finish() {
+  workers.clear(); //jthread asks each to stop, and joins it
+  for (auto &job: queue) {
+    ::close(job.fd);
+  }
+  queue.clear();
+  done.clear();
+  doneSignal.close();
+}
+
+bool IoPool::resident(int fd, off_t begin, size_t length) const {
+  static const long pageSize = sysconf(_SC_PAGESIZE);
+  if (!length) {
+    return true;
+  }
+  off_t first = begin / pageSize;
+  size_t pages = (begin + length - 1) / pageSize - first + 1;
+  if (haveCachestat) {
+    CachestatRange range{uint64_t(begin), length};
+    Cachestat cached{};
+    if (syscall(SYS_cachestat, fd, &range, &cached, 0) == 0) {
+      return cached.nr_cache >= pages;
+    }
+    if (errno != ENOSYS) {
+      return true;
+    }
+    haveCachestat = false; //old kernel, map and ask mincore instead
+  }
+  size_t mappedLength = pages * pageSize;
+  void *mapped = mmap(nullptr, mappedLength, PROT_READ, MAP_SHARED, fd, first * pageSize);
+  if (mapped == MAP_FAILED) {
+    return true;
+  }
+  unsigned char vector[Window / 4096 + 2]; //enough for a Window on any page size we'll see
+  std::unique_ptr<unsigned char[]> bigger; //for a caller asking about more than that
+  unsigned char *flags = vector;
+  if (pages > sizeof(vector)) {
+    bigger.reset(new unsigned char[pages]);
+    flags = bigger.get();
+  }
+  bool all = true;
+  if (mincore(mapped, mappedLength, flags) == 0) { //else can't tell, say yes
+    for (size_t page = 0; page < pages; ++page) {
+      if (!(flags[page] & 1)) {
+        all = false;
+        break;
+      }
+    }
+  }
+  munmap(mapped, mappedLength);
+  return all;
+}
+
+bool IoPool::submit(IoWaiter &waiter, unsigned ticket, int fd, off_t begin, size_t length, char *into) {
+  int own = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+  if (own == -1) {
+    return false; //out of fds
+  }
+  ++(into ? stats.reads : stats.deferred);
+  {
+    std::lock_guard guard(lock);
+    queue.push_back(Job{&waiter, ticket, own, begin, length, into, 0, 0});
+  }
+  wake.notify_one();
+  return true;
+}
+
+void IoPool::work(std::stop_token stop) {
+  std::unique_ptr<char[]> scratch(new char[ReadChunk]);
+  while (true) {
+    Job job;
+    {
+      std::unique_lock guard(lock);
+      if (!wake.wait(guard, stop, [this] {
+        return !queue.empty();
+      })) {
+        return; //asked to stop
+      }
+      job = queue.front();
+      queue.pop_front();
+    }
+    auto started = Ticks::now();
+    if (job.into) {
+      job.got = pread(job.fd, job.into, job.length, job.begin);
+      if (job.got == -1) {
+        job.got = -errno;
+      }
+    } else {
+      posix_fadvise(job.fd, job.begin, job.length, POSIX_FADV_WILLNEED); //start it all at once, the reads below then wait for it
+      for (size_t at = 0; at < job.length;) {
+        auto got = pread(job.fd, scratch.get(), std::min(ReadChunk, job.length - at), job.begin + at);
+        if (got <= 0) {
+          break; //sendfile will find the same problem and report it
+        }
+        at += got;
+      }
+    }
+    ::close(job.fd);
+    job.took = Ticks::now() - started;
+    {
+      std::lock_guard guard(lock);
+      done.push_back(job);
+    }
+    uint64_t one = 1;
+    if (write(doneSignal, &one, sizeof(one)) == -1) {
+      //counter overflow is the only failure and can't happen at our rates
+    }
+  }
+}
+
+void IoPool::onEpoll(unsigned epoll_flags unused) {
+  uint64_t count;
+  if (::read(doneSignal, &count, sizeof(count)) == -1) {
+    //EAGAIN, a previous wakeup took them all
+  }
+  std::deque<Job> finished;
+  {
+    std::lock_guard guard(lock);
+    finished.swap(done);
+  }
+  for (auto &job: finished) {
+    ++stats.completed;
+    stats.stalled += job.took;
+    job.waiter->loaded(job.ticket, job.into, job.got);
+  }
+}
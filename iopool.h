@@ -0,0 +1,100 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+#pragma once
+
+#include "fd.h"
+
+#include "epoller.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace DarkHttpd {
+  /** told when the window it asked for is in the page cache, or read into its buffer */
+  struct IoWaiter {
+    /** @param ticket is what was passed to IoPool::load or read, so that a waiter that has moved on to another request can ignore it.
+     * @param into is the buffer given to read, null for load, @param got is what pread returned for it, -errno on failure. */
+    virtual void loaded(unsigned ticket, char *into, ssize_t got) = 0;
+
+    virtual ~IoWaiter() = default;
+  };
+
+  /** keeps disk reads off the event loop. Before sendfile'ing a window of a file the connection asks resident() whether the page cache has it all,
+   * if not the window is given to a worker thread which reads it in while the loop serves everyone else, and the connection is called back through the Epoller.
+   */
+  class IoPool : public EpollHandler {
+    struct Job {
+      IoWaiter *waiter;
+      unsigned ticket;
+      int fd; //our own dup, the connection may close its copy before we are done
+      off_t begin;
+      size_t length;
+      char *into; //null to just bring it into the page cache
+      ssize_t got;
+      int64_t took; //Ticks the worker was blocked reading
+    };
+
+    bool submit(IoWaiter &waiter, unsigned ticket, int fd, off_t begin, size_t length, char *into);
+
+    std::mutex lock;
+    std::condition_variable_any wake;
+    std::deque<Job> queue;
+    std::deque<Job> done;
+    std::vector<std::jthread> workers;
+    Fd doneSignal; //eventfd, given to the Epoller
+    mutable bool haveCachestat = true; //cleared the first time the kernel says ENOSYS
+
+    void work(std::stop_token stop);
+
+  public:
+    /** sendfile is limited to this much past the last residency check */
+    static constexpr size_t Window = 1 << 20;
+    /** replies no bigger than this are sent without asking resident(), small files are nearly always hot and one miss blocks the loop for a single read */
+    static constexpr size_t ProbeAbove = 64 << 10;
+    /** the worker reads in pieces of this size, the data is discarded, it is the page cache we want filled */
+    static constexpr size_t ReadChunk = 128 << 10;
+
+    unsigned threads = 2; //--io-threads, 0 sends everything inline as before
+
+    struct Stats {
+      uint64_t unprobed = 0; //replies under ProbeAbove, sent from the loop without a check
+      uint64_t inlined = 0; //windows found resident and sent from the loop
+      uint64_t deferred = 0; //windows handed to a worker
+      uint64_t reads = 0; //O_DIRECT reads into buffers
+      uint64_t completed = 0;
+      int64_t stalled = 0; //Ticks the workers spent blocked, which the loop would have otherwise
+    } stats;
+
+    /** start the workers, @returns the fd for the caller to give to its Epoller, -1 when disabled. */
+    int begin();
+
+    /** stop and join the workers, forgetting anything not yet delivered */
+    void finish();
+
+    bool enabled() const {
+      return !workers.empty();
+    }
+
+    /** @returns whether every page of @param length bytes at @param begin of @param fd is in the page cache. Errors say yes, so that we send as we would have without this. */
+    bool resident(int fd, off_t begin, size_t length) const;
+
+    /** read the window in on a worker, then call @param waiter back with @param ticket. @returns false if it couldn't be handed over, send it inline. */
+    bool load(IoWaiter &waiter, unsigned ticket, int fd, off_t begin, size_t length) {
+      return submit(waiter, ticket, fd, begin, length, nullptr);
+    }
+
+    /** pread @param length bytes at @param begin of @param fd into @param into on a worker, then call @param waiter back. For O_DIRECT files, where the caller has aligned all three. */
+    bool read(IoWaiter &waiter, unsigned ticket, int fd, off_t begin, char *into, size_t length) {
+      return submit(waiter, ticket, fd, begin, length, into);
+    }
+
+    /** workers have finished some loads */
+    void onEpoll(unsigned epoll_flags) override;
+  };
+}
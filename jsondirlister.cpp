@@ -0,0 +1,60 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+#include "jsondirlister.h"
+
+#include <cstdio>
+
+using DarkHttpd::BodySink;
+
+void JsonDirLister::quoted(BodySink &json, const char *text) {
+  static const char hex[] = "0123456789abcdef";
+  json += '"';
+  while (*text) {
+    auto plain = text;
+    while (static_cast<unsigned char>(*plain) >= ' ' && *plain != '"' && *plain != '\\') {
+      ++plain;
+    }
+    json.append(text, plain - text);
+    text = plain;
+    if (unsigned char c = *text++) {
+      if (c == '"' || c == '\\') {
+        char escaped[2] = {'\\', char(c)};
+        json.append(escaped, 2);
+      } else {
+        char escaped[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF]};
+        json.append(escaped, 6);
+      }
+    } else {
+      break;
+    }
+  }
+  json += '"';
+}
+
+void JsonDirLister::head(BodySink &json, const char *decoded_url) {
+  json += "{\"path\":";
+  quoted(json, decoded_url);
+  json += ",\"entries\":[\n";
+}
+
+void JsonDirLister::row(BodySink &json, const char *name, const DirectoryListing::Entry &entry, bool first) {
+  if (!first) {
+    json += ",\n";
+  }
+  json += "{\"name\":";
+  quoted(json, name);
+  char numbers[100];
+  json.append(numbers, snprintf(numbers, sizeof(numbers), ",\"dir\":%s,\"size\":%llu,\"mtime\":%lld.%03ld}", entry.is_dir ? "true" : "false", static_cast<unsigned long long>(entry.size), static_cast<long long>(entry.mtime.tv_sec), entry.mtime.tv_nsec / 1000000));
+}
+
+void JsonDirLister::tail(BodySink &json, size_t next) {
+  if (~next) {
+    char numbers[40];
+    json.append(numbers, snprintf(numbers, sizeof(numbers), "\n],\"next\":%zu}\n", next));
+  } else {
+    json += "\n],\"next\":null}\n";
+  }
+}
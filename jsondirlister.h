@@ -0,0 +1,22 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+#pragma once
+#include "directorylisting.h"
+#include "bodyring.h"
+
+/** renders a directory as {"path":..., "entries":[{"name":...,"dir":...,"size":...,"mtime":...},...], "next":offset-or-null}, for scripts that would otherwise scrape the html. */
+class JsonDirLister {
+  /** as a JSON string, names that aren't UTF-8 are passed through as bytes */
+  static void quoted(DarkHttpd::BodySink &json, const char *text);
+
+public:
+  static void head(DarkHttpd::BodySink &json, const char *decoded_url);
+
+  static void row(DarkHttpd::BodySink &json, const char *name, const DirectoryListing::Entry &entry, bool first);
+
+  /** @param next is the offset of the following page, ~0 when there is none */
+  static void tail(DarkHttpd::BodySink &json, size_t next);
+};
@@ -0,0 +1,51 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+#include "keepalive.h"
+
+#include <algorithm>
+#include <sys/resource.h>
+
+using namespace DarkHttpd;
+
+/** fds for the listener, epoll, logs and the like, which connections can't have */
+static constexpr unsigned ReservedFds = 32;
+
+void KeepAlivePolicy::begin(int maxConnections) {
+  if (maxConnections > 0) {
+    capacity = unsigned(maxConnections);
+    return;
+  }
+  rlimit limit{};
+  if (getrlimit(RLIMIT_NOFILE, &limit) != 0 || limit.rlim_cur == RLIM_INFINITY) {
+    capacity = 0; //don't know, so always relaxed
+    return;
+  }
+  auto fds = unsigned(std::min<rlim_t>(limit.rlim_cur, ~0u));
+  capacity = fds > ReservedFds ? (fds - ReservedFds) / 2 : 1; //the socket and the file it is sending
+}
+
+KeepAlivePolicy::Terms KeepAlivePolicy::terms(unsigned live, unsigned timeout) {
+  Terms terms{timeout, maxRequests};
+  if (!capacity) {
+    return terms;
+  }
+  unsigned percent = unsigned(uint64_t(live) * 100 / capacity);
+  if (percent <= relaxedPercent || relaxedPercent >= 100) {
+    return terms;
+  }
+  double slack = double(100 - std::min(percent, 100u)) / (100 - relaxedPercent); //1 when relaxed, 0 at capacity
+  if (timeout > floorSecs) {
+    terms.idleSecs = floorSecs + unsigned((timeout - floorSecs) * slack);
+  } else if (!timeout) {
+    terms.idleSecs = floorSecs; //no timeout is a luxury for when there's room
+  }
+  if (maxRequests > minRequests || !maxRequests) {
+    unsigned most = maxRequests ? maxRequests : 10 * minRequests; //unlimited scales down from a nominal ceiling
+    terms.requests = minRequests + unsigned((most - minRequests) * slack);
+  }
+  stats.shortest = std::min(stats.shortest, terms.idleSecs);
+  return terms;
+}
@@ -0,0 +1,42 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+#pragma once
+
+#include <cstdint>
+
+namespace DarkHttpd {
+  /** how long an idle keep-alive may linger and how many requests it may make, scaled by how full we are.
+   * Below relaxedPercent of capacity a connection gets the whole --timeout and maxRequests, saving clients handshakes,
+   * from there both shrink linearly to floorSecs and minRequests at capacity, so that idle connections don't hold the fds new ones need.
+   */
+  class KeepAlivePolicy {
+  public:
+    unsigned floorSecs = 2; //--keepalive-min, idle timeout at capacity
+    unsigned maxRequests = 1000; //--keepalive-requests, per connection when relaxed, 0 for unlimited
+    unsigned minRequests = 10; //per connection at capacity
+    unsigned relaxedPercent = 50; //--keepalive-relaxed, of capacity
+
+    /** live connections we can hold: --maxconn, else what the fd limit allows. Set by begin() */
+    unsigned capacity = 0;
+
+    struct Terms {
+      unsigned idleSecs; //0 for no timeout
+      unsigned requests; //0 for unlimited
+    };
+
+    struct Stats {
+      uint64_t reaped = 0; //idle ones closed to make room for a new connection
+      uint64_t spent = 0; //closed after their last allowed request
+      unsigned shortest = ~0u; //tightest idle timeout handed out
+    } stats;
+
+    /** @param maxConnections is --maxconn, not positive to size by the fd limit */
+    void begin(int maxConnections);
+
+    /** @returns the terms for a connection when @param live are, @param timeout is --timeout */
+    Terms terms(unsigned live, unsigned timeout);
+  };
+}
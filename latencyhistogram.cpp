@@ -0,0 +1,120 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+#include "latencyhistogram.h"
+
+#include <cstring>
+
+unsigned LatencyHistogram::indexOf(uint64_t value) {
+  if (value < 2 * SubCount) {
+    return unsigned(value); //first two octaves are exact
+  }
+  unsigned shift = 63 - __builtin_clzll(value) - SubBits;
+  uint64_t mantissa = value >> shift; //in [SubCount, 2*SubCount)
+  return (shift + 1) * SubCount + unsigned(mantissa - SubCount);
+}
+
+uint64_t LatencyHistogram::valueAt(unsigned index) {
+  if (index < 2 * SubCount) {
+    return index;
+  }
+  unsigned shift = index / SubCount - 1;
+  uint64_t mantissa = index % SubCount + SubCount;
+  return ((mantissa + 1) << shift) - 1;
+}
+
+void LatencyHistogram::clear() {
+  memset(counts, 0, sizeof(counts));
+  total = 0;
+  lowest = ~0ULL;
+  highest = 0;
+  sum = 0;
+}
+
+void LatencyHistogram::record(uint64_t value, uint64_t count) {
+  counts[indexOf(value)] += count;
+  total += count;
+  sum += double(value) * count;
+  if (value < lowest) {
+    lowest = value;
+  }
+  if (value > highest) {
+    highest = value;
+  }
+}
+
+void LatencyHistogram::recordCorrected(uint64_t value, uint64_t expectedInterval) {
+  record(value);
+  if (expectedInterval == 0) {
+    return;
+  }
+  for (uint64_t missing = value; missing > expectedInterval;) {
+    missing -= expectedInterval;
+    record(missing);
+  }
+}
+
+void LatencyHistogram::merge(const LatencyHistogram &other) {
+  for (unsigned index = BucketCount; index-- > 0;) {
+    counts[index] += other.counts[index];
+  }
+  total += other.total;
+  sum += other.sum;
+  if (other.lowest < lowest) {
+    lowest = other.lowest;
+  }
+  if (other.highest > highest) {
+    highest = other.highest;
+  }
+}
+
+uint64_t LatencyHistogram::percentile(double percent) const {
+  if (total == 0) {
+    return 0;
+  }
+  uint64_t wanted = uint64_t(percent / 100.0 * total + 0.5);
+  if (wanted < 1) {
+    wanted = 1;
+  }
+  uint64_t seen = 0;
+  for (unsigned index = 0; index < BucketCount; ++index) {
+    seen += counts[index];
+    if (seen >= wanted) {
+      auto value = valueAt(index);
+      return value > highest ? highest : value; //bucket top can overstate the max
+    }
+  }
+  return highest;
+}
+
+static double millis(uint64_t ns) {
+  return double(ns) / 1e6;
+}
+
+void LatencyHistogram::report(FILE *out, const char *title, bool full) const {
+  fprintf(out, "%s: %llu samples, mean %.3f ms, min %.3f ms, max %.3f ms\n", title, static_cast<unsigned long long>(total), millis(uint64_t(mean())), millis(total ? lowest : 0), millis(highest));
+  static const double marks[] = {50, 75, 90, 99, 99.9, 99.99, 99.999};
+  for (auto mark: marks) {
+    fprintf(out, "  %8.3f%% %12.3f ms\n", mark, millis(percentile(mark)));
+  }
+  if (!full || total == 0) {
+    return;
+  }
+  fprintf(out, "%12s %14s %10s %14s\n\n", "Value", "Percentile", "TotalCount", "1/(1-Percentile)");
+  uint64_t seen = 0;
+  for (unsigned index = 0; index < BucketCount; ++index) {
+    if (counts[index] == 0) {
+      continue;
+    }
+    seen += counts[index];
+    double fraction = double(seen) / total;
+    if (fraction < 1.0) {
+      fprintf(out, "%12.3f %14.12f %10llu %14.2f\n", millis(valueAt(index)), fraction, static_cast<unsigned long long>(seen), 1.0 / (1.0 - fraction));
+    } else {
+      fprintf(out, "%12.3f %14.12f %10llu\n", millis(highest), fraction, static_cast<unsigned long long>(seen));
+    }
+  }
+  fprintf(out, "#[Mean = %12.3f, Max = %12.3f]\n#[Total count = %12llu]\n", millis(uint64_t(mean())), millis(highest), static_cast<unsigned long long>(total));
+}
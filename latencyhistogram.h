@@ -0,0 +1,56 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+#pragma once
+#include <cstdint>
+#include <cstdio>
+
+/** HDR style histogram: buckets are linear within each power of two, so relative precision is constant (~3%) from nanoseconds up to hours, in a fixed 15k of counters and with no allocation while recording. */
+class LatencyHistogram {
+public:
+  static constexpr unsigned SubBits = 5; //32 buckets per octave
+  static constexpr unsigned SubCount = 1 << SubBits;
+  static constexpr unsigned BucketCount = (64 - SubBits) * SubCount;
+
+private:
+  uint64_t counts[BucketCount];
+  uint64_t total = 0;
+  uint64_t lowest = ~0ULL;
+  uint64_t highest = 0;
+  double sum = 0;
+
+  static unsigned indexOf(uint64_t value);
+
+  /** @returns largest value that lands in bucket @param index */
+  static uint64_t valueAt(unsigned index);
+
+public:
+  LatencyHistogram() {
+    clear();
+  }
+
+  void clear();
+
+  void record(uint64_t value, uint64_t count = 1);
+
+  /** record @param value and, if it exceeds @param expectedInterval, the samples that a stalled closed-loop client never got to send (coordinated omission correction). */
+  void recordCorrected(uint64_t value, uint64_t expectedInterval);
+
+  void merge(const LatencyHistogram &other);
+
+  /** @returns value at or below which @param percent of the samples lie */
+  uint64_t percentile(double percent) const;
+
+  uint64_t count() const {
+    return total;
+  }
+
+  double mean() const {
+    return total ? sum / total : 0;
+  }
+
+  /** print summary percentiles, and when @param full the percentile distribution in the layout HdrHistogram's plotter reads. Values are recorded in ns and reported in ms. */
+  void report(FILE *out, const char *title, bool full) const;
+};
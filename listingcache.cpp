@@ -0,0 +1,69 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+#include "listingcache.h"
+
+#include <cstdio>
+
+using namespace DarkHttpd;
+
+size_t ListingCache::makeKey(char *buffer, size_t size, const struct stat &dir, std::string_view url, std::string_view options) {
+  int length = snprintf(buffer, size, "%llx:%llx:%llx.%lx:%.*s?%.*s", static_cast<unsigned long long>(dir.st_dev), static_cast<unsigned long long>(dir.st_ino), static_cast<unsigned long long>(dir.st_mtim.tv_sec), dir.st_mtim.tv_nsec, int(url.size()), url.data(), int(options.size()), options.data());
+  return length < 0 || size_t(length) >= size ? 0 : length;
+}
+
+ListingCache::Pin ListingCache::find(std::string_view key, int64_t now) {
+  auto entry = lru.lookup(key);
+  if (entry == lru.end()) {
+    ++stats.misses;
+    return nullptr;
+  }
+  if (entry->value->expires && entry->value->expires < now) {
+    ++stats.invalidated;
+    ++stats.misses;
+    lru.drop(entry);
+    return nullptr;
+  }
+  lru.touch(entry);
+  ++stats.hits;
+  return entry->value;
+}
+
+ListingCache::Pin ListingCache::keep(std::string_view key, std::unique_ptr<Rendered> rendered) {
+  Pin pin{std::move(rendered)};
+  size_t size = pin->body.size() + key.size();
+  if (size > limit) {
+    return pin; //served once, not kept
+  }
+  stats.evictions += lru.insert(key, pin, limit, size); //replaces one that two connections rendered at once
+  listed.emplace(pin->directory);
+  return pin;
+}
+
+bool ListingCache::affected(const Rendered &rendered, std::string_view path, bool andBelow) {
+  if (rendered.directory == path || rendered.directory == FsWatcher::directoryOf(path)) {
+    return true; //the directory itself, or one of its entries
+  }
+  return andBelow && FsWatcher::covers(path, rendered.directory);
+}
+
+void ListingCache::invalidate(std::string_view path, bool andBelow) {
+  auto directory = FsWatcher::directoryOf(path);
+  if (!andBelow && !listed.contains(path) && !listed.contains(directory)) {
+    return; //content or attributes of something no kept listing shows
+  }
+  //a scan, but structural events are rare compared to requests and the number of listings is bounded by the byte budget.
+  stats.invalidated += lru.dropIf([path, andBelow](const auto &entry) {
+    return affected(*entry.value, path, andBelow);
+  });
+  std::erase_if(listed, [path, directory, andBelow](const auto &each) {
+    return each == path || each == directory || (andBelow && FsWatcher::covers(path, each));
+  });
+}
+
+void ListingCache::invalidateAll() {
+  stats.invalidated += lru.clear();
+  listed.clear();
+}
@@ -0,0 +1,75 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+#pragma once
+
+#include "fswatch.h"
+#include "lru.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <sys/stat.h>
+
+namespace DarkHttpd {
+  /** rendered directory listings, keyed by (directory inode, mtime, url and listing options), least recently used dropped first to stay under a byte budget.
+   * A listing shows its entries' sizes and times, which don't touch the directory's mtime, so entries are also dropped on FsWatcher events or after the revalidate time where a directory can't be watched.
+   */
+  class ListingCache : public FsCache {
+  public:
+    struct Rendered {
+      std::string body;
+      char etag[40]; //quoted, ready for the header
+      const char *contentType = "text/html; charset=UTF-8";
+      std::string directory; //relative to wwwroot, for invalidation
+      int64_t expires = 0; //Ticks, 0 when the directory is watched
+    };
+
+    /** held by a connection while it sends the body, so that eviction doesn't pull it out from under the send */
+    using Pin = std::shared_ptr<const Rendered>;
+
+  private:
+    Lru<Pin> lru; //weighed by body and key bytes. Connections still sending one hold their own Pin.
+
+    /** directories that have listings kept, so that a file being written elsewhere costs a lookup rather than a scan.
+     * Eviction doesn't remove them, a stale one costs a single scan the next time something changes there. */
+    StringSet listed;
+
+    /** whether @param rendered shows anything that changed at @param path */
+    static bool affected(const Rendered &rendered, std::string_view path, bool andBelow);
+
+  public:
+    size_t limit = 16 << 20; //bytes of rendered listings, --listing-cache, 0 disables
+
+    struct Stats {
+      uint64_t hits = 0;
+      uint64_t misses = 0;
+      uint64_t evictions = 0; //for space
+      uint64_t invalidated = 0; //by events or expiry
+    } stats;
+
+    /** the key text, written into @param buffer of @param size. @returns its length, 0 if it doesn't fit */
+    static size_t makeKey(char *buffer, size_t size, const struct stat &dir, std::string_view url, std::string_view options);
+
+    /** @returns a cached listing for @param key if still good at @param now */
+    Pin find(std::string_view key, int64_t now);
+
+    /** keep @param rendered under @param key, if it fits. @returns a pin for it whether kept or not. */
+    Pin keep(std::string_view key, std::unique_ptr<Rendered> rendered);
+
+    void invalidate(std::string_view path, bool andBelow) override;
+
+    void invalidateAll() override;
+
+    size_t entries() const {
+      return lru.size();
+    }
+
+    size_t used() const {
+      return lru.weight();
+    }
+  };
+}
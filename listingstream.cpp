@@ -0,0 +1,248 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+#include "listingstream.h"
+
+#include "htmldirlister.h"
+#include "jsondirlister.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+using namespace DarkHttpd;
+
+/** query values: %xx and '+' for space, in place. @returns the end of the decoded text */
+static char *queryDecode(char *text) {
+  char *writer = text;
+  for (char *reader = text; *reader; ++reader) {
+    if (*reader == '%' && isxdigit(reader[1]) && isxdigit(reader[2])) {
+      char hex[3] = {reader[1], reader[2], 0};
+      *writer++ = char(strtoul(hex, nullptr, 16));
+      reader += 2;
+    } else {
+      *writer++ = *reader == '+' ? ' ' : *reader;
+    }
+  }
+  *writer = 0;
+  return writer;
+}
+
+static bool number(const char *text, size_t &value) {
+  char *end;
+  auto parsed = strtoull(text, &end, 10);
+  if (!*text || *end) {
+    return false;
+  }
+  value = parsed;
+  return true;
+}
+
+void ListingStream::Options::parse(char *params) {
+  while (params && *params) {
+    char *pair = params;
+    params = strchr(params, '&');
+    if (params) {
+      *params++ = 0;
+    }
+    char *value = strchr(pair, '=');
+    if (!value) {
+      continue;
+    }
+    *value++ = 0;
+    char *end = queryDecode(value);
+    std::string_view key(pair);
+    if (key == "format") {
+      if (!strcmp(value, "json")) {
+        format = Json;
+      } else if (!strcmp(value, "html")) {
+        format = Html;
+      }
+    } else if (key == "sort") {
+      descending = *value == '-';
+      std::string_view by(value + descending);
+      if (by == "name") {
+        order = DirectoryListing::ByName;
+      } else if (by == "mtime") {
+        order = DirectoryListing::ByMtime;
+      } else if (by == "size") {
+        order = DirectoryListing::BySize;
+      } else if (by == "none") {
+        order = DirectoryListing::Unsorted;
+      }
+    } else if (key == "offset") {
+      number(value, offset);
+    } else if (key == "limit") {
+      number(value, limit);
+    } else if (key == "prefix") {
+      prefix = std::string_view(value, end - value);
+    }
+  }
+}
+
+bool ListingStream::begin(int dirfd, const char *decoded_url) {
+  url = decoded_url;
+  list->followSymlinks = options.followSymlinks;
+  if (!list->open(dirfd)) {
+    return false;
+  }
+  if (options.order == DirectoryListing::Unsorted) {
+    toSkip = options.offset;
+    reading = true;
+    return true; //batches are read as the client takes them
+  }
+  while (list->readBatch(options.includeHidden, options.prefix)) {}
+  if (errno) {
+    return false;
+  }
+  if (options.order != DirectoryListing::ByName) { //the order, and so the page, depends on what stat says
+    if (pool && pool->enabled() && list->ing.size() > DirectoryListing::ParallelAbove) {
+      sortPending = true; //produce() has the pool stat them all, meanwhile the page is as it would be if every stat succeeds
+      next = std::min(options.offset, list->ing.size());
+      pastEnd = options.limit ? std::min(list->ing.size(), next + options.limit) : list->ing.size();
+      return true;
+    }
+    list->stat(0, list->ing.size());
+  }
+  sortAndPage();
+  return true;
+}
+
+void ListingStream::sortAndPage() {
+  sortPending = false;
+  if (options.order != DirectoryListing::ByName) {
+    list->dropMissing();
+    statted = list->ing.size();
+  }
+  list->sort(options.order, options.descending);
+  next = std::min(options.offset, list->ing.size());
+  pastEnd = options.limit ? std::min(list->ing.size(), next + options.limit) : list->ing.size();
+  statted = std::max(statted, next);
+}
+
+bool ListingStream::statEntries(size_t from, size_t upTo) {
+  if (pool && waiter && upTo - from > DirectoryListing::ParallelAbove) {
+    statting = pool->stat(*waiter, ticket, list, from, upTo);
+    if (statting) {
+      return false;
+    }
+  }
+  list->stat(from, upTo);
+  return true;
+}
+
+size_t ListingStream::entries() const {
+  return reading ? ~size_t(0) : pastEnd - next;
+}
+
+bool ListingStream::nextBatch() {
+  list->clear();
+  next = pastEnd = statted = 0;
+  if (!list->readBatch(options.includeHidden, options.prefix)) {
+    reading = false; //an error part way is reported as a short listing, the header has long gone.
+    return false;
+  }
+  auto skip = std::min(toSkip, list->ing.size());
+  toSkip -= skip;
+  next = statted = skip;
+  pastEnd = list->ing.size();
+  if (options.limit) {
+    pastEnd = std::min(pastEnd, next + options.limit - sent);
+  }
+  return true;
+}
+
+size_t ListingStream::nextOffset() const {
+  if (!options.limit) {
+    return ~size_t(0);
+  }
+  if (options.order == DirectoryListing::Unsorted) {
+    return sent == options.limit ? options.offset + options.limit : ~size_t(0); //perhaps an empty page if the directory ended exactly here
+  }
+  return pastEnd < list->ing.size() ? pastEnd : ~size_t(0);
+}
+
+void ListingStream::pageLink(BodySink &html, size_t offset) const {
+  static const char *const sorts[] = {"name", "mtime", "size", "none"};
+  html += "<p><a href=\"?sort=";
+  if (options.descending) {
+    html += '-';
+  }
+  html += sorts[options.order];
+  if (!options.prefix.empty()) {
+    html += "&amp;prefix=";
+    HtmlDirLister::htmlencode(html, std::string(options.prefix).c_str());
+  }
+  html += "&amp;offset=" + std::to_string(offset) + "&amp;limit=" + std::to_string(options.limit) + "\">next page</a></p>\n";
+}
+
+bool ListingStream::produce(BodySink &into) {
+  if (phase == Head) {
+    if (options.format == Options::Json) {
+      JsonDirLister::head(into, url.c_str());
+    } else {
+      HtmlDirLister::head(into, url.c_str());
+    }
+    phase = Rows;
+  }
+  if (phase == Rows && sortPending) {
+    if (!statting && !statEntries(0, list->ing.size())) {
+      return true; //the head goes out while the pool stats
+    }
+    statting.reset();
+    sortAndPage();
+  }
+  while (phase == Rows && !into.full()) {
+    if (options.limit && sent == options.limit) {
+      phase = Tail;
+      break;
+    }
+    if (next >= pastEnd) {
+      if (reading && nextBatch()) {
+        continue;
+      }
+      phase = Tail;
+      break;
+    }
+    if (next >= statted) {
+      auto upTo = std::min(pastEnd, next + StatAhead);
+      if (!statting && !statEntries(next, upTo)) {
+        return true; //what is in into goes out while the pool stats
+      }
+      statting.reset();
+      statted = upTo;
+    }
+    auto &entry = list->ing[next++];
+    if (entry.missing) {
+      continue;
+    }
+    if (options.format == Options::Json) {
+      JsonDirLister::row(into, list->nameOf(entry), entry, sent == 0);
+    } else {
+      HtmlDirLister::row(into, list->nameOf(entry), entry);
+    }
+    ++sent;
+  }
+  if (phase == Tail) { //small enough to go in even when full
+    if (options.format == Options::Json) {
+      JsonDirLister::tail(into, nextOffset());
+    } else {
+      HtmlDirLister::tail(into);
+      auto following = nextOffset();
+      if (~following) {
+        pageLink(into, following);
+      }
+      into += footer;
+    }
+    phase = Done;
+  }
+  return phase != Done;
+}
+
+const char *ListingStream::contentType() const {
+  return options.format == Options::Json ? "application/json" : "text/html; charset=UTF-8";
+}
@@ -0,0 +1,108 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+#pragma once
+
+#include "bodyproducer.h"
+#include "directorylisting.h"
+#include "statpool.h"
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace DarkHttpd {
+  /** a directory listing generated as it is sent, a page of it if asked.
+   * Sorted listings read every name up front, which getdents64 does quickly, but stat only the entries being sent unless sorting by mtime or size.
+   * Unsorted ones read the directory a batch at a time as the client takes it, so the first byte goes out as soon for a million entries as for ten.
+   * More than DirectoryListing::ParallelAbove entries at a time are statted on the StatPool, the connection being called back when they are done.
+   */
+  class ListingStream : public BodyProducer {
+  public:
+    struct Options {
+      enum Format {
+        Html = 0,
+        Json
+      } format = Html;
+
+      DirectoryListing::Order order = DirectoryListing::ByName;
+      bool descending = false;
+      size_t offset = 0;
+      size_t limit = 0; //0 for all of them
+      std::string_view prefix;
+      bool includeHidden = true;
+      bool followSymlinks = false; //not from the query, the server's --symlinks any
+
+      /** from the query string @param params, which is split and decoded in place: format=html|json, sort=[-]name|mtime|size|none, offset=, limit=, prefix=.
+       * Unknown keys and bad values are ignored. */
+      void parse(char *params);
+    } options;
+
+    /** pages bigger than this are sent as they are generated rather than rendered and cached first */
+    static constexpr size_t StreamAbove = DirectoryListing::ParallelAbove;
+
+    /** Unsorted and ByName stat this many entries at a time as the send reaches them */
+    static constexpr size_t StatAhead = 2 * DirectoryListing::ParallelAbove;
+
+    std::string footer; //html after the table, the server's generated-by line
+
+    /** where to stat many entries at once, and who to call back when that is done. Without a pool they are statted inline. */
+    StatPool *pool = nullptr;
+    IoWaiter *waiter = nullptr;
+    unsigned ticket = 0;
+
+  private:
+    std::shared_ptr<DirectoryListing> list = std::make_shared<DirectoryListing>(); //shared with the pool's workers while they stat it
+    std::shared_ptr<const StatPool::Batch> statting; //in progress, or done and not yet looked at
+    bool sortPending = false; //ByMtime and BySize, sorted once the pool has statted them all
+    std::string url;
+    size_t next = 0; //index in list.ing of the next entry to send
+    size_t pastEnd = 0; //of the entries in list.ing that this page sends
+    size_t statted = 0; //entries before this have been statted
+    size_t sent = 0;
+    size_t toSkip = 0; //Unsorted: offset entries still to be passed over
+    bool reading = false; //Unsorted: more batches to come
+    enum {
+      Head,
+      Rows,
+      Tail,
+      Done
+    } phase = Head;
+
+    /** Unsorted: the next batch of the directory, @returns false at its end */
+    bool nextBatch();
+
+    /** stat entries [first, pastEnd), on the pool if there are many. @returns false if that is under way, produce is called again when it is done. */
+    bool statEntries(size_t first, size_t pastEnd);
+
+    /** ByMtime and BySize: drop the missing, sort, and choose the page */
+    void sortAndPage();
+
+    /** offset of the page after this one, ~0 for none */
+    size_t nextOffset() const;
+
+    void pageLink(BodySink &html, size_t offset) const;
+
+  public:
+    /** read (or start reading) the directory open as @param dirfd, @returns false with errno set if it can't be */
+    bool begin(int dirfd, const char *decoded_url);
+
+    /** entries this will send, the whole directory where that isn't known yet, or before dropping those that couldn't be statted */
+    size_t entries() const;
+
+    /** whether the first row waits for the pool, so it can't be rendered before the header is sent */
+    bool deferred() const {
+      return sortPending;
+    }
+
+    bool waiting() const override {
+      return statting && !statting->delivered;
+    }
+
+    bool produce(BodySink &into) override;
+
+    const char *contentType() const override;
+  };
+}
@@ -0,0 +1,444 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+#include "loadclient.h"
+
+#include "ticks.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+using namespace DarkHttpd;
+
+bool LoadTarget::resolve() {
+  memset(&address, 0, sizeof(address));
+  auto in4 = reinterpret_cast<sockaddr_in *>(&address);
+  if (inet_pton(AF_INET, host, &in4->sin_addr) == 1) {
+    in4->sin_family = AF_INET;
+    in4->sin_port = htons(port);
+    length = sizeof(sockaddr_in);
+    return true;
+  }
+  auto in6 = reinterpret_cast<sockaddr_in6 *>(&address);
+  if (inet_pton(AF_INET6, host, &in6->sin6_addr) == 1) {
+    in6->sin6_family = AF_INET6;
+    in6->sin6_port = htons(port);
+    length = sizeof(sockaddr_in6);
+    return true;
+  }
+  return false; //we don't do DNS, this is a tool for local testing.
+}
+
+bool LoadTarget::bindSource(int fd) const {
+  if (sources == 0 || address.ss_family != AF_INET) {
+    return true;
+  }
+  sockaddr_in local;
+  memset(&local, 0, sizeof(local));
+  local.sin_family = AF_INET;
+  local.sin_addr.s_addr = htonl(INADDR_LOOPBACK + nextSource++ % sources);
+  int sockopt = 1;
+  setsockopt(fd, IPPROTO_IP, IP_BIND_ADDRESS_NO_PORT, &sockopt, sizeof(sockopt)); //defer port choice to connect() so the 4-tuple, not the port, has to be unique
+  return bind(fd, reinterpret_cast<sockaddr *>(&local), sizeof(local)) == 0;
+}
+
+int LoadTarget::connectNonblocking() const {
+  int fd = ::socket(address.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd == -1) {
+    return -1;
+  }
+  int sockopt = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &sockopt, sizeof(sockopt));
+  if (!bindSource(fd) || (connect(fd, reinterpret_cast<const sockaddr *>(&address), length) == -1 && errno != EINPROGRESS)) {
+    ::close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+bool UrlMix::add(const char *url, unsigned weight, const LoadTarget &target) {
+  if (!url || *url != '/' || weight == 0) {
+    return false;
+  }
+  auto size = snprintf(nullptr, 0, "GET %s HTTP/1.1\r\nHost: %s\r\nConnection: %s\r\n\r\n", url, target.host, keepalive ? "keep-alive" : "close");
+  auto text = static_cast<char *>(malloc(size + 1)); //lives until exit.
+  snprintf(text, size + 1, "GET %s HTTP/1.1\r\nHost: %s\r\nConnection: %s\r\n\r\n", url, target.host, keepalive ? "keep-alive" : "close");
+  totalWeight += weight;
+  entries.push_back({url, StringView(text, size), totalWeight});
+  return true;
+}
+
+bool UrlMix::load(const char *fileName, const LoadTarget &target) {
+  FILE *list = fopen(fileName, "r");
+  if (!list) {
+    return false;
+  }
+  char line[FILENAME_MAX + 32];
+  bool happy = true;
+  while (fgets(line, sizeof(line), list)) {
+    StringView scanner(line);
+    scanner.trimLeading(" \t");
+    scanner.trimTrailing(" \t\r\n");
+    if (!scanner || *scanner.begin() == '#') {
+      continue;
+    }
+    unsigned weight = 1;
+    if (*scanner.begin() != '/') {
+      weight = unsigned(scanner.cutNumber());
+      scanner.trimLeading(" \t");
+    }
+    scanner.begin()[scanner.length] = 0;
+    happy &= add(strdup(scanner.begin()), weight, target);
+  }
+  fclose(list);
+  return happy && !entries.empty();
+}
+
+const StringView &UrlMix::pick() {
+  if (entries.size() == 1) {
+    return entries.front().text;
+  }
+  //xorshift64, plenty random enough to shuffle a mix and costs nothing.
+  rng ^= rng << 13;
+  rng ^= rng >> 7;
+  rng ^= rng << 17;
+  unsigned ticket = unsigned(rng % totalWeight);
+  //binary search on cumulative weights
+  size_t low = 0;
+  size_t high = entries.size() - 1;
+  while (low < high) {
+    size_t mid = (low + high) / 2;
+    if (entries[mid].cumulative > ticket) {
+      high = mid;
+    } else {
+      low = mid + 1;
+    }
+  }
+  return entries[low].text;
+}
+
+void LoadStats::merge(const LoadStats &other) {
+  sent += other.sent;
+  completed += other.completed;
+  errors += other.errors;
+  connects += other.connects;
+  connectFailures += other.connectFailures;
+  bytesIn += other.bytesIn;
+  bytesOut += other.bytesOut;
+  for (unsigned index = 6; index-- > 0;) {
+    statusClass[index] += other.statusClass[index];
+  }
+  latency.merge(other.latency);
+  connectTime.merge(other.connectTime);
+}
+
+void LoadStats::report(FILE *out, const char *title, double seconds, bool fullHistogram) const {
+  fprintf(out, "== %s\n", title);
+  fprintf(out, "requests: %llu sent, %llu completed (%.1f/s), %llu lost\n", static_cast<unsigned long long>(sent), static_cast<unsigned long long>(completed), seconds > 0 ? completed / seconds : 0.0, static_cast<unsigned long long>(errors));
+  fprintf(out, "status: 1xx %llu, 2xx %llu, 3xx %llu, 4xx %llu, 5xx %llu, garbled %llu\n",
+    static_cast<unsigned long long>(statusClass[1]), static_cast<unsigned long long>(statusClass[2]), static_cast<unsigned long long>(statusClass[3]),
+    static_cast<unsigned long long>(statusClass[4]), static_cast<unsigned long long>(statusClass[5]), static_cast<unsigned long long>(statusClass[0]));
+  fprintf(out, "connections: %llu opened, %llu failed\n", static_cast<unsigned long long>(connects), static_cast<unsigned long long>(connectFailures));
+  fprintf(out, "bytes: %llu in (%.1f MB/s), %llu out\n", static_cast<unsigned long long>(bytesIn), seconds > 0 ? bytesIn / seconds / 1e6 : 0.0, static_cast<unsigned long long>(bytesOut));
+  latency.report(out, "latency", fullHistogram);
+  if (connectTime.count()) {
+    connectTime.report(out, "connect", false);
+  }
+}
+
+LoadClient::LoadClient(LoadEpoller &epoller, const LoadTarget &target, Driver &driver, LoadStats &stats): epoller{epoller}, target{target}, driver{driver}, stats{&stats} {}
+
+LoadClient::~LoadClient() {
+  close();
+}
+
+void LoadClient::listenFor(unsigned flags) {
+  if (flags == interest) {
+    return;
+  }
+  if (interest) {
+    epoller.remove(socket);
+  }
+  interest = flags;
+  if (interest) {
+    epoller.watch(socket, interest, *this);
+  }
+}
+
+bool LoadClient::open() {
+  close();
+  connectStarted = Ticks::now();
+  socket = target.connectNonblocking();
+  if (!socket.seemsOk()) {
+    ++stats->connectFailures;
+    return false;
+  }
+  connecting = true;
+  listenFor(EPOLLOUT);
+  return true;
+}
+
+void LoadClient::close() {
+  if (socket.seemsOk()) {
+    listenFor(0);
+    socket.close();
+  }
+  connecting = false;
+  outHead = outTail = 0;
+  inUsed = 0;
+  phase = StatusAndHeaders;
+  dueHead = dueCount = 0;
+}
+
+void LoadClient::fail() {
+  stats->errors += dueCount;
+  close();
+}
+
+bool LoadClient::submit(const StringView &request, int64_t due) {
+  if (dueCount >= MaxPipeline || request.length > BufferSize) {
+    return false;
+  }
+  if (outTail + request.length > BufferSize) { //compact
+    memmove(outbox, outbox + outHead, outTail - outHead);
+    outTail -= outHead;
+    outHead = 0;
+    if (outTail + request.length > BufferSize) {
+      return false;
+    }
+  }
+  request.put(outbox + outTail, false);
+  outTail += request.length;
+  dueAt[(dueHead + dueCount++) % MaxPipeline] = due;
+  ++stats->sent;
+  if (isConnected()) {
+    flush();
+  }
+  return true;
+}
+
+bool LoadClient::flush() {
+  while (outHead < outTail) {
+    auto sent = send(socket, outbox + outHead, outTail - outHead, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (sent == -1) {
+      if (errno == EAGAIN) {
+        listenFor(EPOLLIN | EPOLLOUT);
+        return true;
+      }
+      fail();
+      return false;
+    }
+    stats->bytesOut += sent;
+    outHead += sent;
+  }
+  outHead = outTail = 0;
+  listenFor(EPOLLIN);
+  return true;
+}
+
+void LoadClient::onEpoll(unsigned epoll_flags) {
+  if (connecting) {
+    int error = 0;
+    socklen_t errlen = sizeof(error);
+    getsockopt(socket, SOL_SOCKET, SO_ERROR, &error, &errlen);
+    if (error || (epoll_flags & (EPOLLERR | EPOLLHUP))) {
+      ++stats->connectFailures;
+      fail();
+      return;
+    }
+    connecting = false;
+    ++stats->connects;
+    stats->connectTime.record(Ticks::now() - connectStarted);
+    if (!flush()) {
+      return;
+    }
+    driver.onCapacity(*this);
+    return;
+  }
+  if (epoll_flags & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+    onReadable();
+    if (!socket.seemsOk()) {
+      return;
+    }
+  }
+  if (epoll_flags & EPOLLOUT) {
+    flush();
+  }
+}
+
+void LoadClient::onReadable() {
+  receive();
+}
+
+size_t LoadClient::receive(size_t most) {
+  auto got = recv(socket, inbox + inUsed, std::min(most, BufferSize - inUsed), MSG_DONTWAIT);
+  if (got == -1 && errno == EAGAIN) {
+    return 0;
+  }
+  if (got <= 0) { //server closed on us, or worse
+    fail();
+    driver.onCapacity(*this); //gives the driver a chance to reconnect
+    return 0;
+  }
+  stats->bytesIn += got;
+  inUsed += got;
+  while (inUsed && parseStep()) {
+    if (!socket.seemsOk()) {
+      return got;
+    }
+  }
+  if (inUsed == BufferSize) { //a header that doesn't fit is as good as garbage
+    ++stats->statusClass[0];
+    fail();
+  }
+  return got;
+}
+
+/** remove @param used bytes from the front of @param buffer */
+static void consume(char *buffer, size_t &inUsed, size_t used) {
+  memmove(buffer, buffer + used, inUsed - used);
+  inUsed -= used;
+}
+
+bool LoadClient::parseHead() {
+  inbox[inUsed] = 0;
+  auto headEnd = static_cast<char *>(memmem(inbox, inUsed, "\r\n\r\n", 4));
+  if (!headEnd) {
+    return false;
+  }
+  headEnd += 4;
+  size_t headLength = headEnd - inbox;
+  StringView scanner(inbox, headLength);
+  auto statusLine = scanner.cutToken('\n', false);
+  auto version = statusLine.cutToken(' ', false);
+  status = int(statusLine.cutNumber());
+  bodyLeft = 0;
+  closeAfter = version == "HTTP/1.0"; //unless it says keep-alive below
+
+  bool chunked = false;
+  while (auto headerline = scanner.cutToken('\n', false)) {
+    auto headername = headerline.cutToken(':', false);
+    if (!headername) {
+      break;
+    }
+    headerline.trimLeading(" \t");
+    headerline.trimTrailing(" \t\r");
+    if (headername == "Content-Length") {
+      bodyLeft = headerline.cutNumber();
+    } else if (headername == "Transfer-Encoding") {
+      chunked = headerline == "chunked";
+    } else if (headername == "Connection") {
+      closeAfter = !(headerline == "keep-alive");
+    }
+  }
+  consume(inbox, inUsed, headLength);
+  if (status < 100 || status > 599) {
+    ++stats->statusClass[0];
+    fail();
+    return true;
+  }
+  if (status < 200 || status == 204 || status == 304) {
+    bodyLeft = 0; //no body regardless of what headers say
+    chunked = false;
+  }
+  if (!chunked && bodyLeft == 0) { //Content-Length: 0, a 304, ... there is no Body step to finish it, nor need there be any more input
+    finishReply();
+    return true;
+  }
+  phase = chunked ? ChunkSize : Body;
+  return true;
+}
+
+bool LoadClient::parseStep() {
+  switch (phase) {
+    case StatusAndHeaders:
+      return parseHead();
+    case Body: {
+      size_t take = std::min<int64_t>(bodyLeft, inUsed);
+      consume(inbox, inUsed, take);
+      bodyLeft -= take;
+      if (bodyLeft == 0) {
+        finishReply();
+        return true;
+      }
+      return false; //need more
+    }
+    case ChunkSize: {
+      auto eol = static_cast<char *>(memmem(inbox, inUsed, "\r\n", 2));
+      if (!eol) {
+        return false;
+      }
+      *eol = 0;
+      bodyLeft = strtoll(inbox, nullptr, 16);
+      consume(inbox, inUsed, eol + 2 - inbox);
+      phase = bodyLeft ? ChunkData : ChunkTrailer;
+      bodyLeft += bodyLeft ? 2 : 0; //data is followed by CRLF
+      return true;
+    }
+    case ChunkData: {
+      size_t take = std::min<int64_t>(bodyLeft, inUsed);
+      consume(inbox, inUsed, take);
+      bodyLeft -= take;
+      if (bodyLeft == 0) {
+        phase = ChunkSize;
+        return true;
+      }
+      return false;
+    }
+    case ChunkTrailer: {
+      auto eol = static_cast<char *>(memmem(inbox, inUsed, "\r\n", 2));
+      if (!eol) {
+        return false;
+      }
+      bool last = eol == inbox; //empty line ends trailers
+      consume(inbox, inUsed, eol + 2 - inbox);
+      if (last) {
+        finishReply();
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
+void LoadClient::finishReply() {
+  phase = StatusAndHeaders;
+  ++stats->statusClass[status / 100];
+  if (dueCount) {
+    auto due = dueAt[dueHead];
+    dueHead = (dueHead + 1) % MaxPipeline;
+    --dueCount;
+    ++stats->completed;
+    auto now = Ticks::now();
+    stats->latency.recordCorrected(now > due ? now - due : 0, stats->expectedInterval);
+  } else {
+    ++stats->statusClass[0]; //reply to nothing
+  }
+  if (closeAfter) {
+    fail(); //the server won't answer anything else we piped in.
+  }
+  driver.onCapacity(*this);
+}
+
+rlim_t raiseFdLimit(rlim_t wanted) {
+  rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) == -1) {
+    return 0;
+  }
+  if (limit.rlim_cur < wanted) {
+    limit.rlim_cur = std::min(wanted, limit.rlim_max);
+    setrlimit(RLIMIT_NOFILE, &limit);
+    getrlimit(RLIMIT_NOFILE, &limit);
+  }
+  return limit.rlim_cur;
+}
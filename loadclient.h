@@ -0,0 +1,193 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+#pragma once
+
+#include "fd.h"
+#include "latencyhistogram.h"
+#include "stringview.h"
+
+#include "epoller.h"
+#include <cstdint>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <vector>
+
+/** the load tools all share one event loop type, sized for many mostly-ready sockets */
+using LoadEpoller = Epoller<64>;
+
+/** where the load goes */
+struct LoadTarget {
+  sockaddr_storage address;
+  socklen_t length = 0;
+  const char *host = "127.0.0.1"; //for the Host: header, and the address if it parses as one
+  uint16_t port = 8080;
+  /** when nonzero and the target is ipv4 loopback, sockets are bound round-robin to 127.0.0.1..sources so that more than one ephemeral port range is available, which is needed past ~28k connections. */
+  unsigned sources = 0;
+  mutable unsigned nextSource = 0;
+
+  /** convert host and port into address, @returns whether host was a literal ipv4 or ipv6 address */
+  bool resolve();
+
+  /** bind @param fd to the next source address if sources is in use */
+  bool bindSource(int fd) const;
+
+  /** start a non-blocking connect on a new socket, @returns the socket or -1 */
+  int connectNonblocking() const;
+};
+
+/** pre-rendered GET requests with relative weights, picked at random with the given mix */
+class UrlMix {
+  struct Entry {
+    const char *url;
+    StringView text; //the whole request
+    unsigned cumulative; //sum of weights of this and all prior entries.
+  };
+
+  std::vector<Entry> entries;
+  unsigned totalWeight = 0;
+  uint64_t rng = 0x9E3779B97F4A7C15ULL;
+
+public:
+  bool keepalive = true;
+
+  /** add one url, the request text is rendered here so that nothing is formatted while under load */
+  bool add(const char *url, unsigned weight, const LoadTarget &target);
+
+  /** read lines of "[weight] url", # starts a comment */
+  bool load(const char *fileName, const LoadTarget &target);
+
+  bool operator!() const {
+    return entries.empty();
+  }
+
+  const StringView &pick();
+
+  size_t size() const {
+    return entries.size();
+  }
+};
+
+/** things worth counting, one of these per population of clients so that fast and slow clients can be compared */
+struct LoadStats {
+  uint64_t sent = 0;
+  uint64_t completed = 0;
+  uint64_t errors = 0; //requests lost to a broken connection or a malformed reply
+  uint64_t connects = 0;
+  uint64_t connectFailures = 0;
+  uint64_t bytesIn = 0;
+  uint64_t bytesOut = 0;
+  uint64_t statusClass[6] = {0}; //[0] is for garbage, else status/100
+  uint64_t expectedInterval = 0; //ns, when nonzero closed loop latencies get coordinated omission correction
+  LatencyHistogram latency; //from intended send time to last byte of reply
+  LatencyHistogram connectTime; //from connect() to writable
+
+  void merge(const LoadStats &other);
+
+  void report(FILE *out, const char *title, double seconds, bool fullHistogram) const;
+};
+
+/** one keep-alive connection that can carry pipelined requests. Latency is measured from the time the driver says a request was due, not when it was actually sent, so an open loop driver gets coordinated-omission-free numbers. */
+class LoadClient : public EpollHandler {
+public:
+  /** whoever decides what to send next */
+  struct Driver {
+    /** the client can take another request */
+    virtual void onCapacity(LoadClient &client) = 0;
+
+    virtual ~Driver() = default;
+  };
+
+  static constexpr unsigned MaxPipeline = 256;
+  static constexpr size_t BufferSize = 16384;
+
+protected:
+  LoadEpoller &epoller;
+  const LoadTarget &target;
+  Driver &driver;
+  LoadStats *stats;
+
+  DarkHttpd::Fd socket;
+  unsigned interest = 0; //what epoller was last told to watch for
+  bool connecting = false;
+  int64_t connectStarted = 0;
+
+  char outbox[BufferSize];
+  size_t outHead = 0; //next byte to send
+  size_t outTail = 0; //next byte to fill
+
+  /* due times of requests that have been queued and not yet answered, oldest first */
+  int64_t dueAt[MaxPipeline];
+  unsigned dueHead = 0;
+  unsigned dueCount = 0;
+
+  /* reply parsing */
+  char inbox[BufferSize + 1];
+  size_t inUsed = 0;
+
+  enum Phase {
+    StatusAndHeaders, Body, ChunkSize, ChunkData, ChunkTrailer
+  } phase = StatusAndHeaders;
+
+  int status = 0;
+  int64_t bodyLeft = 0;
+  bool closeAfter = false;
+
+  void listenFor(unsigned flags);
+
+  virtual bool flush();
+
+  /** read at most @param most bytes and feed them to the reply parser, @returns bytes read */
+  size_t receive(size_t most = BufferSize);
+
+  /** @returns whether something was consumed, false if more bytes are needed */
+  bool parseStep();
+
+  bool parseHead();
+
+  void finishReply();
+
+  /** drop the connection, counting whatever was in flight as lost */
+  void fail();
+
+  virtual void onReadable();
+
+public:
+  unsigned depth = 1; //pipeline depth the driver wants
+  bool listed = false; //for the driver's bookkeeping
+
+  LoadClient(LoadEpoller &epoller, const LoadTarget &target, Driver &driver, LoadStats &stats);
+
+  ~LoadClient() override;
+
+  /** start non-blocking connect */
+  bool open();
+
+  void close();
+
+  bool isConnected() const {
+    return socket.seemsOk() && !connecting;
+  }
+
+  unsigned outstanding() const {
+    return dueCount;
+  }
+
+  bool hasCapacity() const {
+    return isConnected() && dueCount < depth && dueCount < MaxPipeline;
+  }
+
+  /** queue a request that was due at @param due, @returns false if there is no room for it */
+  bool submit(const StringView &request, int64_t due);
+
+  void useStats(LoadStats &newStats) {
+    stats = &newStats;
+  }
+
+  void onEpoll(unsigned epoll_flags) override;
+};
+
+/** bump RLIMIT_NOFILE soft limit towards @param wanted, @returns what we got */
+rlim_t raiseFdLimit(rlim_t wanted);
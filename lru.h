@@ -0,0 +1,106 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+#pragma once
+
+#include "stringhash.h"
+
+#include <cstddef>
+#include <list>
+#include <string>
+#include <string_view>
+
+namespace DarkHttpd {
+  /** string keyed entries kept in order of use, for the caches that drop the least recently used to stay under a limit.
+   * Each entry has a weight, 1 to bound by count, its bytes to bound by size, and the sum of them is kept here.
+   */
+  template<typename Value> class Lru {
+  public:
+    struct Entry {
+      std::string key;
+      Value value;
+      size_t weight;
+    };
+
+    using Iterator = typename std::list<Entry>::iterator;
+
+  private:
+    std::list<Entry> order; //most recent at front
+    StringMap<Iterator> byKey;
+    size_t used = 0;
+
+  public:
+    /** @returns the entry for @param key, end() if none, without counting this as a use */
+    Iterator lookup(std::string_view key) {
+      auto found = byKey.find(key);
+      return found == byKey.end() ? order.end() : found->second;
+    }
+
+    /** make @param entry the most recently used */
+    void touch(Iterator entry) {
+      order.splice(order.begin(), order, entry);
+    }
+
+    /** put @param value under @param key, replacing any already there, after dropping the least recently used until @param weight more fits under @param limit.
+     * @returns how many were dropped for room */
+    size_t insert(std::string_view key, Value value, size_t limit, size_t weight = 1) {
+      auto already = lookup(key);
+      if (already != order.end()) {
+        drop(already);
+      }
+      size_t evicted = 0;
+      while (used + weight > limit && !order.empty()) {
+        drop(std::prev(order.end()));
+        ++evicted;
+      }
+      order.push_front(Entry{std::string(key), std::move(value), weight});
+      byKey.emplace(order.front().key, order.begin());
+      used += weight;
+      return evicted;
+    }
+
+    void drop(Iterator entry) {
+      used -= entry->weight;
+      byKey.erase(entry->key);
+      order.erase(entry);
+    }
+
+    /** drop every entry that @param stale says to, a scan, for filesystem events which are rare compared to lookups. @returns how many went */
+    template<typename Predicate> size_t dropIf(Predicate stale) {
+      size_t dropped = 0;
+      for (auto entry = order.begin(); entry != order.end();) {
+        auto next = std::next(entry);
+        if (stale(*entry)) {
+          drop(entry);
+          ++dropped;
+        }
+        entry = next;
+      }
+      return dropped;
+    }
+
+    /** @returns how many were dropped */
+    size_t clear() {
+      auto dropped = byKey.size();
+      byKey.clear();
+      order.clear();
+      used = 0;
+      return dropped;
+    }
+
+    Iterator end() {
+      return order.end();
+    }
+
+    size_t size() const {
+      return byKey.size();
+    }
+
+    /** the sum of the entries' weights */
+    size_t weight() const {
+      return used;
+    }
+  };
+}
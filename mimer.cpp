@@ -6,6 +6,7 @@
 
 #include "mimer.h"
 
+#include <cctype>
 #include <cstring>
 #include <darkerror.h>
 #include <errno.h>
@@ -56,6 +57,7 @@ static const char *default_extension_map = {
 
 void Mimer::start() {
   if (!fileName) {
+    parse(default_extension_map);
     return;
   }
   DarkHttpd::Fd fd(open(fileName, O_RDONLY));
@@ -67,40 +69,66 @@ void Mimer::start() {
         fileContent = nullptr;
         DarkHttpd::err(errno,"memory mapping mimetype files %s",fileName);
       }
+      parse(std::string_view(fileContent.begin(), fileContent.length));
     }
   } else {
     if (generate) {
       fd = open(fileName, O_REWRITE);
       if (fd.seemsOk()) {
-        write(fd, default_extension_map, sizeof(default_extension_map));
+        write(fd, default_extension_map, strlen(default_extension_map)); //was sizeof the pointer
       }
       fd.close();
       generate = false; //to guarantee no infinite loop as we are about to recurse to map in the defaults. Either that or we spec the 'generate' to terminate the app and make them relaunch it.
       start(); //
+      return;
     }
+    parse(default_extension_map);
   }
   //it is ok to let fd close, the mmap persists until process end or munmap.
 }
 
+void Mimer::parse(std::string_view map) {
+  while (!map.empty()) {
+    auto lineEnd = map.find('\n');
+    auto line = map.substr(0, lineEnd);
+    map.remove_prefix(lineEnd == std::string_view::npos ? map.size() : lineEnd + 1);
+    auto colon = line.find(':');
+    if (colon == std::string_view::npos || line.starts_with('#')) {
+      continue;
+    }
+    std::string type(line.substr(0, colon));
+    line.remove_prefix(colon + 1);
+    while (!line.empty()) {
+      auto gap = line.find_first_of(" \t\r");
+      auto extension = line.substr(0, gap);
+      line.remove_prefix(gap == std::string_view::npos ? line.size() : gap + 1);
+      if (!extension.empty()) {
+        std::string lower(extension);
+        for (auto &c: lower) {
+          c = char(tolower(c));
+        }
+        byExtension.emplace(std::move(lower), type); //first mention wins
+      }
+    }
+  }
+}
+
 void Mimer::finish() {
   munmap(fileContent.pointer, fileContent.length);
 }
 
 const char *Mimer::operator()(const char *url) {
   if (url) {
-    if (auto period = strrchr(url, '.')) {
-      StringView extension = const_cast<char *>(++period);
-      StringView pool = fileContent ? fileContent : StringView(const_cast<char *>(default_extension_map)); //the const_cast seems dangerous, but we will get a segv if we screw up, we will not get a silent bug.
-      ssize_t foundAt = pool.findLast(extension);
-      if (foundAt >= 0) {
-        //todo: idiot check that this extension is not in the middle of any other extension nor inside a mimetype
-        auto mimeEnd = pool.lookBack(foundAt, ':');
-        if (mimeEnd) {
-          auto mimeStart = pool.lookBack(mimeEnd, '\n');
-          if (!mimeStart) {
-            mimeStart = 0;
-          }
-          return pool.subString(mimeStart, mimeEnd);
+    if (auto period = strrchr(url, '.'); period && !strchr(period, '/')) {
+      char lower[16]; //longer than any extension we know
+      size_t length = strlen(++period);
+      if (length < sizeof(lower)) {
+        for (size_t index = 0; index < length; ++index) {
+          lower[index] = char(tolower(period[index]));
+        }
+        auto found = byExtension.find(std::string_view(lower, length));
+        if (found != byExtension.end()) {
+          return found->second.c_str();
         }
       }
     }
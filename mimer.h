@@ -5,8 +5,12 @@
 */
 
 #pragma once
+#include "stringhash.h"
 #include <stringview.h>
 
+#include <string>
+#include <string_view>
+
 
 struct Mimer {
   const char *default_type = nullptr;
@@ -15,6 +19,12 @@ struct Mimer {
   /** file to load mime types map from */
   char *fileName = nullptr;
 
+  /** lower case extension to type, from the file or the defaults. Was a text search per request that never matched. */
+  DarkHttpd::StringMap<std::string> byExtension;
+
+  /** fill byExtension from "type: ext ext" lines */
+  void parse(std::string_view map);
+
   //access the file
   void start();
 
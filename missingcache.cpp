@@ -0,0 +1,57 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+#include "missingcache.h"
+
+using namespace DarkHttpd;
+
+bool MissingCache::find(std::string_view path, int64_t now) {
+  if (!fifo.size()) {
+    return false;
+  }
+  auto found = fifo.lookup(path);
+  if (found == fifo.end()) {
+    return false;
+  }
+  if (found->value < now) {
+    ++stats.invalidated;
+    fifo.drop(found);
+    return false;
+  }
+  ++stats.hits;
+  return true;
+}
+
+void MissingCache::remember(std::string_view path, int64_t expires) {
+  if (!limit) {
+    return;
+  }
+  auto already = fifo.lookup(path); //two connections missed at once
+  if (already != fifo.end()) {
+    already->value = expires;
+    return;
+  }
+  stats.evictions += fifo.insert(path, expires, limit);
+  ++stats.remembered;
+}
+
+void MissingCache::invalidate(std::string_view path, bool andBelow) {
+  if (!andBelow) {
+    auto found = fifo.lookup(path);
+    if (found != fifo.end()) {
+      ++stats.invalidated;
+      fifo.drop(found);
+    }
+    return;
+  }
+  //something appeared at path, which may be a directory that supplies many of our missing paths. A scan, but it is bounded by limit and events are rare compared to requests.
+  stats.invalidated += fifo.dropIf([path](const auto &entry) {
+    return FsWatcher::covers(path, entry.key);
+  });
+}
+
+void MissingCache::invalidateAll() {
+  stats.invalidated += fifo.clear();
+}
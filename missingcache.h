@@ -0,0 +1,47 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+#pragma once
+
+#include "fswatch.h"
+#include "lru.h"
+
+#include <cstdint>
+#include <string_view>
+
+namespace DarkHttpd {
+  /** request paths that recently weren't there, so that scanners probing for /.env or /wp-admin over and over get their 404 without a filesystem call.
+   * Bounded by count, oldest dropped first. Entries go on FsWatcher events, or on a TTL: short where the directory couldn't be watched,
+   * longer where it is, as a path reached through a symlink gets its events under the symlink target's name.
+   */
+  class MissingCache : public FsCache {
+    Lru<int64_t> fifo; //when each path expires, in Ticks. Hits don't count as use, so the oldest goes first.
+
+  public:
+    size_t limit = 4096; //paths, --negative-cache, 0 disables
+    unsigned watchedMs = 60000; //TTL where a directory above the path is watched
+
+    struct Stats {
+      uint64_t hits = 0; //404's given without a filesystem call
+      uint64_t remembered = 0;
+      uint64_t evictions = 0; //for space
+      uint64_t invalidated = 0; //by events or expiry
+    } stats;
+
+    /** @returns whether @param path (relative to wwwroot) was missing and still is as far as we know at @param now */
+    bool find(std::string_view path, int64_t now);
+
+    /** @param path turned out to be missing, believe that until @param expires */
+    void remember(std::string_view path, int64_t expires);
+
+    void invalidate(std::string_view path, bool andBelow) override;
+
+    void invalidateAll() override;
+
+    size_t entries() const {
+      return fifo.size();
+    }
+  };
+}
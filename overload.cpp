@@ -0,0 +1,56 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+#include "overload.h"
+
+#include "ticks.h"
+
+#include <algorithm>
+
+using namespace DarkHttpd;
+
+double Overload::level(unsigned live, unsigned maxConnections, uint64_t pending) const {
+  double worst = 0;
+  if (lagMs) {
+    worst = std::max(worst, double(lag) / (int64_t(lagMs) * Ticks::perMilli));
+  }
+  if (connectionPercent && maxConnections) {
+    worst = std::max(worst, live * 100.0 / (double(maxConnections) * connectionPercent));
+  }
+  if (pendingBytes) {
+    worst = std::max(worst, double(pending) / pendingBytes);
+  }
+  return worst;
+}
+
+bool Overload::update(int64_t now, int64_t busy, unsigned live, unsigned maxConnections, uint64_t pending) {
+  lag += (busy - lag) / 8; //smoothed, one slow wakeup isn't overload
+  stats.worstLag = std::max(stats.worstLag, lag);
+  stats.worstPending = std::max(stats.worstPending, pending);
+  double over = level(live, maxConnections, pending);
+  if (!shedding) {
+    if (over < 1) {
+      return false;
+    }
+    shedding = true;
+    startedShedding = now;
+    calmSince = 0;
+    ++stats.episodes;
+    return true;
+  }
+  if (over >= ResumeFraction) {
+    calmSince = 0;
+    return false;
+  }
+  if (!calmSince) {
+    calmSince = now;
+  }
+  if (now - calmSince < HoldMs * Ticks::perMilli) {
+    return false;
+  }
+  shedding = false;
+  stats.sheddingFor += now - startedShedding;
+  return true;
+}
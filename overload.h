@@ -0,0 +1,50 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+#pragma once
+
+#include <cstdint>
+
+namespace DarkHttpd {
+  /** decides when we are overloaded, from the event loop's lag, live connections against --maxconn, and bytes replies still have to send.
+   * Past any watermark we shed: the Server stops accepting, answers new requests 503 and closes idle keep-alives sooner.
+   * It stops shedding only once all three have been below resumeFraction of their watermarks for holdMs, so that it doesn't flap at the edge.
+   */
+  class Overload {
+  public:
+    unsigned lagMs = 250; //--shed-lag, smoothed time to get through a wakeup's work, 0 ignores lag
+    unsigned connectionPercent = 90; //--shed-connections, of --maxconn, ignored without it
+    uint64_t pendingBytes = 0; //--shed-pending, 0 ignores it
+    unsigned keepAliveSecs = 2; //--shed-keepalive, idle keep-alive timeout while shedding
+
+    static constexpr double ResumeFraction = 0.5;
+    static constexpr int64_t HoldMs = 1000;
+
+    bool shedding = false;
+
+    struct Stats {
+      uint64_t episodes = 0;
+      uint64_t shed = 0; //requests answered 503
+      int64_t sheddingFor = 0; //Ticks, over all episodes
+      int64_t worstLag = 0; //Ticks, smoothed
+      uint64_t worstPending = 0;
+    } stats;
+
+    /** a wakeup took @param busy Ticks to handle, with @param live connections of @param maxConnections (0 when unlimited) and @param pending bytes to send.
+     * @returns whether shedding changed. */
+    bool update(int64_t now, int64_t busy, unsigned live, unsigned maxConnections, uint64_t pending);
+
+    /** ms the loop should sleep at most while shedding, so that it notices the load has gone even when nothing wakes it */
+    static constexpr int64_t RecheckMs = HoldMs / 4;
+
+  private:
+    int64_t lag = 0; //Ticks, smoothed over recent wakeups
+    int64_t calmSince = 0; //when all went below the resume marks, 0 if they aren't
+    int64_t startedShedding = 0;
+
+    /** @returns how far past its watermark the worst of the three is, 1.0 at the mark */
+    double level(unsigned live, unsigned maxConnections, uint64_t pending) const;
+  };
+}
@@ -0,0 +1,108 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+#include "readadvice.h"
+
+#include "darkerror.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+
+using namespace DarkHttpd;
+
+static const char *accessNames[] = {"normal", "sequential", "ahead"};
+
+void ReadAdvice::Rules::operator=(char *arg) {
+  char *equals = strchr(arg, '=');
+  if (!equals) {
+    err(-1, "--read-policy needs match=policy, not `%s'", arg);
+  }
+  Rule rule;
+  if (isdigit(*arg)) {
+    char *suffix;
+    rule.minSize = strtoll(arg, &suffix, 10);
+    switch (toupper(*suffix)) {
+      case 'G':
+        rule.minSize <<= 10;
+        [[fallthrough]];
+      case 'M':
+        rule.minSize <<= 10;
+        [[fallthrough]];
+      case 'K':
+        rule.minSize <<= 10;
+        ++suffix;
+        break;
+    }
+    if (suffix != equals) {
+      err(-1, "--read-policy size `%.*s' should be a number with an optional k, M or G", int(equals - arg), arg);
+    }
+  } else {
+    rule.mimePrefix.assign(arg, equals);
+  }
+  for (char *word = equals + 1; *word;) {
+    size_t length = strcspn(word, "+");
+    bool known = false;
+    for (unsigned index = 0; index < sizeof(accessNames) / sizeof(*accessNames); ++index) {
+      if (strlen(accessNames[index]) == length && strncmp(word, accessNames[index], length) == 0) {
+        rule.policy.access = Policy::Access(index);
+        known = true;
+      }
+    }
+    if (length == 4 && strncmp(word, "drop", 4) == 0) {
+      rule.policy.dropBehind = known = true;
+    }
+    if (!known) {
+      err(-1, "--read-policy knows normal, sequential, ahead and drop, not `%.*s'", int(length), word);
+    }
+    word += length;
+    if (*word) {
+      ++word;
+    }
+  }
+  list.push_back(rule);
+}
+
+ReadAdvice::Policy ReadAdvice::choose(const char *mimetype, off_t size, bool ranged) const {
+  for (auto &rule: rules.list) {
+    if (rule.mimePrefix.empty() ? size >= rule.minSize : mimetype && strncmp(mimetype, rule.mimePrefix.c_str(), rule.mimePrefix.size()) == 0) {
+      return rule.policy;
+    }
+  }
+  Policy policy;
+  policy.access = ranged ? Policy::Ahead : Policy::Sequential;
+  policy.dropBehind = dropBehindAbove && size >= dropBehindAbove;
+  return policy;
+}
+
+void ReadAdvice::start(Cursor &cursor, Policy policy, int fd, off_t begin) {
+  cursor.policy = policy;
+  cursor.hinted = begin;
+  cursor.dropped = begin & ~(HintStep - 1);
+  if (policy.access == Policy::Sequential) {
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL); //per open file, the shared index files get it too which is what they'd want anyway
+    ++stats.sequential;
+  }
+}
+
+void ReadAdvice::advance(Cursor &cursor, int fd, off_t begin, off_t end) {
+  if (cursor.policy.access == Policy::Ahead && begin + HintStep > cursor.hinted && cursor.hinted < end) {
+    off_t from = std::max(begin, cursor.hinted);
+    off_t to = std::min(begin + AheadWindow, end);
+    posix_fadvise(fd, from, to - from, POSIX_FADV_WILLNEED);
+    cursor.hinted = to;
+    ++stats.ahead;
+  }
+  if (cursor.policy.dropBehind) {
+    off_t behind = begin >= end ? end : begin & ~(HintStep - 1); //whole steps, and all of it at the end
+    if (behind > cursor.dropped && (behind - cursor.dropped >= HintStep || behind == end)) {
+      posix_fadvise(fd, cursor.dropped, behind - cursor.dropped, POSIX_FADV_DONTNEED);
+      cursor.dropped = behind;
+      ++stats.dropped;
+    }
+  }
+}
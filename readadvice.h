@@ -0,0 +1,72 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+namespace DarkHttpd {
+  /** posix_fadvise hints for the files we send, chosen per reply by mime type and size, applied as the send cursor moves.
+   * Whole downloads get SEQUENTIAL so the kernel's readahead grows, ranged ones (video seeking) get WILLNEED windows just ahead of where they are reading,
+   * and very large files can drop what is behind the cursor so that one big download doesn't push the small hot files out of the page cache.
+   */
+  class ReadAdvice {
+  public:
+    struct Policy {
+      enum Access {
+        Normal = 0, //no hint at all
+        Sequential,
+        Ahead, //WILLNEED ahead of the cursor
+      } access = Normal;
+      bool dropBehind = false;
+    };
+
+    /** per reply progress of the hints */
+    struct Cursor {
+      Policy policy;
+      off_t hinted = 0; //WILLNEED issued up to here
+      off_t dropped = 0; //DONTNEED issued below here
+    };
+
+    /** how far ahead of the cursor WILLNEED reaches */
+    static constexpr off_t AheadWindow = 4 << 20;
+    /** the cursor moves this far between hints, so a hint costs a syscall per MiB or so rather than per send */
+    static constexpr off_t HintStep = 1 << 20;
+
+    /** --read-policy rules, first match wins, else the built in choice */
+    struct Rules {
+      struct Rule {
+        std::string mimePrefix; //empty when matching on size
+        off_t minSize = 0;
+        Policy policy;
+      };
+
+      std::vector<Rule> list;
+
+      /** from cli, "video/=ahead", "64M=sequential+drop". Bad ones are fatal. */
+      void operator=(char *arg);
+    } rules;
+
+    off_t dropBehindAbove = 0; //--drop-behind, files at least this large drop behind the cursor by default, 0 never
+
+    struct Stats {
+      uint64_t sequential = 0; //replies that got SEQUENTIAL
+      uint64_t ahead = 0; //WILLNEED windows issued
+      uint64_t dropped = 0; //DONTNEED calls
+    } stats;
+
+    /** the policy for a reply of @param mimetype, from a file of @param size, @param ranged if the client asked for part of it */
+    Policy choose(const char *mimetype, off_t size, bool ranged) const;
+
+    /** begin sending @param fd from @param begin under @param policy */
+    void start(Cursor &cursor, Policy policy, int fd, off_t begin);
+
+    /** the send cursor is now at @param begin of a range ending at @param end */
+    void advance(Cursor &cursor, int fd, off_t begin, off_t end);
+  };
+}
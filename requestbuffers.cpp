@@ -0,0 +1,63 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+#include "requestbuffers.h"
+
+#include <algorithm>
+
+using namespace DarkHttpd;
+
+unsigned RequestBuffers::classFor(size_t size) {
+  unsigned which = 0;
+  while ((Smallest << which) < size) {
+    ++which;
+  }
+  return which;
+}
+
+char *RequestBuffers::take(size_t wanted, size_t &size) {
+  if (wanted > std::min(limit, Largest)) {
+    return nullptr;
+  }
+  auto which = classFor(wanted);
+  size = std::min(Smallest << which, limit);
+  char *buffer;
+  if (!idle[which].empty()) {
+    buffer = idle[which].back();
+    idle[which].pop_back();
+  } else {
+    buffer = new char[(Smallest << which) + 1/*for null terminator */];
+    ++stats.allocated;
+  }
+  ++stats.taken[which];
+  stats.mostInUse = std::max(stats.mostInUse, ++stats.inUse);
+  return buffer;
+}
+
+void RequestBuffers::give(char *buffer, size_t size) {
+  --stats.inUse;
+  auto &list = idle[classFor(size)];
+  if (list.size() < keep) {
+    list.push_back(buffer);
+  } else {
+    delete[] buffer;
+  }
+}
+
+size_t RequestBuffers::idleCount() const {
+  size_t count = 0;
+  for (auto &list: idle) {
+    count += list.size();
+  }
+  return count;
+}
+
+RequestBuffers::~RequestBuffers() {
+  for (auto &list: idle) {
+    for (auto buffer: list) {
+      delete[] buffer;
+    }
+  }
+}
@@ -0,0 +1,50 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace DarkHttpd {
+  /** larger request buffers, for the few requests whose header outgrows the one inline in each Connection, big cookies and long query strings.
+   * Sizes are powers of two from Smallest, kept on a free list per size once returned so that a steady trickle of big requests doesn't allocate.
+   */
+  class RequestBuffers {
+  public:
+    static constexpr size_t Smallest = 4096;
+    static constexpr unsigned Classes = 5; //4K through 64K
+    static constexpr size_t Largest = Smallest << (Classes - 1);
+
+    size_t limit = 16384; //--max-request-header, most a request header may take, up to Largest
+    unsigned keep = 32; //idle buffers kept per size, more are freed
+
+    struct Stats {
+      uint64_t promoted = 0; //requests that outgrew the inline buffer
+      uint64_t taken[Classes] = {};
+      uint64_t allocated = 0; //taken with none idle
+      uint64_t tooLong = 0; //answered 413, 414 or 431
+      unsigned inUse = 0;
+      unsigned mostInUse = 0;
+    } stats;
+
+    /** @returns a buffer with room for @param wanted bytes and a null, whose room is put in @param size. Null when wanted is over the limit. */
+    char *take(size_t wanted, size_t &size);
+
+    /** return @param buffer, @param size is what take gave for it */
+    void give(char *buffer, size_t size);
+
+    /** @returns how many are sitting idle */
+    size_t idleCount() const;
+
+    ~RequestBuffers();
+
+  private:
+    std::vector<char *> idle[Classes];
+
+    static unsigned classFor(size_t size);
+  };
+}
@@ -0,0 +1,142 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+#include "resolver.h"
+
+#include "darkerror.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#if __has_include(<linux/openat2.h>)
+#include <linux/openat2.h>
+#else
+struct open_how {
+  uint64_t flags;
+  uint64_t mode;
+  uint64_t resolve;
+};
+#define RESOLVE_NO_MAGICLINKS 0x02
+#define RESOLVE_NO_SYMLINKS 0x04
+#define RESOLVE_BENEATH 0x08
+#endif
+
+#ifndef SYS_openat2
+#define SYS_openat2 437 //same number on every architecture
+#endif
+
+using namespace DarkHttpd;
+
+static const char *policyNames[] = {"beneath", "any", "none"};
+
+const char *Resolver::SymlinkPolicy::name() const {
+  return policyNames[policy];
+}
+
+void Resolver::SymlinkPolicy::operator=(char *arg) {
+  for (unsigned index = sizeof(policyNames) / sizeof(*policyNames); index-- > 0;) {
+    if (strcmp(arg, policyNames[index]) == 0) {
+      policy = decltype(policy)(index);
+      return;
+    }
+  }
+  err(-1, "--symlinks must be one of beneath, any or none, not `%s'", arg);
+}
+
+bool Resolver::begin(const char *wwwroot) {
+  root = ::open(wwwroot, O_PATH | O_DIRECTORY | O_CLOEXEC);
+  if (!root.seemsOk()) {
+    return err(errno, "opening wwwroot %s", wwwroot);
+  }
+  return true;
+}
+
+int Resolver::openIn(int dirfd, const char *relative, int flags) const {
+  if (!*relative) {
+    relative = "."; //the root itself
+  }
+  flags |= O_CLOEXEC;
+  if (haveOpenat2) {
+    open_how how;
+    memset(&how, 0, sizeof(how));
+    how.flags = flags;
+    how.resolve = RESOLVE_NO_MAGICLINKS; // /proc/self/fd/n and friends are never content
+    switch (symlinks.policy) {
+      case SymlinkPolicy::Beneath:
+        how.resolve |= RESOLVE_BENEATH;
+        break;
+      case SymlinkPolicy::None:
+        how.resolve |= RESOLVE_BENEATH | RESOLVE_NO_SYMLINKS;
+        break;
+      case SymlinkPolicy::Any:
+        break;
+    }
+    long fd = syscall(SYS_openat2, dirfd, relative, &how, sizeof(how));
+    if (fd != -1 || errno != ENOSYS) {
+      return int(fd);
+    }
+    haveOpenat2 = false; //old kernel, don't keep asking
+  }
+  if (symlinks.policy == SymlinkPolicy::Any) {
+    return openat(dirfd, relative, flags);
+  }
+  return walk(dirfd, relative, flags);
+}
+
+/* O_NOFOLLOW on a link is ENOTDIR when O_DIRECTORY is asked for, and ELOOP otherwise, while ENOTDIR also means a file where a directory was expected.
+ * @returns errno as openat2 would give it for @param component in @param dirfd, ELOOP for a link so that the reply doesn't depend on the kernel.
+ */
+static int refusal(int dirfd, const char *component, int error) {
+  struct stat info;
+  if ((error == ENOTDIR || error == ELOOP) && fstatat(dirfd, component, &info, AT_SYMLINK_NOFOLLOW) == 0 && S_ISLNK(info.st_mode)) {
+    return ELOOP;
+  }
+  return error;
+}
+
+/* Without openat2 we can't follow a link and check where it went, so both beneath and none refuse symlinks here.
+ * The url has been normalized so there are no ".." components, each component is opened without following links.
+ */
+int Resolver::walk(int dirfd, const char *relative, int flags) const {
+  char path[FILENAME_MAX];
+  if (strlen(relative) >= sizeof(path)) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+  strcpy(path, relative);
+  int current = dirfd;
+  char *component = path;
+  while (char *slash = strchr(component, '/')) {
+    *slash = 0;
+    int next = openat(current, component, O_PATH | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (next == -1) {
+      int error = refusal(current, component, errno);
+      if (current != dirfd) {
+        ::close(current);
+      }
+      errno = error;
+      return -1;
+    }
+    if (current != dirfd) {
+      ::close(current);
+    }
+    current = next;
+    component = slash + 1;
+  }
+  const char *leaf = *component ? component : ".";
+  int fd = openat(current, leaf, flags | O_NOFOLLOW);
+  int error = fd == -1 ? refusal(current, leaf, errno) : errno;
+  if (current != dirfd) {
+    ::close(current);
+  }
+  errno = error;
+  return fd;
+}
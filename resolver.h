@@ -0,0 +1,51 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+#pragma once
+
+#include "fd.h"
+
+namespace DarkHttpd {
+  /** turns request paths into open files, relative to a directory fd held on wwwroot so that we neither chdir nor need chroot for containment.
+   * Uses openat2 with RESOLVE_BENEATH where the kernel has it (5.6+), else walks the path with openat a component at a time.
+   */
+  class Resolver {
+    Fd root; //O_PATH to wwwroot
+    mutable bool haveOpenat2 = true; //cleared the first time the kernel says ENOSYS
+
+    int walk(int dirfd, const char *relative, int flags) const;
+
+  public:
+    /** what to do with symbolic links found while resolving a request */
+    struct SymlinkPolicy {
+      enum {
+        Beneath = 0, //follow them as long as they stay inside wwwroot, the default
+        Any, //follow them anywhere, as the server did before this class existed
+        None, //refuse any path that has one
+      } policy = Beneath;
+
+      const char *name() const;
+
+      /** from cli, unknown names are fatal */
+      void operator=(char *arg);
+    } symlinks;
+
+    /** open @param wwwroot for resolving against. */
+    bool begin(const char *wwwroot);
+
+    /** @returns fd of @param relative (no leading slash, already normalized) opened with @param flags, or -1 with errno set.
+     * ELOOP or EXDEV mean the symlink policy refused it. */
+    int open(const char *relative, int flags) const {
+      return openIn(root, relative, flags);
+    }
+
+    /** @returns fd of @param relative resolved from @param dirfd, which must itself have come from this resolver. Used for the index file of a directory we already have open. */
+    int openIn(int dirfd, const char *relative, int flags) const;
+
+    void finish() {
+      root.close();
+    }
+  };
+}
@@ -0,0 +1,42 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+#include "sendscheduler.h"
+
+#include <algorithm>
+
+using namespace DarkHttpd;
+
+void SendScheduler::defer(EpollHandler &handler) {
+  waiting.push_back(&handler);
+  ++stats.deferred;
+  stats.longest = std::max(stats.longest, waiting.size());
+}
+
+void SendScheduler::cancel(EpollHandler &handler) {
+  auto found = std::find(waiting.begin(), waiting.end(), &handler);
+  if (found != waiting.end()) {
+    waiting.erase(found);
+  }
+}
+
+bool SendScheduler::round() {
+  size_t turns = waiting.size(); //not those that go back in line during this round
+  if (!turns) {
+    return false;
+  }
+  ++stats.rounds;
+  while (turns--) {
+    auto handler = waiting.front();
+    waiting.pop_front();
+    handler->onEpoll(EPOLLOUT);
+  }
+  return true;
+}
+
+void SendScheduler::record(uint64_t sent, int64_t took, unsigned deferrals) {
+  (sent <= allowance() ? stats.small : stats.large).record(uint64_t(std::max(took, int64_t(0))));
+  stats.deferredMost = std::max(stats.deferredMost, uint64_t(deferrals));
+}
@@ -0,0 +1,58 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+#pragma once
+
+#include "epoller.h"
+#include "latencyhistogram.h"
+
+#include <cstdint>
+#include <deque>
+#include <limits>
+
+namespace DarkHttpd {
+  /** round robin among the connections with more to send than one turn allows.
+   * Each turn a connection may send quantum bytes, one that uses it all while the socket would still take more is put at the back of the line rather than waiting on EPOLLOUT,
+   * and each pass of the event loop gives everyone in line one more turn. So a large download on a fast client moves quantum bytes per pass instead of its whole range,
+   * and a small reply, which finishes within its first turn, waits for at most one turn of each of the large ones.
+   */
+  class SendScheduler {
+    std::deque<EpollHandler *> waiting;
+
+  public:
+    size_t quantum = 256 << 10; //--send-quantum, 0 for unlimited turns
+
+    struct Stats {
+      uint64_t deferred = 0; //turns that ended with the allowance spent
+      uint64_t rounds = 0; //passes that gave someone a turn
+      size_t longest = 0; //most waiting at once
+      uint64_t deferredMost = 0; //most turns one reply took
+      LatencyHistogram small; //request to last byte, for replies that fit in one turn
+      LatencyHistogram large; //and for the rest
+    } stats;
+
+    /** bytes a connection may send in a turn */
+    size_t allowance() const {
+      return quantum ? quantum : std::numeric_limits<size_t>::max();
+    }
+
+    /** @param handler has spent its allowance, its onEpoll(EPOLLOUT) is called in the next round */
+    void defer(EpollHandler &handler);
+
+    /** @param handler is going away or onto another request */
+    void cancel(EpollHandler &handler);
+
+    /** whether someone is waiting, in which case the event loop shouldn't sleep */
+    bool pending() const {
+      return !waiting.empty();
+    }
+
+    /** give each of those waiting at the start a turn, any that spend it again go to the back for the next round. @returns whether there were any. */
+    bool round();
+
+    /** a reply of @param sent bytes that took @param took Ticks from request to last byte, and was deferred @param deferrals times */
+    void record(uint64_t sent, int64_t took, unsigned deferrals);
+  };
+}
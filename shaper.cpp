@@ -0,0 +1,153 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+#include "shaper.h"
+
+#include "darkerror.h"
+#include "fswatch.h"
+#include "ticks.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+using namespace DarkHttpd;
+
+double Shaper::Bucket::burst() const {
+  return std::max(rate * BurstMs / 1000, MinSend);
+}
+
+void Shaper::Bucket::refill(int64_t now) {
+  if (now > stamp) {
+    tokens = std::min(tokens + rate * Ticks::seconds(now - stamp), burst());
+    stamp = now;
+  }
+}
+
+void Shaper::Bucket::setRate(double bytesPerSecond) {
+  rate = bytesPerSecond;
+  tokens = burst();
+  stamp = Ticks::now();
+}
+
+double Shaper::parseRate(const char *text, const char *what) {
+  char *suffix;
+  double rate = strtod(text, &suffix);
+  switch (toupper(*suffix)) {
+    case 'G':
+      rate *= 1024;
+      [[fallthrough]];
+    case 'M':
+      rate *= 1024;
+      [[fallthrough]];
+    case 'K':
+      rate *= 1024;
+      ++suffix;
+      break;
+  }
+  if (suffix == text || *suffix || rate < 0) {
+    err(-1, "%s `%s' should be bytes per second with an optional k, M or G", what, text);
+  }
+  return rate;
+}
+
+void Shaper::PathRules::operator=(char *arg) {
+  char *equals = strrchr(arg, '=');
+  if (!equals) {
+    err(-1, "--rate-path needs prefix=rate, not `%s'", arg);
+  }
+  std::string_view prefix(arg, equals - arg);
+  while (prefix.starts_with('/')) {
+    prefix.remove_prefix(1);
+  }
+  while (prefix.ends_with('/')) {
+    prefix.remove_suffix(1);
+  }
+  Rule rule;
+  rule.prefix = prefix;
+  rule.bucket.setRate(parseRate(equals + 1, "--rate-path"));
+  list.push_back(rule);
+}
+
+Shaper::Grant Shaper::assign(std::string_view client, std::string_view relative, int64_t now) {
+  Grant grant;
+  if (perClient > 0) {
+    auto found = byClient.find(client);
+    if (found == byClient.end()) {
+      if (byClient.size() >= clientLimit) {
+        sweep(now);
+      }
+      found = byClient.emplace(client, Bucket{}).first;
+      found->second.setRate(perClient);
+    }
+    grant.client = &found->second;
+    ++grant.client->users;
+  }
+  for (auto &rule: paths.list) { //first match, so list the narrower prefixes first
+    if (FsWatcher::covers(rule.prefix, relative)) {
+      grant.path = &rule.bucket;
+      break;
+    }
+  }
+  return grant;
+}
+
+void Shaper::release(Grant &grant) {
+  if (grant.client) {
+    --grant.client->users;
+  }
+  grant = {};
+}
+
+void Shaper::sweep(int64_t now) {
+  for (auto it = byClient.begin(); it != byClient.end();) {
+    it->second.refill(now);
+    if (!it->second.users && it->second.tokens >= it->second.burst()) { //a full bucket is what a new one would be, so nothing is lost
+      it = byClient.erase(it);
+      ++stats.swept;
+    } else {
+      ++it;
+    }
+  }
+}
+
+size_t Shaper::allow(const Grant &grant, size_t wanted, int64_t now, int64_t &wake) {
+  Bucket *buckets[] = {&global, grant.client, grant.path};
+  double may = double(wanted);
+  double need = std::min(double(wanted), MinSend);
+  double waitFor = 0; //seconds
+  for (auto bucket: buckets) {
+    if (!bucket || bucket->rate <= 0) {
+      continue;
+    }
+    bucket->refill(now);
+    may = std::min(may, bucket->tokens);
+    if (bucket->tokens < need) {
+      waitFor = std::max(waitFor, (std::min(need, bucket->burst()) - bucket->tokens) / bucket->rate);
+    }
+  }
+  if (waitFor > 0) {
+    wake = now + int64_t(waitFor * Ticks::perSecond) + 1;
+    ++stats.throttled;
+    stats.parked += wake - now;
+    return 0;
+  }
+  return size_t(may);
+}
+
+void Shaper::spend(const Grant &grant, size_t sent) {
+  Bucket *buckets[] = {&global, grant.client, grant.path};
+  bool limited = false;
+  for (auto bucket: buckets) {
+    if (bucket && bucket->rate > 0) {
+      bucket->tokens -= sent;
+      limited = true;
+    }
+  }
+  if (limited) {
+    stats.shaped += sent;
+  }
+}
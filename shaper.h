@@ -0,0 +1,98 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+#pragma once
+
+#include "stringhash.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace DarkHttpd {
+  /** egress rate limits, so that a box sharing its uplink can cap us without tc.
+   * Token buckets at three levels, all of which a send must fit: the whole server, each client address, and each --rate-path prefix (shared by everyone fetching under it).
+   * A connection that finds too few tokens is told when there will be enough, and parks on the TimerHeap until then.
+   */
+  class Shaper {
+  public:
+    struct Bucket {
+      double rate = 0; //bytes per second, 0 for unlimited
+      double tokens = 0;
+      int64_t stamp = 0; //Ticks tokens was last brought up to date
+      unsigned users = 0; //replies holding it, a client's bucket is only forgotten when none
+
+      /** the most tokens can grow to, what an idle client may send at once */
+      double burst() const;
+
+      void refill(int64_t now);
+
+      void setRate(double bytesPerSecond);
+    };
+
+    /** the buckets a reply is charged to */
+    struct Grant {
+      Bucket *client = nullptr;
+      Bucket *path = nullptr;
+    };
+
+    /** a burst is this much time at the rate */
+    static constexpr int64_t BurstMs = 100;
+    /** but at least this many bytes, and a parked connection waits for this many (or all it has left) rather than waking for a few */
+    static constexpr double MinSend = 16 << 10;
+
+    Bucket global; //--rate-limit
+    double perClient = 0; //--rate-per-client
+    size_t clientLimit = 4096; //idle client buckets kept beyond this are swept
+
+    /** --rate-path rules */
+    struct PathRules {
+      struct Rule {
+        std::string prefix; //relative to wwwroot, without leading slash
+        Bucket bucket;
+      };
+
+      std::vector<Rule> list;
+
+      /** from cli, "prefix=rate", rate in bytes per second with an optional k, M or G. Bad ones are fatal. */
+      void operator=(char *arg);
+    } paths;
+
+    struct Stats {
+      uint64_t throttled = 0; //sends put off for lack of tokens
+      int64_t parked = 0; //Ticks they were put off for, as scheduled
+      uint64_t shaped = 0; //bytes sent under a limit
+      uint64_t swept = 0; //idle client buckets forgotten
+    } stats;
+
+    /** from cli, bytes per second with an optional k, M or G. Bad ones are fatal. */
+    static double parseRate(const char *text, const char *what);
+
+    /** whether any limit is set */
+    bool enabled() const {
+      return global.rate > 0 || perClient > 0 || !paths.list.empty();
+    }
+
+    /** the buckets for a reply to @param client (the raw address bytes) of @param relative, give it back with release */
+    Grant assign(std::string_view client, std::string_view relative, int64_t now);
+
+    void release(Grant &grant);
+
+    /** @returns how much of @param wanted may be sent now, 0 with @param wake set to the Ticks when it is worth trying again */
+    size_t allow(const Grant &grant, size_t wanted, int64_t now, int64_t &wake);
+
+    void spend(const Grant &grant, size_t sent);
+
+    size_t clients() const {
+      return byClient.size();
+    }
+
+  private:
+    StringMap<Bucket> byClient;
+
+    void sweep(int64_t now);
+  };
+}
@@ -0,0 +1,140 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+#include "slowclient.h"
+
+#include "ticks.h"
+
+#include <cerrno>
+#include <cstring>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+static const char *modeNames[] = {"trickle", "slowread", "stall", "halfclose"};
+
+const char *SlowClient::modeName(Mode mode) {
+  return modeNames[mode];
+}
+
+bool SlowClient::parseMode(const char *name, Mode &mode) {
+  for (unsigned index = sizeof(modeNames) / sizeof(*modeNames); index-- > 0;) {
+    if (strcmp(name, modeNames[index]) == 0) {
+      mode = Mode(index);
+      return true;
+    }
+  }
+  return false;
+}
+
+SlowClient::SlowClient(LoadEpoller &epoller, const LoadTarget &target, Driver &driver, LoadStats &stats, Mode mode): LoadClient(epoller, target, driver, stats), mode{mode} {}
+
+bool SlowClient::open() {
+  openedAt = lastRefill = Ticks::now();
+  readBudget = 0;
+  readSoFar = 0;
+  throttled = false;
+  writeShut = false;
+  if (!LoadClient::open()) {
+    return false;
+  }
+  if (mode == SlowRead || mode == HalfClose) {
+    int tiny = 2048; //so that the server's sends back up instead of being absorbed by our kernel
+    setsockopt(socket, SOL_SOCKET, SO_RCVBUF, &tiny, sizeof(tiny));
+  }
+  return true;
+}
+
+bool SlowClient::flush() {
+  switch (mode) {
+    case Trickle:
+      if (isConnected()) {
+        nextByte = Ticks::now(); //tick() takes it from here
+        listenFor(EPOLLIN | EPOLLRDHUP);
+      }
+      return true;
+    case HalfClose:
+      if (!LoadClient::flush()) {
+        return false;
+      }
+      if (isConnected() && outTail == 0 && dueCount && !writeShut) {
+        shutdown(socket, SHUT_WR);
+        writeShut = true;
+      }
+      return true;
+    default:
+      return LoadClient::flush();
+  }
+}
+
+void SlowClient::refill(int64_t now) {
+  readBudget += double(readRate) * (now - lastRefill) / Ticks::perSecond;
+  if (readBudget > readRate) {
+    readBudget = readRate; //at most a second's worth of burst
+  }
+  lastRefill = now;
+}
+
+void SlowClient::tick(int64_t now) {
+  if (!isConnected()) {
+    return;
+  }
+  switch (mode) {
+    case Trickle:
+      if (outHead < outTail && now >= nextByte) {
+        auto sent = send(socket, outbox + outHead, 1, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (sent == 1) {
+          ++stats->bytesOut;
+          if (++outHead == outTail) {
+            outHead = outTail = 0;
+          }
+        } else if (sent == -1 && errno != EAGAIN) {
+          fail();
+          driver.onCapacity(*this);
+          return;
+        }
+        nextByte = now + trickleInterval;
+      }
+      break;
+    case SlowRead:
+    case HalfClose:
+      refill(now);
+      if (throttled && readBudget >= 1) {
+        throttled = false;
+        listenFor(EPOLLIN | EPOLLRDHUP);
+      }
+      break;
+    case Stall:
+      break;
+  }
+}
+
+void SlowClient::onReadable() {
+  switch (mode) {
+    case Trickle:
+      receive();
+      return;
+    case Stall:
+      if (readSoFar >= stallAfter) { //only hangups get here once stalled
+        fail();
+        driver.onCapacity(*this);
+        return;
+      }
+      readSoFar += receive(stallAfter - readSoFar);
+      if (isConnected() && readSoFar >= stallAfter) {
+        listenFor(EPOLLRDHUP);
+      }
+      return;
+    case SlowRead:
+    case HalfClose:
+      refill(Ticks::now());
+      if (readBudget < 1) {
+        throttled = true;
+        listenFor(0); //tick() will turn us back on, a hangup will be noticed then.
+        return;
+      }
+      readBudget -= receive(size_t(readBudget));
+      return;
+  }
+}
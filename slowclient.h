@@ -0,0 +1,57 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+#pragma once
+
+#include "loadclient.h"
+
+/** a client that misbehaves in one of the ways real slow or hostile clients do, to see what it costs everyone else */
+class SlowClient : public LoadClient {
+public:
+  enum Mode {
+    Trickle, //slowloris: request header goes out one byte per trickleInterval
+    SlowRead, //reads the reply at readRate bytes per second, through a tiny receive buffer
+    Stall, //reads stallAfter bytes of reply then never reads again
+    HalfClose, //shuts down its sending side after the request, then reads slowly
+  };
+
+  static const char *modeName(Mode mode);
+
+  /** @returns mode matching @param name, or false if none does */
+  static bool parseMode(const char *name, Mode &mode);
+
+  Mode mode;
+  int64_t trickleInterval = 1000 * 1000000LL; //ns between header bytes
+  unsigned readRate = 1024; //bytes per second
+  size_t stallAfter = 4096;
+  int64_t openedAt = 0; //so the driver can see how long the server put up with us
+
+protected:
+  int64_t nextByte = 0; //trickle schedule
+  int64_t lastRefill = 0; //readRate token bucket
+  double readBudget = 0;
+  size_t readSoFar = 0;
+  bool throttled = false; //not reading until tick refills the budget
+  bool writeShut = false;
+
+  bool flush() override;
+
+  void onReadable() override;
+
+  void refill(int64_t now);
+
+public:
+  SlowClient(LoadEpoller &epoller, const LoadTarget &target, Driver &driver, LoadStats &stats, Mode mode);
+
+  bool open();
+
+  /** the harness calls this every loop so that trickling and throttled reads proceed */
+  void tick(int64_t now);
+
+  /** a half closed connection can't carry another request */
+  bool reusable() const {
+    return isConnected() && !writeShut;
+  }
+};
@@ -0,0 +1,113 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+#include "statpool.h"
+
+#include "darkerror.h"
+#include "ticks.h"
+
+#include <algorithm>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+using namespace DarkHttpd;
+
+int StatPool::begin() {
+  if (!threads) {
+    return -1;
+  }
+  doneSignal = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (!doneSignal.seemsOk()) {
+    warn("eventfd, statting listings from the event loop");
+    return -1;
+  }
+  for (unsigned count = threads; count-- > 0;) {
+    workers.emplace_back([this](std::stop_token stop) {
+      work(stop);
+    });
+  }
+  return doneSignal;
+}
+
+void StatPool::finish() {
+  workers.clear(); //jthread asks each to stop, and joins it
+  queue.clear();
+  done.clear();
+  doneSignal.close();
+}
+
+std::shared_ptr<const StatPool::Batch> StatPool::stat(IoWaiter &waiter, unsigned ticket, const std::shared_ptr<DirectoryListing> &list, size_t first, size_t pastEnd, bool typesOnly) {
+  if (!enabled() || first >= pastEnd) {
+    return nullptr;
+  }
+  auto batch = std::make_shared<Batch>(Batch{list, first, pastEnd, (pastEnd - first + threads - 1) / threads, typesOnly, 0, &waiter, ticket});
+  ++stats.batches;
+  stats.entries += pastEnd - first;
+  {
+    std::lock_guard guard(lock);
+    queue.push_back(batch);
+  }
+  wake.notify_all(); //one share each
+  return batch;
+}
+
+void StatPool::work(std::stop_token stop) {
+  while (true) {
+    std::shared_ptr<Batch> batch;
+    size_t first;
+    size_t pastEnd;
+    {
+      std::unique_lock guard(lock);
+      if (!wake.wait(guard, stop, [this] {
+        return !queue.empty();
+      })) {
+        return; //asked to stop
+      }
+      batch = queue.front();
+      first = batch->next;
+      pastEnd = std::min(batch->pastEnd, first + batch->share);
+      batch->next = pastEnd;
+      ++batch->working;
+      if (pastEnd == batch->pastEnd) {
+        queue.pop_front(); //all of it taken
+      }
+    }
+    auto started = Ticks::now();
+    batch->list->stat(first, pastEnd, batch->typesOnly); //entries that no other share touches
+    auto took = Ticks::now() - started;
+    bool last;
+    {
+      std::lock_guard guard(lock);
+      batch->took += took;
+      last = --batch->working == 0 && batch->next == batch->pastEnd;
+      if (last) {
+        done.push_back(batch);
+      }
+    }
+    if (last) {
+      uint64_t one = 1;
+      if (write(doneSignal, &one, sizeof(one)) == -1) {
+        //counter overflow is the only failure and can't happen at our rates
+      }
+    }
+  }
+}
+
+void StatPool::onEpoll(unsigned epoll_flags unused) {
+  uint64_t count;
+  if (::read(doneSignal, &count, sizeof(count)) == -1) {
+    //EAGAIN, a previous wakeup took them all
+  }
+  std::deque<std::shared_ptr<Batch>> finished;
+  {
+    std::lock_guard guard(lock);
+    finished.swap(done);
+  }
+  for (auto &batch: finished) {
+    stats.stalled += batch->took;
+    batch->delivered = true;
+    batch->waiter->loaded(batch->ticket, nullptr, 0);
+  }
+}
@@ -0,0 +1,76 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+#pragma once
+
+#include "directorylisting.h"
+#include "fd.h"
+#include "iopool.h"
+
+#include "epoller.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace DarkHttpd {
+  /** statx for large directory listings on threads started once, which matters on NFS where each one is a round trip.
+   * A range of entries is split into shares that whichever worker is free takes, and the waiter is called back through the Epoller when the last one is done, as IoPool does.
+   */
+  class StatPool : public EpollHandler {
+  public:
+    struct Batch {
+      std::shared_ptr<DirectoryListing> list; //the workers' own reference, the listing's owner may be gone before they are done
+      size_t next; //first entry no worker has taken yet
+      size_t pastEnd;
+      size_t share;
+      bool typesOnly;
+      unsigned working = 0; //shares taken and not yet finished
+      IoWaiter *waiter;
+      unsigned ticket;
+      int64_t took = 0; //Ticks the workers spent, which the loop would have otherwise
+      bool delivered = false; //set on the loop as the waiter is called
+    };
+
+  private:
+    std::mutex lock;
+    std::condition_variable_any wake;
+    std::deque<std::shared_ptr<Batch>> queue; //with shares not yet taken
+    std::deque<std::shared_ptr<Batch>> done;
+    std::vector<std::jthread> workers;
+    Fd doneSignal; //eventfd, given to the Epoller
+
+    void work(std::stop_token stop);
+
+  public:
+    unsigned threads = 2; //as many as --io-threads, 0 stats on the loop
+
+    struct Stats {
+      uint64_t batches = 0;
+      uint64_t entries = 0;
+      int64_t stalled = 0; //Ticks the workers spent statting
+    } stats;
+
+    /** start the workers, @returns the fd for the caller to give to its Epoller, -1 when disabled. */
+    int begin();
+
+    /** stop and join the workers, forgetting anything not yet delivered */
+    void finish();
+
+    bool enabled() const {
+      return !workers.empty();
+    }
+
+    /** stat @param list 's entries [first, pastEnd) on the workers, then call @param waiter back with @param ticket and a null buffer.
+     * @returns the batch, whose delivered says it is done, null if disabled, in which case stat inline. */
+    std::shared_ptr<const Batch> stat(IoWaiter &waiter, unsigned ticket, const std::shared_ptr<DirectoryListing> &list, size_t first, size_t pastEnd, bool typesOnly = false);
+
+    /** workers have finished some batches */
+    void onEpoll(unsigned epoll_flags) override;
+  };
+}
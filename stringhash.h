@@ -0,0 +1,24 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+#pragma once
+
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace DarkHttpd {
+  /** transparent, so that a lookup with a string_view doesn't build a std::string */
+  struct StringHash : std::hash<std::string_view> {
+    using is_transparent = void;
+  };
+
+  /** std::string keys that can be found with a string_view */
+  template<typename Value> using StringMap = std::unordered_map<std::string, Value, StringHash, std::equal_to<>>;
+
+  using StringSet = std::unordered_set<std::string, StringHash, std::equal_to<>>;
+}
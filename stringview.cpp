@@ -19,7 +19,7 @@ StringView::StringView(char *pointer, size_t length, size_t start): pointer{poin
 
 StringView &StringView::operator=(char *str) {
   pointer = str;
-  length = strlen(str);
+  length = str ? strlen(str) : 0; //clearing with nullptr is common
   start = 0;
   return *this;
 }
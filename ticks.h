@@ -0,0 +1,33 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+#pragma once
+#include <cstdint>
+#include <ctime>
+
+/** monotonic clock in integer nanoseconds. For measuring intervals, see Now for times that humans get to read. */
+struct Ticks {
+  static constexpr int64_t perSecond = 1000000000;
+  static constexpr int64_t perMilli = 1000000;
+
+  static int64_t read(clockid_t which) {
+    timespec ts;
+    clock_gettime(which, &ts);
+    return int64_t(ts.tv_sec) * perSecond + ts.tv_nsec;
+  }
+
+  static int64_t now() {
+    return read(CLOCK_MONOTONIC);
+  }
+
+  /** cpu time consumed by the calling thread, for attributing cost to sections of an event loop */
+  static int64_t cpu() {
+    return read(CLOCK_THREAD_CPUTIME_ID);
+  }
+
+  static double seconds(int64_t ticks) {
+    return double(ticks) / perSecond;
+  }
+};
@@ -0,0 +1,31 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+#include "timerheap.h"
+
+#include <algorithm>
+#include <functional>
+
+using namespace DarkHttpd;
+
+void TimerHeap::schedule(TimerWaiter &waiter, unsigned ticket, int64_t due) {
+  heap.push_back({due, &waiter, ticket});
+  std::push_heap(heap.begin(), heap.end(), std::greater<>());
+  ++stats.scheduled;
+  stats.longest = std::max(stats.longest, heap.size());
+}
+
+bool TimerHeap::fire(int64_t now) {
+  bool any = false;
+  while (!heap.empty() && heap.front().due <= now) {
+    std::pop_heap(heap.begin(), heap.end(), std::greater<>());
+    auto due = heap.back();
+    heap.pop_back(); //before the call, which may schedule again
+    ++stats.fired;
+    due.waiter->onTimer(due.ticket);
+    any = true;
+  }
+  return any;
+}
@@ -0,0 +1,58 @@
+/**
+// Created by andyh on 10/18/26.
+// Copyright (c) 2026 Andy Heilveil, (github/980f). All rights reserved.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace DarkHttpd {
+  /** called back when the time it asked for comes */
+  struct TimerWaiter {
+    /** @param ticket is what was passed to TimerHeap::schedule, a waiter that has since moved on ignores the ones it no longer holds */
+    virtual void onTimer(unsigned ticket) = 0;
+
+    virtual ~TimerWaiter() = default;
+  };
+
+  /** one shot timers for the event loop, which sleeps no longer than until the earliest and then fires those due.
+   * There is no cancel, as with IoPool a waiter changes its ticket and ignores stale calls, so entries must not outlive their waiters, which pooled Connections don't.
+   */
+  class TimerHeap {
+    struct Entry {
+      int64_t due; //Ticks
+      TimerWaiter *waiter;
+      unsigned ticket;
+
+      bool operator>(const Entry &other) const {
+        return due > other.due;
+      }
+    };
+
+    std::vector<Entry> heap; //std::push_heap with greater, so the earliest is at the front
+
+  public:
+    struct Stats {
+      uint64_t scheduled = 0;
+      uint64_t fired = 0;
+      size_t longest = 0;
+    } stats;
+
+    void schedule(TimerWaiter &waiter, unsigned ticket, int64_t due);
+
+    /** @returns Ticks of the earliest entry, 0 when there are none */
+    int64_t next() const {
+      return heap.empty() ? 0 : heap.front().due;
+    }
+
+    /** call back everyone due by @param now. @returns whether there were any. */
+    bool fire(int64_t now);
+
+    size_t entries() const {
+      return heap.size();
+    }
+  };
+}